@@ -0,0 +1,13 @@
+#pragma once
+
+#include <type_traits>
+
+namespace vkutil {
+	// Rounds value up to the next multiple of alignment, which does not have to be a power of two.
+	// The alignment takes the type of the value, so constants of a narrower type can be passed as is.
+	template<typename T>
+	constexpr T align_up(T value, std::type_identity_t<T> alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
\ No newline at end of file
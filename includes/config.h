@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+
+// Upper bound for the number of frames the CPU is allowed to record ahead of the GPU.
+// The frame data array is sized after this, the actual amount is selected at runtime.
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+// Upper bound for the number of threads recording command buffers next to the main thread.
+// Every frame in flight gets one command pool per thread.
+constexpr uint32_t MAX_WORKER_THREADS = 15;
+// Value of EngineConfig::worker_threads that picks the number of threads from the CPU core count
+constexpr uint32_t WORKER_THREADS_AUTO = UINT32_MAX;
+
+// Limits of EngineConfig::frame_arena_kb. A kilobyte holds at least one block of any device's offset alignment.
+constexpr uint32_t MIN_FRAME_ARENA_KB = 1;
+constexpr uint32_t MAX_FRAME_ARENA_KB = 1024 * 1024;
+
+// Largest window width or height accepted from the config, the smallest maxImageDimension2D a Vulkan device may have
+constexpr uint32_t MAX_WINDOW_SIZE = 4096;
+
+// Settings that can be changed without recompiling.
+// They are read from a config file and can then be overridden from the command line.
+struct EngineConfig {
+	// 1 - MAX_WINDOW_SIZE
+	uint32_t window_width = 800;
+	uint32_t window_height = 600;
+
+	// Number of frames the CPU can record while the GPU is still working on earlier ones (1 - MAX_FRAMES_IN_FLIGHT).
+	// More frames gives higher throughput, fewer frames gives lower input latency.
+	uint32_t frames_in_flight = 2;
+
+	// The preferred present mode. If it is not supported, the closest supported mode is used instead.
+	VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+
+	// When non-zero, the frame pacer delays input sampling so that frames are produced at this rate
+	uint32_t target_fps = 0;
+
+	// Number of threads recording render passes in parallel with the main thread (0 - MAX_WORKER_THREADS).
+	// 0 records everything on the main thread.
+	uint32_t worker_threads = WORKER_THREADS_AUTO;
+
+	bool headless = false;
+	uint32_t headless_frame_count = 300;
+	std::string headless_capture_path;
+
+	std::string timings_csv_path;
+
+	// When set, GPU memory usage per heap and per category is written to this file as JSON on exit
+	std::string memory_stats_path;
+
+	// Size of the linear arena every frame in flight allocates its transient GPU data from (MIN_FRAME_ARENA_KB - MAX_FRAME_ARENA_KB)
+	uint32_t frame_arena_kb = 4096;
+
+	// Compiled pipelines are kept here between runs. Empty disables the on-disk pipeline cache.
+	std::string pipeline_cache_path = "pipeline_cache.bin";
+
+	// Reload shaders and rebuild their pipelines when shader files change on disk.
+	// Changed GLSL sources are recompiled with shader_compiler, leave it empty to only watch SPIR-V files.
+	// Off by default, as it is only useful while working on shaders.
+	bool shader_hot_reload = false;
+	std::string shader_compiler = "glslangValidator";
+};
+
+// Reads "key = value" lines from a config file. Lines starting with '#' are comments.
+// Returns false if the file could not be opened. Unknown keys and invalid values are logged and ignored.
+bool load_config_file(const char* filePath, EngineConfig& config);
+
+// Applies "--key value" style command line arguments on top of the config.
+// The keys are the same as in the config file, with underscores replaced by dashes.
+void apply_command_line(int argc, char** argv, EngineConfig& config);
+
+// Path of the config file given with --config, or the default config file path
+const char* config_file_path(int argc, char** argv);
+
+const char* present_mode_name(VkPresentModeKHR presentMode);
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vk_types.h>
+
+#include <cstdint>
+
+// A piece of a frame arena. Valid until the arena is reset, which is once the GPU has finished the frame it was allocated for.
+struct FrameAllocation {
+	// Mapped pointer to write the data to. nullptr if the arena was full.
+	void* data = nullptr;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	// Device address of the first byte, for shaders reading the data through a buffer_reference
+	VkDeviceAddress deviceAddress = 0;
+
+	explicit operator bool() const { return data != nullptr; }
+};
+
+// A linear allocator for data that only lives for a single frame, like camera matrices, instance lists and UI vertices.
+//
+// Every frame in flight owns one arena: a single persistently mapped buffer that allocations are carved out of by bumping an offset.
+// Nothing is freed individually. Once the frame timeline says the GPU is done with the frame, the whole arena is reset at once.
+// This replaces a VMA allocation per piece of data per frame with an add and a compare.
+//
+// The buffer can be used as a uniform, storage, vertex and index buffer, as the source of a copy, and through its device address.
+class FrameArena {
+public:
+	struct Stats {
+		// Bytes allocated since the last reset
+		VkDeviceSize used;
+		// Most bytes a single frame asked for since init, including allocations that did not fit. The arena should be sized after this.
+		VkDeviceSize high_water_mark;
+		VkDeviceSize capacity;
+		// Allocations that did not fit since init
+		uint32_t failed_allocations;
+	};
+
+	// minAlignment is the alignment every allocation gets at least, which should cover the device's offset alignment limits
+	void init(VmaAllocator allocator, VkDevice device, VkDeviceSize capacity, VkDeviceSize minAlignment);
+	void destroy();
+
+	// Returns an empty allocation if the arena is full. alignment has to be a power of two.
+	FrameAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+
+	// Allocates space for count values of T, aligned for T
+	template<typename T>
+	FrameAllocation allocate(uint32_t count = 1)
+	{
+		return allocate(sizeof(T) * count, alignof(T));
+	}
+
+	// Makes the writes of this frame visible to the GPU. Call before submitting the frame.
+	void flush();
+	// Starts over at the beginning of the buffer. The GPU has to be done with every allocation.
+	void reset();
+
+	const Stats& stats() const { return _stats; }
+
+private:
+	VmaAllocator _allocator = VK_NULL_HANDLE;
+	AllocatedBuffer _buffer{};
+	VkDeviceSize _minAlignment = 0;
+	// Bytes flushed so far this frame
+	VkDeviceSize _flushed = 0;
+	Stats _stats{};
+};
\ No newline at end of file
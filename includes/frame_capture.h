@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace vkutil {
+	// Converts a 16 bit IEEE half precision float into a regular 32 bit float
+	float half_to_float(uint16_t half);
+
+	// Hash of a read back frame, the same as hash_bytes.
+	// Used to compare read back frames between runs without having to store the images themselves.
+	uint64_t frame_checksum(const void* data, size_t size);
+
+	// Writes a tightly packed R16G16B16A16_SFLOAT image to disk as a binary PPM file.
+	// Colors are clamped to [0, 1] and the alpha channel is dropped.
+	bool write_frame_ppm(const char* filePath, const void* pixels, uint32_t width, uint32_t height);
+}
\ No newline at end of file
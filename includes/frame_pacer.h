@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+// Paces frames to a target frame rate while keeping input latency low.
+// Instead of sleeping after a frame has been presented, the pacer sleeps right before input is sampled.
+// That way the input used for a frame is as recent as possible when the frame reaches the screen.
+class FramePacer {
+public:
+	// A target of 0 disables pacing
+	void set_target_fps(uint32_t targetFps);
+
+	// Sleeps until the latest point where the frame can still be finished before its deadline.
+	// Call right before polling input.
+	void wait_before_input();
+
+	// Call once the frame has been submitted and presented.
+	// Updates the estimate of how long a frame takes from input sampling to present.
+	void end_frame();
+
+private:
+	uint64_t _targetPeriod = 0;
+	uint64_t _nextDeadline = 0;
+	uint64_t _inputSampleTime = 0;
+	// Estimated time between sampling input and finishing the frame, in performance counter ticks
+	uint64_t _workEstimate = 0;
+};
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// The parts of a frame we measure.
+// CPU stages are measured with scopes around the corresponding calls in the game loop.
+// The GPU stage is measured with timestamp queries written at the start and end of the frame's command buffer.
+enum class FrameStage : uint32_t {
+	Wait,
+	Pace,
+	Acquire,
+	Record,
+	Submit,
+	Present,
+	CpuFrame,
+	GpuFrame,
+	Count
+};
+
+const char* frame_stage_name(FrameStage stage);
+
+// Per-frame counts of things that are not timings, like how many barriers were recorded
+enum class FrameCounter : uint32_t {
+	Barriers,
+	BarrierBatches,
+	// Bytes copied to the GPU through the upload manager
+	UploadBytes,
+	// Bytes allocated from the frame arena
+	ArenaBytes,
+	// Bytes of changed tile map chunks copied to the GPU, and the copy regions they took
+	TileUploadBytes,
+	TileUploadRegions,
+	// Sprites drawn by the sprite batch, and the draws it took
+	Sprites,
+	SpriteDraws,
+	// Lights added up by the tile lighting pass
+	Lights,
+	Count
+};
+
+const char* frame_counter_name(FrameCounter counter);
+
+struct FrameStageStats {
+	double last_ms;
+	double min_ms;
+	double avg_ms;
+	double p99_ms;
+};
+
+// Keeps a ring buffer of per-stage timings for the most recent frames,
+// and can summarize them or stream them to a CSV file.
+class FrameTimings {
+public:
+	// Number of frames kept in the ring buffer
+	static constexpr uint32_t HISTORY_SIZE = 256;
+
+	// Starts a new entry in the ring buffer. All stages of the new entry start out at zero.
+	void begin_frame(uint64_t frameNumber);
+	void record(FrameStage stage, double milliseconds);
+	void count(FrameCounter counter, uint64_t value);
+	// Finishes the current entry and appends it to the CSV file, if one is open.
+	void end_frame();
+	// Drops the current entry, for frames that were skipped before anything was rendered
+	void discard_frame();
+
+	FrameStageStats stats(FrameStage stage) const;
+	// Average of a counter over the frames in the ring buffer
+	double average(FrameCounter counter) const;
+
+	// Short single line summary, suitable for a window title or a log line
+	std::string summary() const;
+
+	bool open_csv(const char* filePath);
+	void close_csv();
+
+private:
+	double _history[HISTORY_SIZE][(uint32_t)FrameStage::Count] = {};
+	uint64_t _counters[HISTORY_SIZE][(uint32_t)FrameCounter::Count] = {};
+	uint64_t _frameNumbers[HISTORY_SIZE] = {};
+	uint32_t _current = 0;
+	uint32_t _count = 0;
+	std::ofstream _csv;
+};
+
+// Measures the CPU time between construction and destruction and records it for a stage
+class CpuTimingScope {
+public:
+	CpuTimingScope(FrameTimings& timings, FrameStage stage);
+	~CpuTimingScope();
+
+private:
+	FrameTimings& _timings;
+	FrameStage _stage;
+	uint64_t _start;
+};
\ No newline at end of file
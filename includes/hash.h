@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace vkutil {
+	// Hash of no data at all, which hashes are built up from
+	constexpr uint64_t HASH_SEED = 14695981039346656037ull;
+
+	// 64 bit FNV-1a hash of a block of memory.
+	// Fast and stable between runs and platforms, so hashes can be written to disk, but not meant to resist deliberate collisions.
+	// Hashing a block with the hash of the blocks before it as the seed gives the hash of all of them in a row.
+	uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = HASH_SEED);
+
+	// Adds a value to a hash built up one value at a time
+	uint64_t hash_combine(uint64_t hash, uint64_t value);
+}
+
+// Some state flattened into a list of words, like the state of a pipeline builder or a layout description, along with its hash.
+// Caches that hand out the same object for the same state are keyed by it. Keys only compare equal if their words do,
+// so two different states with the same hash still get objects of their own.
+struct StateKey {
+	std::vector<uint32_t> state;
+	uint64_t hash;
+
+	bool operator==(const StateKey& other) const { return hash == other.hash && state == other.state; }
+};
+
+struct StateKeyHash {
+	size_t operator()(const StateKey& key) const { return (size_t)key.hash; }
+};
+
+namespace vkutil {
+	StateKey make_state_key(std::vector<uint32_t> state);
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the jobs that are still running, so a caller can wait for a group of jobs to finish
+struct JobCounter {
+	std::atomic<uint32_t> pending{ 0 };
+
+	bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+// A small pool of worker threads that runs jobs from a shared queue.
+// The thread that calls init() counts as worker 0. It runs jobs as well while it waits for them,
+// so with zero worker threads every job simply runs on the calling thread.
+// Jobs are told which worker they run on, so they can use per-worker resources (like command pools) without locking.
+class JobSystem {
+public:
+	using Job = std::function<void(uint32_t workerIndex)>;
+
+	void init(uint32_t workerThreads);
+	void shutdown();
+
+	// Number of workers including the calling thread
+	uint32_t worker_count() const { return (uint32_t)_threads.size() + 1; }
+
+	// Queues a job. If counter is not null, it is incremented now and decremented once the job has run.
+	void submit(Job job, JobCounter* counter = nullptr);
+
+	// Queues long running work, like compiling pipelines, that should not hold up the frame.
+	// Background jobs only run on worker threads once there is no other work queued, and are never picked up by wait().
+	// Without worker threads they never run, so check worker_count() first.
+	void submit_background(Job job, JobCounter* counter = nullptr);
+
+	// Runs queued jobs on the calling thread until every job of the counter has finished.
+	// Must only be called from the thread that called init().
+	void wait(JobCounter& counter);
+
+	// Runs function(index, workerIndex) for every index in [0, count), spread over all workers, and waits for all of them
+	void parallel_for(uint32_t count, const std::function<void(uint32_t index, uint32_t workerIndex)>& function);
+
+private:
+	struct QueuedJob {
+		Job job;
+		JobCounter* counter;
+	};
+
+	void worker_loop(uint32_t workerIndex);
+	void run_job(QueuedJob& queued, uint32_t workerIndex);
+
+	std::vector<std::thread> _threads;
+	std::deque<QueuedJob> _queue;
+	std::deque<QueuedJob> _backgroundQueue;
+	std::mutex _mutex;
+	// Signaled when a job is queued, a job finishes, or the workers should stop
+	std::condition_variable _condition;
+	bool _stopping = false;
+};
\ No newline at end of file
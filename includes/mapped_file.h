@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// A read-only view of a whole file, mapped into memory by the OS.
+// Nothing is copied when the file is opened. Pages are read from disk (or the OS file cache) the first time they are touched,
+// so handing the mapped memory straight to an API like vkCreateShaderModule avoids any intermediate heap buffer.
+// The mapping is page aligned, which satisfies the alignment needed to read the file as 32 bit words.
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	// Maps the file. Returns false if the file could not be opened or mapped. Empty files can not be mapped.
+	bool open(const char* filePath);
+	void close();
+
+	bool is_open() const { return _data != nullptr; }
+	const void* data() const { return _data; }
+	size_t size() const { return _size; }
+
+private:
+	const void* _data = nullptr;
+	size_t _size = 0;
+
+#ifdef _WIN32
+	void* _file = nullptr;
+	void* _mapping = nullptr;
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vk_types.h>
+#include <vk_image_state.h>
+#include <deletionqueue.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Handle to an image used by the render graph. Only valid for the frame it was created in.
+struct RGImage {
+	uint32_t index = UINT32_MAX;
+
+	bool valid() const { return index != UINT32_MAX; }
+};
+
+// Description of an image that only lives while the graph is executing.
+// Transient images whose lifetimes do not overlap share the same memory.
+struct RGTransientImageDesc {
+	VkFormat format;
+	VkExtent2D extent;
+	VkImageUsageFlags usage;
+};
+
+class RenderGraph;
+
+// Passed to the setup function of a pass, to declare which images the pass reads and writes.
+// Every image can only be declared once per pass.
+class RGPassBuilder {
+public:
+	void read(RGImage image, ImageUsage usage);
+	// If discardContents is true, the pass overwrites the whole image and its previous contents are not needed
+	void write(RGImage image, ImageUsage usage, bool discardContents = false);
+	// The pass has effects outside of the graph (like a readback to the CPU), so it is never culled
+	void has_side_effects();
+
+private:
+	friend class RenderGraph;
+
+	RGPassBuilder(RenderGraph& graph, uint32_t passIndex) : _graph(graph), _passIndex(passIndex) {}
+
+	RenderGraph& _graph;
+	uint32_t _passIndex;
+};
+
+// A small render graph.
+// Every frame, passes are added along with the images they read and write. The graph then:
+// - culls passes whose results are never used,
+// - orders the remaining passes,
+// - derives the barriers needed between them from the image state tracker, batched into one barrier per pass,
+// - and allocates transient images, aliasing the memory of images whose lifetimes do not overlap.
+class RenderGraph {
+public:
+	using ExecuteFunction = std::function<void(VkCommandBuffer cmd, const RenderGraph& graph)>;
+
+	struct Stats {
+		uint32_t passes;
+		uint32_t culled_passes;
+		uint32_t transient_images;
+		// Memory that would be needed without aliasing, and what is actually allocated
+		VkDeviceSize transient_bytes_requested;
+		VkDeviceSize transient_bytes_allocated;
+	};
+
+	// Transient images that are replaced while frames might still be using them are destroyed through retireQueue
+	void init(VkDevice device, VmaAllocator allocator, ImageStateTracker* tracker, DeletionQueue* retireQueue);
+	void destroy();
+
+	// Clears all passes and image handles, to start building the next frame
+	void reset();
+
+	// Adds an image that lives outside of the graph. It has to be tracked by the image state tracker already.
+	// Output images are the results of the frame, and keep every pass contributing to them alive.
+	// If finalUsage is not Undefined, the image is transitioned to it after the last pass.
+	RGImage import_image(const char* name, VkImage image, VkImageView view, VkExtent2D extent,
+		bool output = false, ImageUsage finalUsage = ImageUsage::Undefined);
+	RGImage create_transient_image(const char* name, const RGTransientImageDesc& desc);
+
+	void add_pass(const char* name, const std::function<void(RGPassBuilder& builder)>& setup, ExecuteFunction execute);
+
+	// Culls, orders and allocates, and computes all barriers. Must be called before execute.
+	void compile();
+
+	// Records every pass that survived culling, in order, with its barriers
+	void execute(VkCommandBuffer cmd) const;
+
+	// For recording passes into separate command buffers, possibly from several threads at once.
+	// Submitting the command buffers of positions 0 to executed_pass_count() - 1 in order, followed by the final barriers,
+	// is equivalent to execute(). Recording only reads the compiled graph, so different passes can be recorded concurrently.
+	uint32_t executed_pass_count() const { return (uint32_t)_executionOrder.size(); }
+	void record_pass(VkCommandBuffer cmd, uint32_t position) const;
+	void record_final_barriers(VkCommandBuffer cmd) const;
+
+	VkImage get_image(RGImage image) const;
+	VkImageView get_image_view(RGImage image) const;
+	VkExtent2D get_extent(RGImage image) const;
+
+	const Stats& stats() const { return _stats; }
+
+private:
+	friend class RGPassBuilder;
+
+	struct Access {
+		uint32_t resource;
+		ImageUsage usage;
+		bool write;
+		bool discard;
+	};
+
+	struct Pass {
+		std::string name;
+		std::vector<Access> accesses;
+		bool sideEffects = false;
+		ExecuteFunction execute;
+
+		// Filled in by compile()
+		bool culled = false;
+		std::vector<uint32_t> dependencies;
+		std::vector<uint32_t> dataDependencies;
+		std::vector<VkImageMemoryBarrier2> imageBarriers;
+		std::vector<VkMemoryBarrier2> memoryBarriers;
+	};
+
+	struct Resource {
+		std::string name;
+		bool imported;
+		bool output;
+		ImageUsage finalUsage;
+
+		VkImage image;
+		VkImageView view;
+		VkExtent2D extent;
+
+		// Only used by transient images
+		RGTransientImageDesc desc;
+		uint32_t firstUse;
+		uint32_t lastUse;
+		uint32_t transientIndex;
+	};
+
+	// Transient images and their memory are kept alive between frames, and only rebuilt when the set of transient images changes
+	struct TransientImage {
+		VkImage image;
+		VkImageView view;
+		uint32_t slot;
+	};
+
+	struct MemorySlot {
+		VmaAllocation allocation;
+		VkMemoryRequirements requirements;
+		// The last time the memory was touched, by whichever image used it last.
+		// The first use of the next image in the slot has to wait for it.
+		ImageState lastState;
+	};
+
+	void cull_passes();
+	void order_passes();
+	void allocate_transients();
+	void release_transients();
+	void compute_barriers();
+
+	static void record_barriers(VkCommandBuffer cmd, const std::vector<VkImageMemoryBarrier2>& imageBarriers, const std::vector<VkMemoryBarrier2>& memoryBarriers);
+
+	VkDevice _device = VK_NULL_HANDLE;
+	VmaAllocator _allocator = VK_NULL_HANDLE;
+	ImageStateTracker* _tracker = nullptr;
+	DeletionQueue* _retireQueue = nullptr;
+
+	std::vector<Pass> _passes;
+	std::vector<Resource> _resources;
+	std::vector<uint32_t> _executionOrder;
+	std::vector<VkImageMemoryBarrier2> _finalBarriers;
+
+	std::vector<TransientImage> _transientImages;
+	std::vector<MemorySlot> _memorySlots;
+	uint64_t _transientSignature = 0;
+
+	Stats _stats{};
+};
\ No newline at end of file
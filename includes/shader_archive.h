@@ -0,0 +1,105 @@
+#pragma once
+
+#include <spirv_reflect.h>
+#include <mapped_file.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Every compiled shader packed into a single file, built by the shader_packer tool as part of the Shaders build target.
+// Opening the archive is one file open and one mapping, instead of one of each per shader.
+//
+// Layout of the file. Offsets are from the start of the file, and everything is little endian.
+//
+//   ShaderArchiveHeader
+//   ShaderArchiveEntry[shaderCount], sorted by name
+//   ShaderArchiveBinding[bindingCount], the descriptor bindings of every shader, one after the other
+//   Names of the shaders and their entry points, null terminated
+//   SPIR-V of every shader, each starting on a SHADER_ARCHIVE_ALIGNMENT boundary
+//
+// Shaders are named after their SPIR-V file without the .spv extension, like "colored_triangle.frag".
+
+// "RXSA" in little endian
+constexpr uint32_t SHADER_ARCHIVE_MAGIC = 0x41535852;
+// Bump when the layout of the file changes
+constexpr uint32_t SHADER_ARCHIVE_VERSION = 1;
+constexpr uint32_t SHADER_ARCHIVE_ALIGNMENT = 64;
+
+struct ShaderArchiveHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t fileSize;
+	uint32_t shaderCount;
+	uint32_t bindingCount;
+	uint32_t namesOffset;
+	uint32_t namesSize;
+	uint32_t reserved;
+};
+
+struct ShaderArchiveEntry {
+	uint32_t nameOffset;
+	uint32_t entryPointOffset;
+	// Hash of the SPIR-V, the same as vkutil::hash_bytes of the .spv file
+	uint64_t contentHash;
+	uint32_t codeOffset;
+	uint32_t codeSize;
+
+	// Reflection
+	uint32_t stage;
+	uint32_t pushConstantSize;
+	uint32_t localSize[3];
+	uint32_t firstBinding;
+	uint32_t bindingCount;
+	uint32_t reserved;
+};
+
+struct ShaderArchiveBinding {
+	uint32_t set;
+	uint32_t binding;
+	uint32_t descriptorType;
+	uint32_t count;
+};
+
+// A shader inside an opened archive. The code points into the mapped file, and stays valid while the archive is open.
+struct ArchivedShader {
+	const uint32_t* code;
+	// In bytes
+	size_t codeSize;
+	uint64_t contentHash;
+	ShaderReflection reflection;
+};
+
+class ShaderArchive {
+public:
+	// Maps the archive and checks that its header and index are consistent.
+	// The SPIR-V itself is not read until a shader is looked up, so opening costs the same no matter how many shaders there are.
+	bool open(const char* filePath, std::string& error);
+	void close();
+
+	bool is_open() const { return _file.is_open(); }
+	uint32_t shader_count() const { return _header != nullptr ? _header->shaderCount : 0; }
+
+	// Binary search through the index. Returns false if there is no shader with that name.
+	bool find(std::string_view name, ArchivedShader& shader) const;
+
+private:
+	MappedFile _file;
+	const ShaderArchiveHeader* _header = nullptr;
+	const ShaderArchiveEntry* _entries = nullptr;
+	const ShaderArchiveBinding* _bindings = nullptr;
+	const char* _names = nullptr;
+};
+
+// A shader to be written into an archive
+struct ShaderArchiveInput {
+	std::string name;
+	std::vector<uint32_t> code;
+	ShaderReflection reflection;
+};
+
+namespace vkutil {
+	// Writes an archive containing the given shaders. The file is replaced atomically, so a failed build never leaves half an archive.
+	bool write_shader_archive(const char* filePath, std::vector<ShaderArchiveInput> shaders, std::string& error);
+}
\ No newline at end of file
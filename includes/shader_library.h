@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vk_pipeline_registry.h>
+#include <shader_archive.h>
+#include <spirv_reflect.h>
+#include <job_system.h>
+#include <deletionqueue.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Owns every shader module, and reloads them while the game is running when their files change.
+//
+// SPIR-V files are memory mapped and handed to the driver straight from the mapping, so loading a shader makes no heap copies.
+// When a shader archive is open, shaders found in it are created from the archive instead, so startup maps one file
+// instead of opening every shader. The archive also carries the reflection data of each shader, which is otherwise
+// parsed from the SPIR-V when the shader is loaded.
+// Modules are cached by path, along with a hash of the file contents. A file that is touched without its contents changing
+// keeps its module, and does not cause any pipelines to be rebuilt.
+// Without hot reload, files with the same contents also share a single module. With hot reload every file keeps a module of its own:
+// pipelines only know their modules, so a reload of one file would otherwise rebuild the pipelines of every file sharing it.
+//
+// With hot reload enabled, every loaded shader is watched.
+// When the GLSL source next to a SPIR-V file changes (for example "foo.frag" for "foo.frag.spv"), it is recompiled in the background.
+// When the SPIR-V file changes, either through that recompile or an external build, a new module is created
+// and only the pipelines using the old module are rebuilt. The pipeline registry swaps them in at the next frame boundary.
+// Pipeline layouts are not rebuilt, so a changed shader is only reloaded if its bindings and push constants stay the same.
+class ShaderLibrary {
+public:
+	// If moduleIdentifiers is true, VK_EXT_shader_module_identifier is enabled on the device, and identifiers are queried for every module
+	void init(VkDevice device, PipelineRegistry* registry, JobSystem* jobs, bool moduleIdentifiers);
+	// Destroys every shader module. The pipeline registry has to be destroyed first.
+	void destroy();
+
+	// Starts watching shader files. compilerPath is the GLSL compiler used for changed sources (glslangValidator).
+	// With an empty compilerPath only SPIR-V files are watched.
+	void enable_hot_reload(const std::string& compilerPath);
+
+	// Maps a shader archive built by shader_packer. Returns false if it is missing or invalid, in which case
+	// every shader is loaded from its own file.
+	bool open_archive(const char* archivePath);
+
+	// Loads a SPIR-V file, or returns the module loaded earlier from the same file (or from the same SPIR-V, without hot reload).
+	// If the open archive has a shader with the same name ("foo.frag" for "resources/shaders/foo.frag.spv"), it is used instead of the file.
+	// Hot reload still watches the file, so changes made after startup are picked up either way.
+	// Returns VK_NULL_HANDLE if the file is missing or is not valid SPIR-V.
+	VkShaderModule load(const char* spirvPath);
+
+	// Stage, descriptor bindings and push constants of a loaded module, or nullptr if the module is unknown
+	const ShaderReflection* reflection(VkShaderModule module) const;
+
+	// Checks the watched files for changes, a few times per second at most.
+	// Call once per frame from the main thread, at a frame boundary. Replaced modules are destroyed through retireQueue.
+	void poll(DeletionQueue& retireQueue);
+
+	// The driver's identifier for a module, which stays the same across runs for the same SPIR-V and driver.
+	// Returns false if identifiers are not supported or the module is unknown.
+	bool module_identifier(VkShaderModule module, std::vector<uint8_t>& identifier) const;
+
+private:
+	struct Shader {
+		std::string spirvPath;
+		// GLSL source the SPIR-V is compiled from, empty if there is none
+		std::string sourcePath;
+
+		std::filesystem::file_time_type spirvTime;
+		std::filesystem::file_time_type sourceTime;
+
+		VkShaderModule module;
+		// Hash of the SPIR-V the module was created from
+		uint64_t contentHash;
+		std::vector<uint8_t> identifier;
+		ShaderReflection reflection;
+
+		JobCounter compiling;
+	};
+
+	// Creates a module from a SPIR-V file, unless its contents hash to knownHash.
+	// Returns VK_NULL_HANDLE if the file is invalid or its contents are unchanged.
+	VkShaderModule create_module(const std::string& spirvPath, uint64_t knownHash, uint64_t& contentHash, ShaderReflection& reflection);
+	// Returns the module already created for contentHash when modules are shared
+	VkShaderModule create_module_from_code(const uint32_t* code, size_t codeSize, uint64_t contentHash, const std::string& spirvPath);
+	void query_identifier(Shader& shader);
+	void compile_source(const Shader& shader);
+
+	VkDevice _device = VK_NULL_HANDLE;
+	PipelineRegistry* _registry = nullptr;
+	JobSystem* _jobs = nullptr;
+
+	ShaderArchive _archive;
+
+	PFN_vkGetShaderModuleIdentifierEXT _getShaderModuleIdentifier = nullptr;
+
+	bool _hotReload = false;
+	std::string _compilerPath;
+	uint64_t _lastPollTicks = 0;
+
+	std::unordered_map<std::string, std::unique_ptr<Shader>> _shaders;
+	// Modules by the hash of their SPIR-V, only filled while hot reload is disabled
+	std::unordered_map<uint64_t, VkShaderModule> _sharedModules;
+};
\ No newline at end of file
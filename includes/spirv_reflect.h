@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A descriptor binding declared by a shader
+struct ReflectedBinding {
+	uint32_t set;
+	uint32_t binding;
+	VkDescriptorType type;
+	// Number of descriptors for arrays. 0 means a runtime sized array, like "uniform texture2D textures[]".
+	uint32_t count;
+};
+
+// What a pipeline needs to know about a shader to build its layout
+struct ShaderReflection {
+	VkShaderStageFlagBits stage = VK_SHADER_STAGE_ALL;
+	std::string entryPoint;
+
+	// Sorted by set, then binding
+	std::vector<ReflectedBinding> bindings;
+
+	// Size in bytes of the push constant block, 0 if the shader has none
+	uint32_t pushConstantSize = 0;
+
+	// Workgroup size of compute shaders, 1 x 1 x 1 for anything else
+	uint32_t localSize[3] = { 1, 1, 1 };
+};
+
+namespace vkutil {
+	// Reads the stage, descriptor bindings, push constant size and workgroup size from SPIR-V.
+	// Only the first entry point is looked at. Returns false, with a reason in error, if the code is not valid SPIR-V.
+	bool reflect_spirv(const uint32_t* code, size_t wordCount, ShaderReflection& reflection, std::string& error);
+
+	// True if two shaders fit the same pipeline layout and stage, so one can replace the other in an existing pipeline
+	bool same_interface(const ShaderReflection& a, const ShaderReflection& b);
+}
\ No newline at end of file
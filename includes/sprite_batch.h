@@ -0,0 +1,139 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vk_types.h>
+#include <vk_bindless.h>
+#include <vk_layout_cache.h>
+#include <vk_pipeline_registry.h>
+#include <shader_library.h>
+#include <frame_arena.h>
+#include <tile_renderer.h>
+
+#include <cstdint>
+#include <vector>
+
+// How a sprite is blended over what is behind it. Every blend mode is its own pipeline.
+enum class SpriteBlend : uint8_t {
+	Alpha,
+	Additive,
+	Count
+};
+
+// Packs a tint into the RGBA8 layout the sprite shaders unpack, red in the lowest byte
+constexpr uint32_t pack_tint(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255)
+{
+	return (uint32_t)r | ((uint32_t)g << 8) | ((uint32_t)b << 16) | ((uint32_t)a << 24);
+}
+
+// A quad to draw for a single frame, like a monster or an item.
+struct Sprite {
+	// Top left corner of the sprite on the map, in tiles. Sprites are one tile large.
+	float x;
+	float y;
+	// Cell of the texture to draw. Textures are grids of SpritePushConstants::atlasColumns cells per row, like the glyph atlas.
+	uint32_t cell;
+	uint32_t tint;
+	// Bindless slot of the texture, which only holds coverage in its red channel
+	uint32_t texture;
+	// Higher layers are drawn on top of lower ones. Within a layer, sprites are grouped by blend mode and then by texture,
+	// so a sprite is not drawn in the order it was added relative to sprites with another blend mode or texture.
+	// Only sprites with the same layer, blend mode and texture keep the order they were added in.
+	// Sprites that have to overlap in a certain order go on different layers.
+	uint16_t layer;
+	SpriteBlend blend;
+};
+
+// A sprite as the shaders read it. Must match SpriteInstance in resources/shaders/sprite.glsl.
+struct SpriteInstance {
+	float position[2];
+	uint32_t cell;
+	uint32_t tint;
+	uint32_t texture;
+	uint32_t padding;
+};
+
+// Push constants of the sprite shaders. Must match resources/shaders/sprite.glsl.
+struct SpritePushConstants {
+	// Device address of the sorted instances in the frame arena
+	VkDeviceAddress instances;
+	// Top left corner of the map and the size of a tile, in pixels
+	float origin[2];
+	float tileSize[2];
+	float viewportSize[2];
+	uint32_t atlasColumns;
+};
+
+static_assert(sizeof(SpritePushConstants) <= BindlessHeap::PUSH_CONSTANT_SIZE, "Sprite push constants do not fit the bindless push constant range");
+
+// Collects the sprites of a frame and draws them with as few draws as their order allows.
+//
+// Every sprite gets a 64 bit sort key with its layer in the highest bits, then its pipeline, then its texture.
+// The keys are radix sorted, and the sprites are written in sorted order into the frame arena, where the vertex shader
+// reads them through the arena's device address. Textures come from the bindless heap and are picked per sprite,
+// so a new draw is only needed where the pipeline changes. Sprites on the same layer with the same pipeline are drawn
+// by a single instanced draw, no matter how many there are, and thousands of sprites take a handful of draws.
+//
+// Sprites are collected on the CPU and written to the arena once sorted, instead of being written to the arena as they are added.
+// The arena is write combined memory, which is slow to read back for sorting.
+class SpriteBatch {
+public:
+	// Bits of the sort key, from the most significant down. The lowest bits are free for ordering within a texture later on.
+	static constexpr uint32_t LAYER_SHIFT = 48;
+	static constexpr uint32_t PIPELINE_SHIFT = 40;
+	static constexpr uint32_t TEXTURE_SHIFT = 16;
+	static constexpr uint64_t TEXTURE_MASK = 0xFFFFFF;
+
+	struct Stats {
+		uint32_t sprites;
+		uint32_t draws;
+		// Radix sort passes that actually moved sprites. Passes over bytes that are the same in every key are skipped.
+		uint32_t sort_passes;
+		// Sprites dropped because the frame arena was full
+		uint32_t dropped;
+	};
+
+	void init(VkFormat colorFormat, BindlessHeap& heap, LayoutCache& layouts, ShaderLibrary& shaders, PipelineRegistry& pipelines);
+	// Blocks until the pipelines requested by init have finished compiling.
+	// Sprites are not drawn until then, which runs that have to render the same frames every time can not have.
+	void wait_for_pipelines(PipelineRegistry& pipelines) const;
+
+	// Starts collecting the sprites of a new frame
+	void begin();
+	void add(const Sprite& sprite);
+	// Sorts the sprites, writes them into the frame arena and works out the draws.
+	// Must be called after the arena was reset for the frame, and before the frame's passes are recorded.
+	void prepare(FrameArena& arena);
+
+	// Records the draws into a command buffer that is inside dynamic rendering, with the bindless heap bound.
+	// Sprites are placed with the same view as the map they stand on.
+	void draw(VkCommandBuffer cmd, const MapView& view, VkExtent2D extent, uint32_t atlasColumns) const;
+
+	const Stats& stats() const { return _stats; }
+
+private:
+	struct SortEntry {
+		uint64_t key;
+		uint32_t sprite;
+	};
+
+	// A run of sorted sprites sharing a pipeline
+	struct Draw {
+		SpriteBlend blend;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+	};
+
+	VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;
+	PipelineHandle _pipelines[(uint32_t)SpriteBlend::Count];
+
+	std::vector<Sprite> _sprites;
+	// Kept between frames so sorting does not allocate once the batch has seen its largest frame
+	std::vector<SortEntry> _entries;
+	std::vector<SortEntry> _scratch;
+
+	std::vector<Draw> _draws;
+	VkDeviceAddress _instances = 0;
+
+	Stats _stats{};
+};
\ No newline at end of file
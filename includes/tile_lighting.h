@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vk_types.h>
+#include <vk_bindless.h>
+#include <vk_layout_cache.h>
+#include <vk_image_state.h>
+#include <vk_pipelines.h>
+#include <shader_library.h>
+#include <frame_arena.h>
+#include <tile_map.h>
+
+#include <cstdint>
+#include <vector>
+
+// A light on the map, as the lighting shader reads it. Must match TileLight in resources/shaders/tile_lighting.comp.
+struct TileLight {
+	// Center of the light, in tiles
+	float position[2];
+	// Tiles beyond the radius get no light at all
+	float radius;
+	float intensity;
+	// RGBA8, red in the lowest byte, like sprite tints. Alpha is unused.
+	uint32_t color;
+	// Makes every light flicker differently. Lights with a seed of 0 do not flicker.
+	uint32_t flickerSeed;
+};
+
+// Push constants of the lighting shader. Must match resources/shaders/tile_lighting.comp.
+struct TileLightingPushConstants {
+	// Device address of the lights in the frame arena
+	VkDeviceAddress lights;
+	uint32_t lightCount;
+	uint32_t mapWidth;
+	uint32_t mapHeight;
+	// Bindless slot of the map's tile buffer
+	uint32_t tileBuffer;
+	// Light every tile gets, even where no light reaches
+	float ambient;
+	// Seconds since the render loop started, for the flicker
+	float time;
+};
+
+static_assert(sizeof(TileLightingPushConstants) <= BindlessHeap::PUSH_CONSTANT_SIZE, "Tile lighting push constants do not fit the bindless push constant range");
+
+// Lights the tile map on the GPU.
+//
+// A compute shader runs once per tile, and adds up the light of every light in range that can see the tile.
+// Walls and solid rock block the light: the shader walks the line from the light to the tile, so each light only reaches
+// its own field of view. The result goes into a light texture with one texel per tile, which the tile renderer
+// samples to shade the map.
+//
+// The lights of a frame are written into the frame arena and read by the shader through the arena's device address,
+// so hundreds of torches cost the CPU nothing but copying them. Flickering is animated by the shader as well.
+//
+// The light texture is written as a storage image through a small descriptor set of its own in set 1, while the tile buffer
+// comes from the bindless heap in set 0. The texture is also added to the bindless heap, for the tile renderer to sample.
+class TileLighting {
+public:
+	static constexpr VkFormat LIGHT_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+	// Tiles per side of a workgroup, set through specialization constants when the pipeline is built
+	static constexpr uint32_t GROUP_SIZE = 8;
+	// The set the light texture is bound to as a storage image
+	static constexpr uint32_t STORAGE_SET = 1;
+
+	struct Stats {
+		uint32_t lights;
+		// Lights dropped because the frame arena was full
+		uint32_t dropped;
+	};
+
+	// The light texture is as large as the map, and tracked by imageStates from then on.
+	// limits are the device's, which the workgroup size is checked against.
+	void init(VkDevice device, const VkPhysicalDeviceLimits& limits, VmaAllocator allocator, VkPipelineCache pipelineCache, BindlessHeap& heap,
+		LayoutCache& layouts, ShaderLibrary& shaders, ImageStateTracker& imageStates, uint32_t mapWidth, uint32_t mapHeight);
+	// The GPU must be done with the light texture and the pipeline
+	void destroy();
+
+	// Writes the lights of this frame into the frame arena. time is in seconds, and only has to count up steadily for the flicker.
+	// Must be called after the arena was reset for the frame, and before the frame's passes are recorded.
+	void prepare(FrameArena& arena, const std::vector<TileLight>& lights, float time);
+
+	// Records the dispatch into a command buffer outside of rendering. The light texture has to be in the storage layout.
+	void record(VkCommandBuffer cmd, const TileMap& map) const;
+
+	VkImage light_image() const { return _lightImage.image; }
+	VkImageView light_view() const { return _lightImage.imageView; }
+	VkExtent2D light_extent() const { return { _lightImage.imageExtent.width, _lightImage.imageExtent.height }; }
+	// Bindless slot to sample the light texture through
+	uint32_t light_slot() const { return _lightSlot; }
+
+	void set_ambient(float ambient) { _ambient = ambient; }
+
+	const Stats& stats() const { return _stats; }
+
+private:
+	void create_light_image(uint32_t width, uint32_t height);
+	void create_storage_set(LayoutCache& layouts);
+
+	VkDevice _device = VK_NULL_HANDLE;
+	VmaAllocator _allocator = VK_NULL_HANDLE;
+	BindlessHeap* _heap = nullptr;
+	ImageStateTracker* _imageStates = nullptr;
+
+	AllocatedImage _lightImage{};
+	VkSampler _sampler = VK_NULL_HANDLE;
+	uint32_t _lightSlot = BINDLESS_INVALID_SLOT;
+
+	VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+	// Owned by the layout cache
+	VkDescriptorSetLayout _storageSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSet _storageSet = VK_NULL_HANDLE;
+
+	VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline _pipeline = VK_NULL_HANDLE;
+	WorkgroupSize _workgroupSize{};
+
+	VkDeviceAddress _lights = 0;
+	uint32_t _lightCount = 0;
+	float _time = 0.0f;
+	float _ambient = 0.05f;
+
+	Stats _stats{};
+};
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vk_types.h>
+#include <vk_bindless.h>
+#include <frame_arena.h>
+
+#include <cstdint>
+#include <vector>
+
+// Colors a tile can be drawn in. Must match the palette in resources/shaders/tile_map.glsl.
+enum class TileColor : uint8_t {
+	Black,
+	DarkGray,
+	Gray,
+	White,
+	Red,
+	Orange,
+	Yellow,
+	Green,
+	DarkGreen,
+	Cyan,
+	Blue,
+	DarkBlue,
+	Purple,
+	Brown,
+	Tan,
+	Pink
+};
+
+// A tile is packed into 16 bits: the glyph (an index into the glyph atlas, which follows ASCII) in the low byte,
+// and the palette color in the four bits above it. Glyph 0 is empty and is not drawn.
+constexpr uint16_t make_tile(uint8_t glyph, TileColor color)
+{
+	return (uint16_t)(glyph | ((uint16_t)color << 8));
+}
+
+constexpr uint16_t EMPTY_TILE = 0;
+
+// A grid of tiles, kept on the CPU for the game to change, and mirrored into a storage buffer for the tile renderer.
+//
+// Tiles are stored in square chunks of CHUNK_SIZE x CHUNK_SIZE tiles, one chunk after the other, on the CPU and on the GPU alike.
+// Every chunk is a contiguous piece of memory, so a chunk with changed tiles is uploaded with a single copy region.
+// Only chunks changed since the last upload are copied, so a turn where little changes costs next to no transfers.
+//
+// The storage buffer is rewritten while earlier frames might still be drawing from it, so changes are not uploaded
+// through the upload manager, which copies on another queue without waiting for those frames. Instead, changed chunks are
+// written into the frame arena and copied into the storage buffer by the frame's own command buffer, ordered after
+// the draws of earlier frames by a barrier.
+// The buffer is added to the bindless heap, and shaders find it through buffer_slot().
+class TileMap {
+public:
+	// Must match TILE_CHUNK_SIZE in resources/shaders/tile_layout.glsl
+	static constexpr uint32_t CHUNK_SIZE = 16;
+	static constexpr uint32_t CHUNK_TILES = CHUNK_SIZE * CHUNK_SIZE;
+
+	void init(VkDevice device, VmaAllocator allocator, BindlessHeap& heap, uint32_t width, uint32_t height);
+	// The GPU must be done with the buffer
+	void destroy();
+
+	uint32_t width() const { return _width; }
+	uint32_t height() const { return _height; }
+
+	uint16_t get(uint32_t x, uint32_t y) const { return _tiles[tile_index(x, y)]; }
+	void set(uint32_t x, uint32_t y, uint16_t tile);
+	void fill(uint16_t tile);
+
+	// Records the copy of the changed chunks into the storage buffer, along with the barriers around it.
+	// The chunks are staged in the frame arena. If the arena is full, the upload is tried again next frame.
+	// Must be recorded before any pass of the frame that reads the map, from a vertex or a compute shader.
+	void record_upload(VkCommandBuffer cmd, FrameArena& arena);
+
+	uint32_t buffer_slot() const { return _bufferSlot; }
+	// Bytes and chunks copied by the last record_upload, and the copy regions they were merged into
+	VkDeviceSize bytes_uploaded() const { return _bytesUploaded; }
+	uint32_t chunks_uploaded() const { return _chunksUploaded; }
+	uint32_t regions_uploaded() const { return _regionsUploaded; }
+
+private:
+	VmaAllocator _allocator = VK_NULL_HANDLE;
+	BindlessHeap* _heap = nullptr;
+
+	uint32_t tile_index(uint32_t x, uint32_t y) const
+	{
+		uint32_t chunk = (y / CHUNK_SIZE) * _chunksX + x / CHUNK_SIZE;
+		return chunk * CHUNK_TILES + (y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE;
+	}
+
+	void mark_dirty(uint32_t chunk);
+
+	uint32_t _width = 0;
+	uint32_t _height = 0;
+	uint32_t _chunksX = 0;
+	uint32_t _chunksY = 0;
+	// Chunk by chunk. Chunks on the right and bottom edges are padded to full chunks.
+	std::vector<uint16_t> _tiles;
+
+	AllocatedBuffer _buffer{};
+	uint32_t _bufferSlot = BINDLESS_INVALID_SLOT;
+
+	// Chunks changed since the last upload, and a flag per chunk to only list each of them once
+	std::vector<uint32_t> _dirtyChunks;
+	std::vector<bool> _chunkDirty;
+
+	VkDeviceSize _bytesUploaded = 0;
+	uint32_t _chunksUploaded = 0;
+	uint32_t _regionsUploaded = 0;
+};
+
+// Fills a map with a few rooms joined by corridors, to have something to draw before there is a real level generator
+void generate_test_dungeon(TileMap& map, uint32_t seed);
\ No newline at end of file
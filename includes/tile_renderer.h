@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vk_types.h>
+#include <vk_bindless.h>
+#include <vk_layout_cache.h>
+#include <vk_pipeline_registry.h>
+#include <vk_image_state.h>
+#include <shader_library.h>
+#include <upload_manager.h>
+#include <tile_map.h>
+
+#include <cstdint>
+
+// Push constants of the tile map shaders. Must match resources/shaders/tile_map.glsl.
+struct TileMapPushConstants {
+	// Top left corner of the map and the size of a tile, in pixels
+	float origin[2];
+	float tileSize[2];
+	float viewportSize[2];
+	uint32_t mapWidth;
+	uint32_t mapHeight;
+	// Bindless slots of the tile buffer and the glyph atlas
+	uint32_t tileBuffer;
+	uint32_t atlasTexture;
+	uint32_t atlasColumns;
+	// Bindless slot of the light texture, or BINDLESS_INVALID_SLOT to draw the map fully lit
+	uint32_t lightTexture;
+};
+
+static_assert(sizeof(TileMapPushConstants) <= BindlessHeap::PUSH_CONSTANT_SIZE, "Tile map push constants do not fit the bindless push constant range");
+
+// Where a map lands within an extent, in pixels. Everything drawn on the map's grid should be placed with the same view.
+struct MapView {
+	float origin[2];
+	float tileSize;
+};
+
+// Square tiles, as large as they can be while the whole map still fits, centered in the extent
+MapView fit_map_view(uint32_t mapWidth, uint32_t mapHeight, VkExtent2D extent);
+
+// Draws a whole tile map with a single instanced draw.
+//
+// Every tile is an instance of a six vertex quad. The vertex shader finds the tile of its instance in the map's storage buffer,
+// places the quad on the grid, and picks the glyph's cell in the atlas, so no vertex or instance data is ever built on the CPU.
+// Empty tiles are collapsed to a point, so they produce no fragments. The fragment shader colors the glyph's coverage
+// with the tile's palette color, and blends it over whatever was drawn before.
+// If there is a light texture, with a texel per tile, the color is multiplied with the light of the tile.
+//
+// The glyph atlas is a 16 x 16 grid of 8 x 8 pixel glyphs laid out like ASCII. It is generated at startup until there is a real font.
+class TileRenderer {
+public:
+	static constexpr uint32_t ATLAS_COLUMNS = 16;
+	static constexpr uint32_t GLYPH_SIZE = 8;
+
+	// The atlas is uploaded through the upload manager, and tracked by imageStates from then on
+	void init(VkDevice device, VmaAllocator allocator, VkFormat colorFormat, BindlessHeap& heap, LayoutCache& layouts,
+		ShaderLibrary& shaders, PipelineRegistry& pipelines, UploadManager& uploads, ImageStateTracker& imageStates);
+	// The GPU must be done with the atlas
+	void destroy();
+
+	// Blocks until the pipeline requested by init has finished compiling
+	void wait_for_pipeline(PipelineRegistry& pipelines) const;
+
+	// Records the draw into a command buffer that is inside dynamic rendering, with the bindless heap bound.
+	// The map is scaled to fit the extent with square tiles. Nothing is drawn while the pipeline is still compiling.
+	void draw(VkCommandBuffer cmd, const TileMap& map, VkExtent2D extent) const;
+
+	// The texture has to be sampleable in the pass that draws the map, and as large as the map
+	void set_light_texture(uint32_t slot) { _lightSlot = slot; }
+
+	VkImage atlas_image() const { return _atlas.image; }
+	VkImageView atlas_view() const { return _atlas.imageView; }
+	VkExtent2D atlas_extent() const { return { _atlas.imageExtent.width, _atlas.imageExtent.height }; }
+	uint32_t atlas_slot() const { return _atlasSlot; }
+
+private:
+	void create_atlas(UploadManager& uploads);
+
+	VkDevice _device = VK_NULL_HANDLE;
+	VmaAllocator _allocator = VK_NULL_HANDLE;
+	BindlessHeap* _heap = nullptr;
+	ImageStateTracker* _imageStates = nullptr;
+
+	AllocatedImage _atlas{};
+	VkSampler _sampler = VK_NULL_HANDLE;
+	uint32_t _atlasSlot = BINDLESS_INVALID_SLOT;
+	uint32_t _lightSlot = BINDLESS_INVALID_SLOT;
+
+	VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;
+	PipelineHandle _pipeline;
+};
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vk_types.h>
+#include <vk_timeline.h>
+#include <vk_image_state.h>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Size of the staging ring buffer. Uploads larger than this are rejected.
+constexpr VkDeviceSize STAGING_RING_SIZE = 32ull * 1024 * 1024;
+
+// Uploads buffer and image data to the GPU without ever waiting for the GPU on the render thread.
+//
+// Data is copied into a persistently mapped staging ring buffer right away, and the copies into the destination resources
+// are batched and submitted once per frame by flush(). When the device has a dedicated transfer queue, the copies run there,
+// next to the rendering of earlier frames. Otherwise they are submitted to the graphics queue ahead of the frame.
+//
+// Completion is tracked with a timeline semaphore of its own. Each upload returns the timeline value of the submission
+// it goes into, so callers can check when their data has arrived. Staging memory is reused once the submission
+// using it has completed, which is checked without blocking. Only a completely full ring makes the CPU wait.
+//
+// Resources are exclusive to one queue family, so with a dedicated transfer queue, ownership of every uploaded resource
+// is released by the transfer queue and acquired by the graphics queue. The acquire barriers are recorded by
+// record_acquire_barriers() into the next frame, which also waits on the upload timeline.
+// Must be used from the main thread only.
+class UploadManager {
+public:
+	struct Stats {
+		// Submitted by the last flush, including submissions forced by a full ring since the flush before
+		VkDeviceSize bytes_uploaded;
+		uint32_t copies;
+		// Since init
+		uint64_t total_bytes_uploaded;
+		uint32_t submissions;
+		// Times the ring was full and the CPU had to wait for the GPU
+		uint32_t stalls;
+	};
+
+	// transferQueue and transferFamily are the graphics queue and family when there is no dedicated transfer queue
+	void init(VkDevice device, VmaAllocator allocator, VkQueue transferQueue, uint32_t transferFamily, uint32_t graphicsFamily);
+	// The device has to be idle
+	void destroy();
+
+	// Copies data into a buffer. dstStages and dstAccess describe how the graphics queue uses the buffer afterwards.
+	// Returns the timeline value the upload completes with, or 0 if it is larger than the staging ring.
+	uint64_t upload_buffer(const void* data, VkDeviceSize size, VkBuffer buffer, VkDeviceSize offset,
+		VkPipelineStageFlags2 dstStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VkAccessFlags2 dstAccess = VK_ACCESS_2_MEMORY_READ_BIT);
+
+	// Copies tightly packed pixels into the first mip level of a color image, replacing all of its contents.
+	// The image ends up in the layout of finalUsage. It has to be tracked by the image state tracker given to record_acquire_barriers.
+	uint64_t upload_image(const void* data, VkDeviceSize size, VkImage image, VkExtent3D extent, ImageUsage finalUsage = ImageUsage::FragmentSampled);
+
+	// Submits every upload since the last flush. Call once per frame, before recording the frame.
+	void flush();
+
+	// Records the barriers taking ownership of uploaded resources into a command buffer on the graphics queue,
+	// and updates the image states. Returns the upload timeline value the submission of cmd has to wait for, 0 if there is none.
+	uint64_t record_acquire_barriers(VkCommandBuffer cmd, ImageStateTracker& tracker);
+
+	VkSemaphore timeline_semaphore() const { return _timeline.semaphore; }
+	bool is_complete(uint64_t value) const { return _timeline.completed_value(_device) >= value; }
+	bool dedicated_queue() const { return _transferFamily != _graphicsFamily; }
+	const Stats& stats() const { return _stats; }
+
+private:
+	// A piece of the staging ring, freed once the submission with the given timeline value has completed
+	struct StagingRegion {
+		VkDeviceSize begin;
+		VkDeviceSize end;
+		uint64_t value;
+	};
+
+	struct BufferUpload {
+		VkBuffer buffer;
+		VkBufferCopy region;
+		VkPipelineStageFlags2 dstStages;
+		VkAccessFlags2 dstAccess;
+	};
+
+	struct ImageUpload {
+		VkImage image;
+		VkBufferImageCopy region;
+		VkDeviceSize size;
+		ImageUsage finalUsage;
+	};
+
+	struct TransferCommandBuffer {
+		VkCommandBuffer cmd;
+		uint64_t value;
+	};
+
+	// Records and submits the pending copies
+	void submit();
+
+	// Reserves staging memory for the next submission. Waits for the GPU if the ring is full.
+	bool allocate_staging(VkDeviceSize size, VkDeviceSize& offset);
+	bool try_allocate_staging(VkDeviceSize size, VkDeviceSize& offset);
+	void reclaim_staging();
+	void copy_to_staging(const void* data, VkDeviceSize size, VkDeviceSize offset);
+	VkCommandBuffer get_command_buffer();
+
+	VkDevice _device = VK_NULL_HANDLE;
+	VmaAllocator _allocator = VK_NULL_HANDLE;
+	VkQueue _queue = VK_NULL_HANDLE;
+	uint32_t _transferFamily = 0;
+	uint32_t _graphicsFamily = 0;
+
+	Timeline _timeline;
+	VkCommandPool _commandPool = VK_NULL_HANDLE;
+	std::vector<TransferCommandBuffer> _commandBuffers;
+
+	AllocatedBuffer _staging{};
+	// Next free byte, and the first byte still in use
+	VkDeviceSize _head = 0;
+	VkDeviceSize _tail = 0;
+	std::deque<StagingRegion> _regions;
+
+	// Recorded by the next flush
+	std::vector<BufferUpload> _pendingBuffers;
+	std::vector<ImageUpload> _pendingImages;
+
+	// Submitted, waiting for record_acquire_barriers
+	std::vector<VkBufferMemoryBarrier2> _acquireBufferBarriers;
+	std::vector<VkImageMemoryBarrier2> _acquireImageBarriers;
+	std::vector<ImageUpload> _acquiredImages;
+	uint64_t _unacquiredValue = 0;
+
+	Stats _stats{};
+	VkDeviceSize _bytesSinceFlush = 0;
+	uint32_t _copiesSinceFlush = 0;
+};
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vk_layout_cache.h>
+
+#include <cstdint>
+#include <vector>
+
+// Upper limits for the bindless descriptor set. The actual sizes are lowered to what the device supports.
+constexpr uint32_t MAX_BINDLESS_STORAGE_BUFFERS = 1024;
+constexpr uint32_t MAX_BINDLESS_TEXTURES = 4096;
+
+// Returned when the heap is full
+constexpr uint32_t BINDLESS_INVALID_SLOT = UINT32_MAX;
+
+// One global descriptor set holding every texture and storage buffer, which shaders index into.
+// See resources/shaders/bindless.glsl for the shader side.
+//
+// Resources are added once, and get a slot index that is passed to shaders through push constants or buffers.
+// The set is bound once at the start of a command buffer and never changes, so draws never rebind descriptor sets.
+// This relies on descriptor indexing:
+// - update after bind, so slots can be written while the set is bound in command buffers that are still pending,
+// - partially bound, so slots that were never written (or were freed) are fine as long as shaders do not use them,
+// - a variable descriptor count for the texture array, so it is sized at allocation to what the device allows.
+//
+// Every pipeline using the heap shares the same set 0 layout and the same push constant range, so their pipeline layouts are
+// compatible and the set stays bound across pipeline changes. Build their layouts with the fixed set and push constants from the heap.
+//
+// Slots are handed out from free lists. A freed slot can be handed out again right away,
+// so resources should only be removed once no frame in flight uses them anymore (through the frame's deletion queue).
+// Must be used from the main thread only.
+class BindlessHeap {
+public:
+	static constexpr uint32_t SET = 0;
+	static constexpr uint32_t STORAGE_BUFFER_BINDING = 0;
+	// The variable count binding has to be the last one in the set
+	static constexpr uint32_t TEXTURE_BINDING = 1;
+	// The minimum every Vulkan device supports
+	static constexpr uint32_t PUSH_CONSTANT_SIZE = 128;
+
+	void init(VkDevice device, VkPhysicalDevice physicalDevice, LayoutCache& layouts);
+	void destroy();
+
+	// Returns the slot of the texture, or BINDLESS_INVALID_SLOT if every slot is taken
+	uint32_t add_texture(VkImageView view, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	uint32_t add_storage_buffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	// Removing a slot that is not in use is an error, and is reported instead of freeing the slot a second time
+	void remove_texture(uint32_t slot);
+	void remove_storage_buffer(uint32_t slot);
+
+	// Binds the set to set 0 of the given bind point
+	void bind(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint) const;
+
+	VkDescriptorSetLayout set_layout() const { return _setLayout; }
+	// A layout with just the bindless set and the shared push constants, which every pipeline using the heap is compatible with
+	VkPipelineLayout pipeline_layout() const { return _pipelineLayout; }
+	VkPushConstantRange push_constant_range() const;
+
+	uint32_t texture_capacity() const { return _textureCapacity; }
+	uint32_t storage_buffer_capacity() const { return _storageBufferCapacity; }
+	uint32_t textures_in_use() const { return _textureCapacity - (uint32_t)_freeTextureSlots.size(); }
+	uint32_t storage_buffers_in_use() const { return _storageBufferCapacity - (uint32_t)_freeStorageBufferSlots.size(); }
+
+private:
+	VkDevice _device = VK_NULL_HANDLE;
+	VkDescriptorPool _pool = VK_NULL_HANDLE;
+	VkDescriptorSet _set = VK_NULL_HANDLE;
+	// Owned by the layout cache
+	VkDescriptorSetLayout _setLayout = VK_NULL_HANDLE;
+	VkPipelineLayout _pipelineLayout = VK_NULL_HANDLE;
+
+	uint32_t _textureCapacity = 0;
+	uint32_t _storageBufferCapacity = 0;
+
+	// Stacks of free slots, with the lowest slots on top so the used part of the arrays stays compact
+	std::vector<uint32_t> _freeTextureSlots;
+	std::vector<uint32_t> _freeStorageBufferSlots;
+};
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vk_types.h>
+
+// Where the memory of a buffer lives, and how the CPU gets to it
+enum class BufferMemory {
+	// Device local memory the CPU never touches. Filled with transfers.
+	GpuOnly,
+	// Mapped memory the CPU writes in order and the GPU reads, like staging buffers and per-frame data.
+	// Device local if the device has host visible device local memory (resizable BAR), host memory otherwise.
+	Upload,
+	// Mapped host memory the CPU writes in order and transfers copy from. Kept out of device local memory,
+	// which is better spent on the resources the copies go into.
+	Staging,
+	// Mapped host memory the GPU writes and the CPU reads back
+	Readback
+};
+
+namespace vkutil {
+	// Creates a buffer and its memory. Mapped buffers stay mapped for their whole lifetime.
+	// If usage contains VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, the device address is fetched as well.
+	AllocatedBuffer create_buffer(VmaAllocator allocator, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, BufferMemory memory);
+	void destroy_buffer(VmaAllocator allocator, const AllocatedBuffer& buffer);
+
+	// Buffers read by shaders through their device address, with a buffer_reference in GLSL.
+	// Vertices are stored in these as well, and pulled by the vertex shader with gl_VertexIndex, so pipelines need no vertex input state.
+	AllocatedBuffer create_storage_buffer(VmaAllocator allocator, VkDevice device, VkDeviceSize size, BufferMemory memory = BufferMemory::GpuOnly);
+	AllocatedBuffer create_index_buffer(VmaAllocator allocator, VkDevice device, VkDeviceSize size, BufferMemory memory = BufferMemory::GpuOnly);
+	AllocatedBuffer create_uniform_buffer(VmaAllocator allocator, VkDevice device, VkDeviceSize size, BufferMemory memory = BufferMemory::Upload);
+
+	VkDeviceAddress buffer_device_address(VkDevice device, VkBuffer buffer);
+
+	// Pushes a struct of push constants, typically holding device addresses and bindless slots.
+	// Pipelines using the bindless heap share one push constant range visible to every stage, so the default stages match it.
+	template<typename T>
+	void push_constants(VkCommandBuffer cmd, VkPipelineLayout layout, const T& constants, VkShaderStageFlags stages = VK_SHADER_STAGE_ALL)
+	{
+		static_assert(sizeof(T) % 4 == 0, "Push constants are written in 4 byte words");
+		vkCmdPushConstants(cmd, layout, stages, 0, sizeof(T), &constants);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <unordered_map>
+#include <vector>
+
+// The ways an image can be used in a frame.
+// Each usage maps to the layout the image has to be in, and the pipeline stages and accesses that touch it.
+enum class ImageUsage {
+	Undefined,
+	TransferSrc,
+	TransferDst,
+	ComputeStorageRead,
+	ComputeStorageWrite,
+	ComputeStorageReadWrite,
+	ComputeSampled,
+	FragmentSampled,
+	ColorAttachment,
+	Present
+};
+
+// What an image was last used for
+struct ImageState {
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 access = VK_ACCESS_2_NONE;
+};
+
+ImageState image_usage_state(ImageUsage usage);
+
+// Remembers the current layout, stages and access of every tracked image,
+// and turns declared usages into the smallest set of barriers needed to go from one usage to the next.
+//
+// Barriers are not recorded immediately. They are collected until flush() is called,
+// so that all transitions needed before a piece of work end up in a single vkCmdPipelineBarrier2 call.
+class ImageStateTracker {
+public:
+	// Starts tracking an image, which is assumed to be in the given state
+	void track(VkImage image, VkImageAspectFlags aspect, ImageState state = {});
+	void forget(VkImage image);
+
+	// Overrides the state of an image without emitting a barrier.
+	// Used when something outside of the command buffer changed the image, like acquiring a swapchain image.
+	void set_state(VkImage image, ImageState state);
+	ImageState get_state(VkImage image) const;
+
+	// Declares the next use of an image, queueing a barrier if one is needed.
+	// If discardContents is true, the current contents do not have to be preserved, which lets the layout transition start from undefined.
+	void use(VkImage image, ImageUsage usage, bool discardContents = false);
+
+	// Queues a global memory barrier, for dependencies that do not involve a tracked image (like buffer readbacks)
+	void memory_barrier(VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess);
+
+	// Records all queued barriers with a single pipeline barrier command
+	void flush(VkCommandBuffer cmd);
+
+	// Moves the queued barriers out, for callers that want to record them later or into another command buffer
+	void take_pending(std::vector<VkImageMemoryBarrier2>& imageBarriers, std::vector<VkMemoryBarrier2>& memoryBarriers);
+
+	// Debug counters, reset once per frame
+	uint32_t barriers_emitted() const { return _barriersEmitted; }
+	uint32_t barrier_batches_emitted() const { return _batchesEmitted; }
+	void reset_counters();
+
+private:
+	struct TrackedImage {
+		VkImageAspectFlags aspect;
+		ImageState state;
+	};
+
+	std::unordered_map<VkImage, TrackedImage> _images;
+	std::vector<VkImageMemoryBarrier2> _pendingImageBarriers;
+	std::vector<VkMemoryBarrier2> _pendingMemoryBarriers;
+
+	uint32_t _barriersEmitted = 0;
+	uint32_t _batchesEmitted = 0;
+};
\ No newline at end of file
@@ -4,4 +4,5 @@
 
 namespace vkutil {
 	void copy_image_to_image(VkCommandBuffer cmd, VkImage source, VkImage destination, VkExtent2D srcSize, VkExtent2D dstSize);
+	void copy_image_to_buffer(VkCommandBuffer cmd, VkImage source, VkBuffer destination, VkExtent2D size);
 }
\ No newline at end of file
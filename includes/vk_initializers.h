@@ -2,10 +2,24 @@
 
 #include <vulkan/vulkan.h>
 
+#include <vector>
+
 namespace vkinit {
 	VkImageCreateInfo image_create_info(VkFormat format, VkImageUsageFlags usageFlags, VkExtent3D extent);
 	VkImageViewCreateInfo imageview_create_info(VkFormat format, VkImage image, VkImageAspectFlags flags);
+	VkImageSubresourceRange image_subresource_range(VkImageAspectFlags aspectMask);
+	VkBufferCreateInfo buffer_create_info(VkDeviceSize size, VkBufferUsageFlags usageFlags);
 	VkPipelineLayoutCreateInfo pipeline_layout_create_info();
 	VkPipelineShaderStageCreateInfo pipeline_shader_stage_create_info(VkShaderStageFlagBits stage, VkShaderModule shaderModule, const char* entry = "main");
+	VkComputePipelineCreateInfo compute_pipeline_create_info(const VkPipelineShaderStageCreateInfo& stage, VkPipelineLayout layout);
+	VkPushConstantRange push_constant_range(VkShaderStageFlags stages, uint32_t size, uint32_t offset = 0);
+	VkSpecializationInfo specialization_info(const std::vector<VkSpecializationMapEntry>& entries, const void* data, size_t dataSize);
 	VkRenderingAttachmentInfo attachment_info(VkImageView imageView, VkClearValue* clear, VkImageLayout layout);
+	VkRenderingInfo rendering_info(VkExtent2D renderExtent, VkRenderingAttachmentInfo* colorAttachment, VkRenderingAttachmentInfo* depthAttachment);
+	VkSemaphoreSubmitInfo semaphore_submit_info(VkPipelineStageFlags2 stageMask, VkSemaphore semaphore, uint64_t value = 0);
+	VkCommandBufferSubmitInfo command_buffer_submit_info(VkCommandBuffer cmd);
+	VkSubmitInfo2 submit_info(VkCommandBufferSubmitInfo* cmd,
+		VkSemaphoreSubmitInfo* signalSemaphoreInfos, uint32_t signalSemaphoreCount,
+		VkSemaphoreSubmitInfo* waitSemaphoreInfos, uint32_t waitSemaphoreCount,
+		uint32_t commandBufferCount = 1);
 }
\ No newline at end of file
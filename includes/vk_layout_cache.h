@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <spirv_reflect.h>
+#include <hash.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Creates descriptor set layouts and pipeline layouts, and hands out the same layout every time the same one is described.
+// Layouts are hashed by their full description, so pipelines whose shaders declare the same bindings share their layouts,
+// and descriptor sets allocated for one of them are compatible with all of them.
+//
+// Layouts can also be built from shader reflection. The bindings of every shader in a pipeline are merged,
+// and bindings that disagree between shaders are reported when the pipeline is set up, instead of by the validation layers when it is used.
+// Layouts live until the cache is destroyed.
+class LayoutCache {
+public:
+	// A descriptor set layout created elsewhere (like the bindless set) to use for a set index, instead of one built from reflection
+	struct FixedSet {
+		uint32_t set;
+		VkDescriptorSetLayout layout;
+	};
+
+	void init(VkDevice device);
+	void destroy();
+
+	// Immutable samplers are not supported, as the samplers would have to be part of the key.
+	// bindingFlags is either empty or has one entry per binding.
+	VkDescriptorSetLayout get_descriptor_set_layout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+		VkDescriptorSetLayoutCreateFlags flags = 0, const std::vector<VkDescriptorBindingFlags>& bindingFlags = {});
+
+	VkPipelineLayout get_pipeline_layout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges);
+
+	// Builds the layout for a pipeline made of the given shaders.
+	// Push constants become a single range visible to every stage that declares them, sized for the largest block.
+	// If fixedPushConstants is given, that range is used instead, and every push constant block has to fit in it.
+	// Sets no shader uses, below the highest set that is used, get an empty layout.
+	// Returns VK_NULL_HANDLE with a reason in error if the shaders disagree on a binding, a binding does not match its fixed set,
+	// a runtime sized array is declared outside of a fixed set, or push constants do not fit the fixed range.
+	VkPipelineLayout reflect_pipeline_layout(const std::vector<const ShaderReflection*>& shaders, std::string& error,
+		const std::vector<FixedSet>& fixedSets = {}, const VkPushConstantRange* fixedPushConstants = nullptr);
+
+	uint32_t descriptor_set_layout_count() const { return (uint32_t)_setLayouts.size(); }
+	uint32_t pipeline_layout_count() const { return (uint32_t)_pipelineLayouts.size(); }
+
+private:
+	VkDevice _device = VK_NULL_HANDLE;
+
+	std::unordered_map<StateKey, VkDescriptorSetLayout, StateKeyHash> _setLayouts;
+	std::unordered_map<StateKey, VkPipelineLayout, StateKeyHash> _pipelineLayouts;
+
+	// The bindings every set layout was created with, to check shaders against fixed sets
+	std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSetLayoutBinding>> _setBindings;
+};
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vk_types.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What a piece of GPU memory is used for
+enum class MemoryCategory : uint32_t {
+	// Images created by the renderer, including the transient images of the render graph
+	Images,
+	// Buffers read by the GPU, including per-frame upload buffers
+	Buffers,
+	// Host memory that copies to the GPU are made from, and that GPU results are read back into
+	Staging,
+	Count
+};
+
+const char* memory_category_name(MemoryCategory category);
+
+namespace vkutil {
+	// Adds an allocation to the usage of its category, or removes it again before it is freed.
+	// Every place memory is allocated reports it here, as VMA itself does not know what memory is used for.
+	// The category is kept in the user data of the allocation. The tallies are shared by the whole process
+	// and can be updated from any thread.
+	void track_allocation(VmaAllocator allocator, VmaAllocation allocation, MemoryCategory category);
+	void untrack_allocation(VmaAllocator allocator, VmaAllocation allocation);
+}
+
+// Usage of one memory heap
+struct HeapBudget {
+	VkMemoryHeapFlags flags;
+	// Bytes the whole process uses on the heap, and how much it can use before things start to slow down or fail.
+	// Without VK_EXT_memory_budget, these are estimates made by VMA from its own allocations and the heap size.
+	VkDeviceSize usage;
+	VkDeviceSize budget;
+	// Memory blocks VMA has allocated from the heap, and the part of them handed out as allocations
+	VkDeviceSize block_bytes;
+	VkDeviceSize allocation_bytes;
+	uint32_t block_count;
+	uint32_t allocation_count;
+};
+
+struct CategoryUsage {
+	VkDeviceSize bytes;
+	uint32_t allocations;
+};
+
+// Keeps track of how much GPU memory is used, and how much is available.
+//
+// The heap budgets come from VK_EXT_memory_budget through VMA, which reports the usage of the whole process
+// and a budget the driver adjusts to other applications running on the same GPU.
+// Going over the budget makes the driver move memory out of VRAM or fail allocations, so a warning is logged
+// when a heap gets close to it.
+class MemoryBudget {
+public:
+	// Fraction of the budget at which a heap is considered close to running out
+	static constexpr double WARNING_THRESHOLD = 0.9;
+
+	// budgetExtension tells whether the allocator was created with VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT
+	void init(VmaAllocator allocator, bool budgetExtension);
+
+	// Queries the budgets and statistics again. Calculating the statistics walks every memory block,
+	// so this is done a few times per second instead of every frame. frameIndex has to be the current frame number.
+	void update(uint32_t frameIndex);
+
+	const std::vector<HeapBudget>& heaps() const { return _heaps; }
+	CategoryUsage category(MemoryCategory category) const;
+
+	// Usage and budget of the device local heaps combined, which is what runs out first
+	VkDeviceSize device_local_usage() const;
+	VkDeviceSize device_local_budget() const;
+
+	// Short single line summary, suitable for a window title or a log line
+	std::string summary() const;
+	bool write_json(const char* filePath) const;
+
+private:
+	VmaAllocator _allocator = VK_NULL_HANDLE;
+	bool _budgetExtension = false;
+	std::vector<HeapBudget> _heaps;
+	// Heaps that are over the warning threshold, so each crossing is only logged once
+	std::vector<bool> _warned;
+};
\ No newline at end of file
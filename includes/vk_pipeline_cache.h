@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+
+// A VkPipelineCache that is kept on disk between runs.
+// Drivers store compiled shader code in the cache, so pipelines created from a warm cache skip most of the compilation.
+//
+// Cache data is only valid for the exact driver and device that produced it, so the file starts with our own header
+// describing where the data came from. Files written by another GPU, a driver with another pipelineCacheUUID or an older build are ignored,
+// as are files that are truncated or corrupted.
+class PipelineCache {
+public:
+	// Creates the cache, filled with the contents of filePath if the file is valid for this device.
+	// An empty filePath disables loading and saving.
+	void init(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& filePath);
+
+	// Writes the current contents to disk. The file is replaced atomically, so a crash never leaves a half written cache.
+	void save() const;
+	void destroy();
+
+	VkPipelineCache handle() const { return _cache; }
+
+	// True if existing data was loaded, meaning pipeline creation should mostly be cache hits
+	bool warm() const { return _warm; }
+
+private:
+	VkDevice _device = VK_NULL_HANDLE;
+	VkPipelineCache _cache = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties _properties{};
+	std::string _filePath;
+	bool _warm = false;
+};
\ No newline at end of file
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vk_pipelines.h>
+#include <job_system.h>
+#include <deletionqueue.h>
+#include <hash.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A pipeline that might still be compiling. Shared between the registry and every handle to it.
+struct PipelineSlot {
+	std::string name;
+	// The state the pipeline was built from, kept around so the pipeline can be rebuilt when one of its shaders changes
+	PipelineBuilder builder;
+
+	std::atomic<VkPipeline> pipeline{ VK_NULL_HANDLE };
+	// Set once compilation has finished, even if it failed
+	std::atomic<bool> ready{ false };
+	JobCounter compiling;
+
+	// A rebuilt pipeline waiting to replace the current one at the next frame boundary
+	std::atomic<VkPipeline> rebuilt{ VK_NULL_HANDLE };
+	JobCounter rebuilding;
+	bool rebuildRequested = false;
+};
+
+// Future-like handle to a pipeline requested from the registry.
+// Until the pipeline has finished compiling, the fallback pipeline given with the request is returned in its place,
+// so the renderer can keep drawing (with a simpler look) instead of waiting on the compiler.
+class PipelineHandle {
+public:
+	bool valid() const { return _slot != nullptr; }
+	bool ready() const { return _slot != nullptr && _slot->ready.load(std::memory_order_acquire); }
+
+	// The compiled pipeline once it is ready, and the fallback pipeline until then or if it failed to compile.
+	// The pipeline can change when shaders are reloaded, so it should be fetched again every frame instead of stored.
+	VkPipeline get() const;
+
+private:
+	friend class PipelineRegistry;
+
+	std::shared_ptr<PipelineSlot> _slot;
+	std::shared_ptr<PipelineSlot> _fallback;
+};
+
+// Hands out graphics pipelines by the state they are built from.
+// The full state of a PipelineBuilder is hashed, and requesting the same state again returns the pipeline that was built the first time.
+// This way passes and materials can ask for the pipeline they need whenever they need it,
+// without creating duplicate pipelines or stalling on the driver compiling the same shaders again.
+//
+// Pipelines can be requested asynchronously, in which case they are compiled in the background on the job system's worker threads.
+// vkCreateGraphicsPipelines can be called from several threads at once, and the shared pipeline cache is synchronized by the driver.
+//
+// Shader module and pipeline layout handles are part of the state, so they have to stay alive as long as the registry does,
+// or be replaced through rebuild_with_shader(). Otherwise a new object could get the same handle
+// and be matched with a pipeline that was built for the old one.
+class PipelineRegistry {
+public:
+	void init(VkDevice device, VkPipelineCache cache, JobSystem* jobs);
+	// Destroys every pipeline handed out by the registry.
+	// The job system has to be shut down first, so no pipeline is still being compiled.
+	void destroy();
+
+	// Returns the pipeline for the builder's current state, building it on the calling thread if it has not been requested before.
+	// If the pipeline is being compiled in the background, this waits for it.
+	// Returns VK_NULL_HANDLE if the pipeline failed to build. Must be called from the main thread.
+	VkPipeline get_pipeline(const PipelineBuilder& builder, const char* name = "unnamed");
+
+	// Starts compiling the pipeline for the builder's current state in the background, unless it has been requested before.
+	// The builder is copied, so it can be reused right away. The name is only used for logging.
+	// Without worker threads the pipeline is compiled right away instead.
+	PipelineHandle request_pipeline(const char* name, const PipelineBuilder& builder, const PipelineHandle& fallback = {});
+
+	// Blocks until the pipeline of a handle has finished compiling. Must be called from the main thread.
+	void wait(const PipelineHandle& handle);
+
+	// Rebuilds every pipeline that uses oldModule with newModule instead, in the background.
+	// The rebuilt pipelines are swapped in by swap_rebuilt_pipelines(). Returns the number of pipelines being rebuilt.
+	// Once this returns, no pipeline is being built from oldModule anymore, so it can be destroyed.
+	uint32_t rebuild_with_shader(VkShaderModule oldModule, VkShaderModule newModule);
+
+	// Replaces pipelines with their rebuilt versions. Call at a frame boundary, before any pass fetches its pipelines.
+	// The old pipelines might still be used by frames in flight, so they are destroyed through retireQueue.
+	void swap_rebuilt_pipelines(DeletionQueue& retireQueue);
+
+	uint32_t pipeline_count();
+	// Requests that were answered with an existing pipeline
+	uint32_t cache_hits() const { return _cacheHits.load(); }
+
+private:
+	static StateKey make_key(const PipelineBuilder& builder);
+
+	// Builds the pipeline of a slot, and forgets the slot again if building failed
+	void compile(PipelineSlot& slot, uint64_t requestCounter);
+
+	VkDevice _device = VK_NULL_HANDLE;
+	VkPipelineCache _cache = VK_NULL_HANDLE;
+	JobSystem* _jobs = nullptr;
+
+	// Guards _pipelines. Slots themselves are only written by the thread compiling them.
+	std::mutex _mutex;
+	std::unordered_map<StateKey, std::shared_ptr<PipelineSlot>, StateKeyHash> _pipelines;
+	// Slots that were rebuilt into the state of another slot. Their handles are still in use, so they are kept
+	// (and rebuilt, swapped and destroyed) like the others, but new requests are answered by the slot that had the state first.
+	std::vector<std::shared_ptr<PipelineSlot>> _displacedSlots;
+	std::atomic<uint32_t> _cacheHits{ 0 };
+};
\ No newline at end of file
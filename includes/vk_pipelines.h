@@ -5,7 +5,10 @@
 #include <SDL3/SDL_log.h>
 
 #include <vk_initializers.h>
+#include <vk_layout_cache.h>
+#include <spirv_reflect.h>
 
+#include <cstring>
 #include <vector>
 
 class PipelineBuilder {
@@ -29,15 +32,114 @@ public:
 	void set_depth_format(VkFormat format);
 	void disable_depthtest();
 	void disable_blending();
+	// outColor = srcColor * srcAlpha + dstColor * (1 - srcAlpha)
+	void enable_blending_alphablend();
+	// outColor = srcColor * srcAlpha + dstColor
+	void enable_blending_additive();
 	void set_multisampling_none();
 	void set_cull_mode(VkCullModeFlags cullMode, VkFrontFace frontFace);
 	void set_polygon_mode(VkPolygonMode polygonMode);
 	void set_input_topology(VkPrimitiveTopology topology);
 	void set_shaders(VkShaderModule vertexShader, VkShaderModule fragmentShader);
 	void clear();
-	VkPipeline build_pipeline(VkDevice device);
+
+	// Every piece of state that affects the built pipeline, flattened into a list of words.
+	// Two builders with the same key build identical pipelines.
+	std::vector<uint32_t> state_key() const;
+	// Pipelines built with the same cache reuse each other's compiled shader code
+	VkPipeline build_pipeline(VkDevice device, VkPipelineCache cache = VK_NULL_HANDLE) const;
+};
+
+// Size of a compute workgroup, in invocations
+struct WorkgroupSize {
+	uint32_t x = 1;
+	uint32_t y = 1;
+	uint32_t z = 1;
+};
+
+// The compute counterpart of PipelineBuilder. A compute pipeline is a shader, its specialization constants and a layout.
+//
+// The workgroup size is picked when the pipeline is built instead of being fixed in the shader, through specialization constants.
+// Shaders declare it with:
+//   layout (local_size_x_id = 0, local_size_y_id = 1, local_size_z_id = 2) in;
+// so constant ids 0 to 2 are taken by the workgroup size, and the shader's own constants start at FIRST_SPECIALIZATION_ID.
+// Once a workgroup size is set, it replaces any constant given for ids 0 to 2.
+// workgroup_size() is meant to be handed to vkutil::dispatch. For shaders with a fixed local size it is only right
+// if the shader was set together with its reflection, otherwise the builder has no way of knowing the size.
+//
+// The layout is either set directly in _pipelineLayout (like one reflected by the layout cache),
+// or described with set layouts and push constant ranges and built by build_layout.
+class ComputePipelineBuilder {
+public:
+	static constexpr uint32_t WORKGROUP_SIZE_X_ID = 0;
+	static constexpr uint32_t WORKGROUP_SIZE_Y_ID = 1;
+	static constexpr uint32_t WORKGROUP_SIZE_Z_ID = 2;
+	static constexpr uint32_t FIRST_SPECIALIZATION_ID = 3;
+
+	VkPipelineShaderStageCreateInfo _shaderStage;
+	VkPipelineLayout _pipelineLayout;
+
+	ComputePipelineBuilder() {
+		clear();
+	}
+
+	void set_shader(VkShaderModule computeShader, const char* entry = "main");
+	// Also takes the shader's local size from its reflection, which workgroup_size() returns until a size is set
+	void set_shader(VkShaderModule computeShader, const ShaderReflection& reflection, const char* entry = "main");
+
+	// Only used if set, otherwise the shader's own local size is used.
+	// Exits with an error if the size is 0 along any axis or is larger than the device allows.
+	void set_workgroup_size(WorkgroupSize size, const VkPhysicalDeviceLimits& limits);
+	// The size set with set_workgroup_size, or else the shader's local size if its reflection was given, or else 1 x 1 x 1
+	WorkgroupSize workgroup_size() const { return _hasWorkgroupSize ? _workgroupSize : _shaderLocalSize; }
+
+	// Specialization constants are 32 bits wide. Booleans have to be given as VkBool32.
+	// Setting the same id again replaces the value.
+	template<typename T>
+	void set_specialization_constant(uint32_t id, T value)
+	{
+		static_assert(sizeof(T) == sizeof(uint32_t), "Specialization constants are 32 bit, use VkBool32 for booleans");
+
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		set_specialization_word(id, bits);
+	}
+
+	void add_descriptor_set_layout(VkDescriptorSetLayout layout);
+	void add_push_constant_range(uint32_t size, uint32_t offset = 0);
+	// Builds _pipelineLayout from the set layouts and push constant ranges added so far, through the cache so equal layouts are shared
+	VkPipelineLayout build_layout(LayoutCache& layouts);
+
+	void clear();
+
+	VkPipeline build_pipeline(VkDevice device, VkPipelineCache cache = VK_NULL_HANDLE) const;
+
+private:
+	void set_specialization_word(uint32_t id, uint32_t bits);
+
+	bool _hasWorkgroupSize;
+	WorkgroupSize _workgroupSize;
+	WorkgroupSize _shaderLocalSize;
+
+	std::vector<VkSpecializationMapEntry> _specializationEntries;
+	// One word per entry, at the entry's offset
+	std::vector<uint32_t> _specializationData;
+
+	std::vector<VkDescriptorSetLayout> _setLayouts;
+	std::vector<VkPushConstantRange> _pushConstantRanges;
 };
 
 namespace vkutil {
-	bool load_shader_module(const char* filePath, VkDevice device, VkShaderModule* outShaderModule);
+	// If reflection is not null, the stage, bindings and push constants of the shader are read into it as well
+	bool load_shader_module(const char* filePath, VkDevice device, VkShaderModule* outShaderModule, ShaderReflection* reflection = nullptr);
+
+	// Workgroups needed to cover count items with groups of groupSize, rounding up. Exits with an error if groupSize is 0.
+	uint32_t group_count(uint32_t count, uint32_t groupSize);
+
+	// Dispatches enough workgroups to cover every texel of an extent, like an image the shader writes a texel of per invocation.
+	// Invocations past the edge of the extent have to be skipped by the shader.
+	void dispatch(VkCommandBuffer cmd, VkExtent3D extent, WorkgroupSize groupSize);
+	void dispatch(VkCommandBuffer cmd, VkExtent2D extent, WorkgroupSize groupSize);
+	// Dispatches enough workgroups along x to cover count elements, like a buffer the shader handles an element of per invocation
+	void dispatch(VkCommandBuffer cmd, uint32_t count, uint32_t groupSize);
 }
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// A GPU timeline backed by a single timeline semaphore.
+// Timeline semaphores hold a 64 bit counter instead of a signaled/unsignaled state.
+// Every submission signals the next value on the timeline, so any piece of work is identified by a single number,
+// and both the CPU and other submissions can wait for "everything up to value N" to have finished.
+// Unlike fences, a timeline never has to be reset.
+struct Timeline {
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	// The value signaled by the most recent submission
+	uint64_t submitted_value = 0;
+
+	VkResult init(VkDevice device);
+	void destroy(VkDevice device);
+
+	// Reserves the next value on the timeline, to be signaled by a submission
+	uint64_t next_value();
+
+	// The highest value the GPU has signaled so far
+	uint64_t completed_value(VkDevice device) const;
+
+	// Blocks the CPU until the GPU has signaled value, or the timeout (in nanoseconds) has passed
+	VkResult wait(VkDevice device, uint64_t value, uint64_t timeout) const;
+};
\ No newline at end of file
@@ -4,10 +4,25 @@
 
 #include <vma/vk_mem_alloc.h>
 
+// Exits with an error if a Vulkan call did not succeed
+void vk_check(VkResult vkResult);
+// Logs a printf style error and exits. For errors the game can not continue after, like a missing shader.
+void panic_and_exit(const char* error_message, ...);
+
 struct AllocatedImage {
 	VkImage image;
 	VkImageView imageView;
 	VmaAllocation allocation;
 	VkExtent3D imageExtent;
 	VkFormat imageFormat;
+};
+
+struct AllocatedBuffer {
+	VkBuffer buffer;
+	VmaAllocation allocation;
+	// info.pMappedData points to the contents of buffers that are mapped
+	VmaAllocationInfo info;
+	VkDeviceSize size;
+	// Address for shaders to read the buffer through, 0 unless the buffer was created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+	VkDeviceAddress deviceAddress;
 };
\ No newline at end of file
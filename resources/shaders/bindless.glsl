@@ -0,0 +1,19 @@
+// Declarations of the bindless descriptor set, shared by every shader that uses it.
+// Include with:
+//   #extension GL_GOOGLE_include_directive : require
+//   #include "bindless.glsl"
+//
+// Must match BindlessHeap in includes/vk_bindless.h.
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+#define BINDLESS_SET 0
+#define BINDLESS_STORAGE_BUFFER_BINDING 0
+#define BINDLESS_TEXTURE_BINDING 1
+
+// Every texture added to the heap, indexed by the slot add_texture() returned.
+// Indices that differ between invocations of a draw have to be wrapped in nonuniformEXT().
+layout (set = BINDLESS_SET, binding = BINDLESS_TEXTURE_BINDING) uniform sampler2D bindlessTextures[];
+
+// Storage buffers are declared by the shaders using them, as only they know the type of the contents:
+//   layout (set = BINDLESS_SET, binding = BINDLESS_STORAGE_BUFFER_BINDING) readonly buffer Tiles { uint ids[]; } tileBuffers[];
\ No newline at end of file
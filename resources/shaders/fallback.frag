@@ -0,0 +1,11 @@
+#version 450
+
+// output write
+layout (location = 0) out vec4 outFragColor;
+
+// Used while the real pipeline of a draw is still compiling.
+// It only writes a flat color, so it compiles quickly and makes missing pipelines easy to spot.
+void main()
+{
+    outFragColor = vec4(0.5f, 0.5f, 0.5f, 1.0f);
+}
\ No newline at end of file
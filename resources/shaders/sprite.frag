@@ -0,0 +1,17 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+#include "bindless.glsl"
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) flat in vec4 inTint;
+layout (location = 2) flat in uint inTexture;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+    // Sprites in the same draw can use different textures
+    float coverage = texture(bindlessTextures[nonuniformEXT(inTexture)], inUV).r;
+    outFragColor = vec4(inTint.rgb, inTint.a * coverage);
+}
\ No newline at end of file
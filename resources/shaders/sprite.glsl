@@ -0,0 +1,27 @@
+// Declarations shared by the sprite shaders.
+// Must match SpriteInstance and SpritePushConstants in includes/sprite_batch.h.
+
+#extension GL_EXT_buffer_reference : require
+
+struct SpriteInstance {
+    vec2 position;
+    uint cell;
+    // RGBA8, red in the lowest byte
+    uint tint;
+    uint texture;
+    uint padding;
+};
+
+// The sorted sprites of the frame, in the frame arena
+layout (buffer_reference, std430) readonly buffer SpriteInstances {
+    SpriteInstance sprites[];
+};
+
+layout (push_constant) uniform SpritePushConstants {
+    SpriteInstances instances;
+    // Top left corner of the map and the size of a tile, in pixels
+    vec2 origin;
+    vec2 tileSize;
+    vec2 viewportSize;
+    uint atlasColumns;
+} pc;
\ No newline at end of file
@@ -0,0 +1,30 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+#include "sprite.glsl"
+
+layout (location = 0) out vec2 outUV;
+layout (location = 1) flat out vec4 outTint;
+layout (location = 2) flat out uint outTexture;
+
+// Two triangles covering the unit square
+const vec2 CORNERS[6] = vec2[6](
+    vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+    vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0)
+);
+
+void main()
+{
+    // Every instance is one sprite. gl_InstanceIndex starts at the draw's first instance, so it indexes the whole frame's sprites.
+    SpriteInstance sprite = pc.instances.sprites[gl_InstanceIndex];
+
+    vec2 corner = CORNERS[gl_VertexIndex];
+
+    vec2 pixel = pc.origin + (sprite.position + corner) * pc.tileSize;
+    gl_Position = vec4(pixel / pc.viewportSize * 2.0 - 1.0, 0.0, 1.0);
+
+    vec2 cell = vec2(sprite.cell % pc.atlasColumns, sprite.cell / pc.atlasColumns);
+    outUV = (cell + corner) / float(pc.atlasColumns);
+    outTint = unpackUnorm4x8(sprite.tint);
+    outTexture = sprite.texture;
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+// Where the tiles of a TileMap are in its storage buffer, shared by every shader reading tiles.
+// Include after bindless.glsl. Must match TileMap in includes/tile_map.h.
+
+// Tiles are stored in square chunks of this many tiles per side, one chunk after the other. Must match TileMap::CHUNK_SIZE.
+#define TILE_CHUNK_SIZE 16
+
+// Two tiles are packed into every word
+layout (set = BINDLESS_SET, binding = BINDLESS_STORAGE_BUFFER_BINDING) readonly buffer TileBuffer {
+    uint tiles[];
+} tileBuffers[];
+
+uint read_tile(uint tileBuffer, uint mapWidth, uint x, uint y)
+{
+    // Find the tile within its chunk
+    uint chunksX = (mapWidth + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+    uint chunk = (y / TILE_CHUNK_SIZE) * chunksX + x / TILE_CHUNK_SIZE;
+    uint index = chunk * TILE_CHUNK_SIZE * TILE_CHUNK_SIZE + (y % TILE_CHUNK_SIZE) * TILE_CHUNK_SIZE + x % TILE_CHUNK_SIZE;
+
+    uint packedTiles = tileBuffers[tileBuffer].tiles[index / 2];
+    return (index % 2 == 0) ? (packedTiles & 0xFFFF) : (packedTiles >> 16);
+}
\ No newline at end of file
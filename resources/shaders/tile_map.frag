@@ -0,0 +1,23 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+#include "bindless.glsl"
+#include "tile_map.glsl"
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) flat in vec3 inColor;
+layout (location = 2) in vec2 inLightUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+    // The atlas only holds the coverage of the glyphs, the color comes from the tile
+    float coverage = texture(bindlessTextures[pc.atlasTexture], inUV).r;
+    vec3 light = vec3(1.0);
+    if (pc.lightTexture != TILE_NO_LIGHT) {
+        light = texture(bindlessTextures[pc.lightTexture], inLightUV).rgb;
+    }
+
+    outFragColor = vec4(inColor * light, coverage);
+}
\ No newline at end of file
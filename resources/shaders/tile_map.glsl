@@ -0,0 +1,38 @@
+// Declarations shared by the tile map shaders.
+// Must match TileMapPushConstants in includes/tile_renderer.h and TileColor in includes/tile_map.h.
+
+layout (push_constant) uniform TileMapPushConstants {
+    // Top left corner of the map and the size of a tile, in pixels
+    vec2 origin;
+    vec2 tileSize;
+    vec2 viewportSize;
+    uint mapWidth;
+    uint mapHeight;
+    // Bindless slots of the tile buffer and the glyph atlas
+    uint tileBuffer;
+    uint atlasTexture;
+    uint atlasColumns;
+    // Bindless slot of the light texture, with one texel per tile, or TILE_NO_LIGHT to draw the map fully lit
+    uint lightTexture;
+} pc;
+
+#define TILE_NO_LIGHT 0xFFFFFFFFu
+
+const vec3 TILE_PALETTE[16] = vec3[16](
+    vec3(0.00, 0.00, 0.00), // Black
+    vec3(0.25, 0.25, 0.28), // DarkGray
+    vec3(0.55, 0.55, 0.58), // Gray
+    vec3(1.00, 1.00, 1.00), // White
+    vec3(0.85, 0.20, 0.20), // Red
+    vec3(0.95, 0.55, 0.15), // Orange
+    vec3(0.95, 0.85, 0.25), // Yellow
+    vec3(0.35, 0.80, 0.30), // Green
+    vec3(0.15, 0.45, 0.15), // DarkGreen
+    vec3(0.30, 0.80, 0.85), // Cyan
+    vec3(0.30, 0.45, 0.95), // Blue
+    vec3(0.12, 0.18, 0.50), // DarkBlue
+    vec3(0.60, 0.30, 0.80), // Purple
+    vec3(0.50, 0.33, 0.18), // Brown
+    vec3(0.80, 0.70, 0.50), // Tan
+    vec3(0.95, 0.55, 0.75)  // Pink
+);
\ No newline at end of file
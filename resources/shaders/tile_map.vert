@@ -0,0 +1,50 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+#include "bindless.glsl"
+#include "tile_map.glsl"
+#include "tile_layout.glsl"
+
+layout (location = 0) out vec2 outUV;
+layout (location = 1) flat out vec3 outColor;
+layout (location = 2) out vec2 outLightUV;
+
+// Two triangles covering the unit square
+const vec2 CORNERS[6] = vec2[6](
+    vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+    vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0)
+);
+
+void main()
+{
+    // Every instance is one tile of the map, going row by row
+    uint x = gl_InstanceIndex % pc.mapWidth;
+    uint y = gl_InstanceIndex / pc.mapWidth;
+    uint tile = read_tile(pc.tileBuffer, pc.mapWidth, x, y);
+
+    uint glyph = tile & 0xFF;
+    uint color = (tile >> 8) & 0xF;
+
+    // Empty tiles collapse to a single point outside of the viewport, which produces no fragments
+    if (glyph == 0) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        outUV = vec2(0.0);
+        outColor = vec3(0.0);
+        outLightUV = vec2(0.0);
+        return;
+    }
+
+    vec2 corner = CORNERS[gl_VertexIndex];
+    vec2 cell = vec2(x, y);
+
+    vec2 pixel = pc.origin + (cell + corner) * pc.tileSize;
+    gl_Position = vec4(pixel / pc.viewportSize * 2.0 - 1.0, 0.0, 1.0);
+
+    vec2 glyphCell = vec2(glyph % pc.atlasColumns, glyph / pc.atlasColumns);
+    outUV = (glyphCell + corner) / float(pc.atlasColumns);
+    outColor = TILE_PALETTE[color];
+
+    // The light texture has a texel per tile, centered on the tile. The corners of the quad fall between texels,
+    // so filtering blends the light of neighbouring tiles across the tile instead of lighting it flat.
+    outLightUV = (cell + corner) / vec2(pc.mapWidth, pc.mapHeight);
+}
\ No newline at end of file
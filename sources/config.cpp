@@ -0,0 +1,248 @@
+#include <config.h>
+
+#include <SDL3/SDL_log.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace {
+	std::string trim(const std::string& value)
+	{
+		size_t begin = value.find_first_not_of(" \t\r\n");
+		if (begin == std::string::npos) {
+			return "";
+		}
+
+		size_t end = value.find_last_not_of(" \t\r\n");
+		return value.substr(begin, end - begin + 1);
+	}
+
+	bool parse_bool(const std::string& value, bool& out)
+	{
+		if (value == "true" || value == "1" || value == "yes") {
+			out = true;
+			return true;
+		}
+
+		if (value == "false" || value == "0" || value == "no") {
+			out = false;
+			return true;
+		}
+
+		return false;
+	}
+
+	bool parse_uint(const std::string& value, uint32_t& out)
+	{
+		// strtoul skips whitespace and accepts a sign, wrapping negative numbers around to huge ones, so only digits are allowed
+		if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+			return false;
+		}
+
+		errno = 0;
+		char* end = nullptr;
+		unsigned long long parsed = strtoull(value.c_str(), &end, 10);
+		if (errno == ERANGE || *end != '\0' || parsed > UINT32_MAX) {
+			return false;
+		}
+
+		out = (uint32_t)parsed;
+		return true;
+	}
+
+	// Like parse_uint, but values outside of [min, max] are invalid as well and leave out unchanged
+	bool parse_uint_in_range(const std::string& value, uint32_t min, uint32_t max, uint32_t& out)
+	{
+		uint32_t parsed;
+		if (!parse_uint(value, parsed) || parsed < min || parsed > max) {
+			return false;
+		}
+
+		out = parsed;
+		return true;
+	}
+
+	bool parse_present_mode(const std::string& value, VkPresentModeKHR& out)
+	{
+		if (value == "fifo") {
+			out = VK_PRESENT_MODE_FIFO_KHR;
+		}
+		else if (value == "fifo_relaxed") {
+			out = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+		}
+		else if (value == "mailbox") {
+			out = VK_PRESENT_MODE_MAILBOX_KHR;
+		}
+		else if (value == "immediate") {
+			out = VK_PRESENT_MODE_IMMEDIATE_KHR;
+		}
+		else {
+			return false;
+		}
+
+		return true;
+	}
+
+	// Sets a single config value. Returns false if the key is unknown or the value is invalid.
+	bool set_config_value(EngineConfig& config, const std::string& key, const std::string& value)
+	{
+		if (key == "window_width") {
+			return parse_uint_in_range(value, 1, MAX_WINDOW_SIZE, config.window_width);
+		}
+		if (key == "window_height") {
+			return parse_uint_in_range(value, 1, MAX_WINDOW_SIZE, config.window_height);
+		}
+		if (key == "frames_in_flight") {
+			if (!parse_uint(value, config.frames_in_flight)) {
+				return false;
+			}
+
+			config.frames_in_flight = std::clamp(config.frames_in_flight, 1u, MAX_FRAMES_IN_FLIGHT);
+			return true;
+		}
+		if (key == "present_mode") {
+			return parse_present_mode(value, config.present_mode);
+		}
+		if (key == "target_fps") {
+			return parse_uint(value, config.target_fps);
+		}
+		if (key == "worker_threads") {
+			if (value == "auto") {
+				config.worker_threads = WORKER_THREADS_AUTO;
+				return true;
+			}
+			if (!parse_uint(value, config.worker_threads)) {
+				return false;
+			}
+
+			config.worker_threads = std::min(config.worker_threads, MAX_WORKER_THREADS);
+			return true;
+		}
+		if (key == "headless") {
+			return parse_bool(value, config.headless);
+		}
+		if (key == "frames") {
+			return parse_uint(value, config.headless_frame_count);
+		}
+		if (key == "capture") {
+			config.headless_capture_path = value;
+			return true;
+		}
+		if (key == "timings_csv") {
+			config.timings_csv_path = value;
+			return true;
+		}
+		if (key == "memory_stats") {
+			config.memory_stats_path = value;
+			return true;
+		}
+		if (key == "frame_arena_kb") {
+			return parse_uint_in_range(value, MIN_FRAME_ARENA_KB, MAX_FRAME_ARENA_KB, config.frame_arena_kb);
+		}
+		if (key == "pipeline_cache") {
+			config.pipeline_cache_path = value;
+			return true;
+		}
+		if (key == "shader_hot_reload") {
+			return parse_bool(value, config.shader_hot_reload);
+		}
+		if (key == "shader_compiler") {
+			config.shader_compiler = value;
+			return true;
+		}
+
+		return false;
+	}
+}
+
+bool load_config_file(const char* filePath, EngineConfig& config)
+{
+	std::ifstream file(filePath);
+
+	if (!file.is_open()) {
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line)) {
+		lineNumber++;
+
+		line = trim(line);
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+
+		size_t separator = line.find('=');
+		if (separator == std::string::npos) {
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "%s:%i: expected 'key = value'", filePath, lineNumber);
+			continue;
+		}
+
+		std::string key = trim(line.substr(0, separator));
+		std::string value = trim(line.substr(separator + 1));
+
+		if (!set_config_value(config, key, value)) {
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "%s:%i: ignoring invalid setting '%s = %s'", filePath, lineNumber, key.c_str(), value.c_str());
+		}
+	}
+
+	return true;
+}
+
+void apply_command_line(int argc, char** argv, EngineConfig& config)
+{
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--", 2) != 0) {
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Ignoring unknown command line argument: %s", argv[i]);
+			continue;
+		}
+
+		std::string key = argv[i] + 2;
+		std::replace(key.begin(), key.end(), '-', '_');
+
+		// --config is handled before the config file is loaded
+		if (key == "config") {
+			i++;
+			continue;
+		}
+
+		// Flags without a value
+		if (key == "headless") {
+			config.headless = true;
+			continue;
+		}
+
+		if (i + 1 >= argc || !set_config_value(config, key, argv[i + 1])) {
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Ignoring invalid command line argument: %s", argv[i]);
+			continue;
+		}
+
+		i++;
+	}
+}
+
+const char* config_file_path(int argc, char** argv)
+{
+	for (int i = 1; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "--config") == 0) {
+			return argv[i + 1];
+		}
+	}
+
+	return "resources/roguelike-x.cfg";
+}
+
+const char* present_mode_name(VkPresentModeKHR presentMode)
+{
+	switch (presentMode) {
+		case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo_relaxed";
+		case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+		case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+		default: return "unknown";
+	}
+}
\ No newline at end of file
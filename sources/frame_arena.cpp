@@ -0,0 +1,77 @@
+#include <frame_arena.h>
+#include <vk_types.h>
+#include <vk_buffers.h>
+#include <align.h>
+
+#include <SDL3/SDL_log.h>
+
+#include <algorithm>
+
+void FrameArena::init(VmaAllocator allocator, VkDevice device, VkDeviceSize capacity, VkDeviceSize minAlignment)
+{
+	_allocator = allocator;
+	_minAlignment = minAlignment;
+
+	// Vulkan does not allow empty buffers, and an arena smaller than its alignment could not hold a single allocation
+	if (capacity < std::max<VkDeviceSize>(minAlignment, 1)) {
+		panic_and_exit("Frame arena of %llu bytes is smaller than its alignment of %llu bytes",
+			(unsigned long long)capacity, (unsigned long long)minAlignment);
+	}
+
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+	_buffer = vkutil::create_buffer(_allocator, device, capacity, usage, BufferMemory::Upload);
+
+	_flushed = 0;
+	_stats = {};
+	_stats.capacity = capacity;
+}
+
+void FrameArena::destroy()
+{
+	vkutil::destroy_buffer(_allocator, _buffer);
+}
+
+FrameAllocation FrameArena::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	alignment = std::max(alignment, _minAlignment);
+	VkDeviceSize offset = vkutil::align_up(_stats.used, alignment);
+
+	if (offset + size > _stats.capacity) {
+		// Logged once, so a frame that overflows does not flood the log. The high water mark shows by how much.
+		if (_stats.failed_allocations == 0) {
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Frame arena of %llu bytes is full, allocation of %llu bytes failed",
+				(unsigned long long)_stats.capacity, (unsigned long long)size);
+		}
+		_stats.failed_allocations++;
+		_stats.high_water_mark = std::max(_stats.high_water_mark, offset + size);
+		return {};
+	}
+
+	_stats.used = offset + size;
+	_stats.high_water_mark = std::max(_stats.high_water_mark, _stats.used);
+
+	FrameAllocation allocation;
+	allocation.data = (uint8_t*)_buffer.info.pMappedData + offset;
+	allocation.buffer = _buffer.buffer;
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.deviceAddress = _buffer.deviceAddress + offset;
+
+	return allocation;
+}
+
+void FrameArena::flush()
+{
+	// Does nothing on host coherent memory
+	if (_stats.used > _flushed) {
+		vk_check(vmaFlushAllocation(_allocator, _buffer.allocation, _flushed, _stats.used - _flushed));
+		_flushed = _stats.used;
+	}
+}
+
+void FrameArena::reset()
+{
+	_stats.used = 0;
+	_flushed = 0;
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include <frame_capture.h>
+#include <hash.h>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+float vkutil::half_to_float(uint16_t half)
+{
+	// A half float is laid out as 1 sign bit, 5 exponent bits and 10 mantissa bits
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+
+	uint32_t bits;
+	if (exponent == 0) {
+		if (mantissa == 0) {
+			// Signed zero
+			bits = sign;
+		}
+		else {
+			// Subnormal half, renormalize it as a regular float
+			exponent = 127 - 15 + 1;
+			while ((mantissa & 0x400) == 0) {
+				mantissa <<= 1;
+				exponent--;
+			}
+			mantissa &= 0x3FF;
+			bits = sign | (exponent << 23) | (mantissa << 13);
+		}
+	}
+	else if (exponent == 0x1F) {
+		// Infinity or NaN
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else {
+		// Rebias the exponent from 15 to 127
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+uint64_t vkutil::frame_checksum(const void* data, size_t size)
+{
+	return hash_bytes(data, size);
+}
+
+bool vkutil::write_frame_ppm(const char* filePath, const void* pixels, uint32_t width, uint32_t height)
+{
+	std::ofstream file(filePath, std::ios::binary);
+
+	if (!file.is_open()) {
+		return false;
+	}
+
+	// PPM header: magic number, dimensions and max color value
+	file << "P6\n" << width << " " << height << "\n255\n";
+
+	const uint16_t* source = (const uint16_t*)pixels;
+
+	std::vector<uint8_t> row(width * 3);
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			const uint16_t* pixel = source + (y * width + x) * 4;
+
+			for (uint32_t c = 0; c < 3; c++) {
+				float value = half_to_float(pixel[c]);
+
+				// NaN fails both comparisons, so check for "not inside" rather than "outside"
+				if (!(value > 0.0f)) {
+					value = 0.0f;
+				}
+				else if (value > 1.0f) {
+					value = 1.0f;
+				}
+
+				row[x * 3 + c] = (uint8_t)(value * 255.0f + 0.5f);
+			}
+		}
+
+		file.write((const char*)row.data(), row.size());
+	}
+
+	return file.good();
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include <frame_pacer.h>
+
+#include <SDL3/SDL_timer.h>
+
+#include <algorithm>
+
+namespace {
+	// OS sleeps can overshoot by around a millisecond, so the final part of a wait is spent spinning
+	constexpr uint64_t SPIN_THRESHOLD_NS = 1000000;
+
+	uint64_t ticks_to_ns(uint64_t ticks)
+	{
+		return (uint64_t)((double)ticks * 1000000000.0 / (double)SDL_GetPerformanceFrequency());
+	}
+
+	void sleep_until(uint64_t deadline)
+	{
+		uint64_t now = SDL_GetPerformanceCounter();
+		if (now >= deadline) {
+			return;
+		}
+
+		uint64_t remainingNs = ticks_to_ns(deadline - now);
+		if (remainingNs > SPIN_THRESHOLD_NS) {
+			SDL_DelayNS(remainingNs - SPIN_THRESHOLD_NS);
+		}
+
+		while (SDL_GetPerformanceCounter() < deadline) {
+		}
+	}
+}
+
+void FramePacer::set_target_fps(uint32_t targetFps)
+{
+	_targetPeriod = targetFps > 0 ? SDL_GetPerformanceFrequency() / targetFps : 0;
+	_nextDeadline = 0;
+}
+
+void FramePacer::wait_before_input()
+{
+	uint64_t now = SDL_GetPerformanceCounter();
+
+	if (_targetPeriod == 0) {
+		_inputSampleTime = now;
+		return;
+	}
+
+	if (_nextDeadline == 0) {
+		_nextDeadline = now + _targetPeriod;
+	}
+
+	// Leave room for the work the frame is expected to do, plus a little headroom for variance
+	uint64_t headroom = _workEstimate / 8;
+	uint64_t budget = _workEstimate + headroom;
+
+	if (_nextDeadline > now + budget) {
+		sleep_until(_nextDeadline - budget);
+	}
+
+	_inputSampleTime = SDL_GetPerformanceCounter();
+}
+
+void FramePacer::end_frame()
+{
+	uint64_t now = SDL_GetPerformanceCounter();
+
+	if (_targetPeriod == 0) {
+		return;
+	}
+
+	// Rise quickly on slow frames but decay slowly, so a single fast frame does not cause a missed deadline
+	uint64_t work = now - _inputSampleTime;
+	if (work > _workEstimate) {
+		_workEstimate = work;
+	}
+	else {
+		_workEstimate = (_workEstimate * 15 + work) / 16;
+	}
+
+	// Never budget more than a full period for the work, otherwise we would never sleep at all
+	_workEstimate = std::min(_workEstimate, _targetPeriod);
+
+	_nextDeadline += _targetPeriod;
+
+	// If we fell behind, start over from now instead of trying to catch up with a burst of frames
+	if (_nextDeadline < now) {
+		_nextDeadline = now + _targetPeriod;
+	}
+}
\ No newline at end of file
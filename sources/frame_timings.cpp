@@ -0,0 +1,191 @@
+#include <frame_timings.h>
+
+#include <SDL3/SDL_timer.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+const char* frame_stage_name(FrameStage stage)
+{
+	switch (stage) {
+		case FrameStage::Wait: return "wait";
+		case FrameStage::Pace: return "pace";
+		case FrameStage::Acquire: return "acquire";
+		case FrameStage::Record: return "record";
+		case FrameStage::Submit: return "submit";
+		case FrameStage::Present: return "present";
+		case FrameStage::CpuFrame: return "cpu_frame";
+		case FrameStage::GpuFrame: return "gpu_frame";
+		default: return "unknown";
+	}
+}
+
+const char* frame_counter_name(FrameCounter counter)
+{
+	switch (counter) {
+		case FrameCounter::Barriers: return "barriers";
+		case FrameCounter::BarrierBatches: return "barrier_batches";
+		case FrameCounter::UploadBytes: return "upload_bytes";
+		case FrameCounter::ArenaBytes: return "arena_bytes";
+		case FrameCounter::TileUploadBytes: return "tile_upload_bytes";
+		case FrameCounter::TileUploadRegions: return "tile_upload_regions";
+		case FrameCounter::Sprites: return "sprites";
+		case FrameCounter::SpriteDraws: return "sprite_draws";
+		case FrameCounter::Lights: return "lights";
+		default: return "unknown";
+	}
+}
+
+void FrameTimings::begin_frame(uint64_t frameNumber)
+{
+	_current = (_current + 1) % HISTORY_SIZE;
+	_frameNumbers[_current] = frameNumber;
+
+	for (uint32_t stage = 0; stage < (uint32_t)FrameStage::Count; stage++) {
+		_history[_current][stage] = 0.0;
+	}
+
+	for (uint32_t counter = 0; counter < (uint32_t)FrameCounter::Count; counter++) {
+		_counters[_current][counter] = 0;
+	}
+}
+
+void FrameTimings::record(FrameStage stage, double milliseconds)
+{
+	_history[_current][(uint32_t)stage] = milliseconds;
+}
+
+void FrameTimings::count(FrameCounter counter, uint64_t value)
+{
+	_counters[_current][(uint32_t)counter] = value;
+}
+
+void FrameTimings::end_frame()
+{
+	if (_count < HISTORY_SIZE) {
+		_count++;
+	}
+
+	if (!_csv.is_open()) {
+		return;
+	}
+
+	_csv << _frameNumbers[_current];
+	for (uint32_t stage = 0; stage < (uint32_t)FrameStage::Count; stage++) {
+		_csv << "," << _history[_current][stage];
+	}
+	for (uint32_t counter = 0; counter < (uint32_t)FrameCounter::Count; counter++) {
+		_csv << "," << _counters[_current][counter];
+	}
+	_csv << "\n";
+}
+
+void FrameTimings::discard_frame()
+{
+	_current = (_current + HISTORY_SIZE - 1) % HISTORY_SIZE;
+}
+
+FrameStageStats FrameTimings::stats(FrameStage stage) const
+{
+	FrameStageStats result{};
+
+	if (_count == 0) {
+		return result;
+	}
+
+	// The current entry is only complete once end_frame has been called, but the entries before it always are.
+	// Walking backwards from the current entry covers the _count most recent frames.
+	std::vector<double> samples;
+	samples.reserve(_count);
+	for (uint32_t i = 0; i < _count; i++) {
+		uint32_t index = (_current + HISTORY_SIZE - i) % HISTORY_SIZE;
+		samples.push_back(_history[index][(uint32_t)stage]);
+	}
+
+	result.last_ms = samples[0];
+	result.min_ms = samples[0];
+
+	double total = 0.0;
+	for (double sample : samples) {
+		result.min_ms = std::min(result.min_ms, sample);
+		total += sample;
+	}
+	result.avg_ms = total / samples.size();
+
+	// The 99th percentile is the value 99% of the frames were faster than
+	size_t p99Index = (samples.size() * 99) / 100;
+	std::nth_element(samples.begin(), samples.begin() + p99Index, samples.end());
+	result.p99_ms = samples[p99Index];
+
+	return result;
+}
+
+double FrameTimings::average(FrameCounter counter) const
+{
+	if (_count == 0) {
+		return 0.0;
+	}
+
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < _count; i++) {
+		uint32_t index = (_current + HISTORY_SIZE - i) % HISTORY_SIZE;
+		total += _counters[index][(uint32_t)counter];
+	}
+
+	return (double)total / _count;
+}
+
+std::string FrameTimings::summary() const
+{
+	FrameStageStats cpu = stats(FrameStage::CpuFrame);
+	FrameStageStats gpu = stats(FrameStage::GpuFrame);
+	FrameStageStats wait = stats(FrameStage::Wait);
+
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer),
+		"cpu %.2f ms (min %.2f, p99 %.2f) | gpu %.2f ms (p99 %.2f) | wait %.2f ms | barriers %.1f",
+		cpu.avg_ms, cpu.min_ms, cpu.p99_ms, gpu.avg_ms, gpu.p99_ms, wait.avg_ms, average(FrameCounter::Barriers));
+
+	return buffer;
+}
+
+bool FrameTimings::open_csv(const char* filePath)
+{
+	close_csv();
+
+	_csv.open(filePath);
+	if (!_csv.is_open()) {
+		return false;
+	}
+
+	// Header row, one column per stage
+	_csv << "frame";
+	for (uint32_t stage = 0; stage < (uint32_t)FrameStage::Count; stage++) {
+		_csv << "," << frame_stage_name((FrameStage)stage) << "_ms";
+	}
+	for (uint32_t counter = 0; counter < (uint32_t)FrameCounter::Count; counter++) {
+		_csv << "," << frame_counter_name((FrameCounter)counter);
+	}
+	_csv << "\n";
+
+	return true;
+}
+
+void FrameTimings::close_csv()
+{
+	if (_csv.is_open()) {
+		_csv.close();
+	}
+}
+
+CpuTimingScope::CpuTimingScope(FrameTimings& timings, FrameStage stage)
+	: _timings(timings), _stage(stage), _start(SDL_GetPerformanceCounter())
+{
+}
+
+CpuTimingScope::~CpuTimingScope()
+{
+	uint64_t elapsed = SDL_GetPerformanceCounter() - _start;
+	_timings.record(_stage, (double)elapsed * 1000.0 / (double)SDL_GetPerformanceFrequency());
+}
\ No newline at end of file
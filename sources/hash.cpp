@@ -0,0 +1,29 @@
+#include <hash.h>
+
+#include <utility>
+
+uint64_t vkutil::hash_bytes(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+uint64_t vkutil::hash_combine(uint64_t hash, uint64_t value)
+{
+	return hash_bytes(&value, sizeof(value), hash);
+}
+
+StateKey vkutil::make_state_key(std::vector<uint32_t> state)
+{
+	StateKey key;
+	key.state = std::move(state);
+	key.hash = hash_bytes(key.state.data(), key.state.size() * sizeof(uint32_t));
+	return key;
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include <job_system.h>
+
+void JobSystem::init(uint32_t workerThreads)
+{
+	_stopping = false;
+
+	for (uint32_t i = 0; i < workerThreads; i++) {
+		_threads.emplace_back(&JobSystem::worker_loop, this, i + 1);
+	}
+}
+
+void JobSystem::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_condition.notify_all();
+
+	for (std::thread& thread : _threads) {
+		thread.join();
+	}
+	_threads.clear();
+
+	// Jobs nobody waited for are dropped
+	_queue.clear();
+	_backgroundQueue.clear();
+}
+
+void JobSystem::submit(Job job, JobCounter* counter)
+{
+	if (counter != nullptr) {
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_queue.push_back(QueuedJob{ std::move(job), counter });
+	}
+	_condition.notify_all();
+}
+
+void JobSystem::submit_background(Job job, JobCounter* counter)
+{
+	if (counter != nullptr) {
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_backgroundQueue.push_back(QueuedJob{ std::move(job), counter });
+	}
+	_condition.notify_all();
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	while (!counter.done()) {
+		// Help out instead of just sleeping, the caller is a worker as well
+		if (!_queue.empty()) {
+			QueuedJob queued = std::move(_queue.front());
+			_queue.pop_front();
+
+			lock.unlock();
+			run_job(queued, 0);
+			lock.lock();
+			continue;
+		}
+
+		_condition.wait(lock);
+	}
+}
+
+void JobSystem::parallel_for(uint32_t count, const std::function<void(uint32_t index, uint32_t workerIndex)>& function)
+{
+	JobCounter counter;
+
+	for (uint32_t index = 0; index < count; index++) {
+		submit([&function, index](uint32_t workerIndex) { function(index, workerIndex); }, &counter);
+	}
+
+	wait(counter);
+}
+
+void JobSystem::worker_loop(uint32_t workerIndex)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	while (true) {
+		_condition.wait(lock, [this]() { return _stopping || !_queue.empty() || !_backgroundQueue.empty(); });
+
+		if (_stopping) {
+			return;
+		}
+
+		// Work for the current frame always goes first
+		std::deque<QueuedJob>& queue = !_queue.empty() ? _queue : _backgroundQueue;
+		QueuedJob queued = std::move(queue.front());
+		queue.pop_front();
+
+		lock.unlock();
+		run_job(queued, workerIndex);
+		lock.lock();
+	}
+}
+
+void JobSystem::run_job(QueuedJob& queued, uint32_t workerIndex)
+{
+	queued.job(workerIndex);
+
+	if (queued.counter != nullptr) {
+		// Taking the lock makes sure a thread that just checked the counter in wait() is already waiting on the condition,
+		// otherwise it could miss the notification
+		std::lock_guard<std::mutex> lock(_mutex);
+		queued.counter->pending.fetch_sub(1, std::memory_order_release);
+	}
+	_condition.notify_all();
+}
\ No newline at end of file
@@ -0,0 +1,555 @@
+#include <render_graph.h>
+#include <vk_types.h>
+#include <vk_initializers.h>
+#include <vk_memory_budget.h>
+#include <hash.h>
+#include <align.h>
+
+#include <SDL3/SDL_log.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+	VkImageAspectFlags format_aspect(VkFormat format)
+	{
+		switch (format) {
+			case VK_FORMAT_D16_UNORM:
+			case VK_FORMAT_D32_SFLOAT:
+			case VK_FORMAT_X8_D24_UNORM_PACK32:
+				return VK_IMAGE_ASPECT_DEPTH_BIT;
+			case VK_FORMAT_D16_UNORM_S8_UINT:
+			case VK_FORMAT_D24_UNORM_S8_UINT:
+			case VK_FORMAT_D32_SFLOAT_S8_UINT:
+				return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+			default:
+				return VK_IMAGE_ASPECT_COLOR_BIT;
+		}
+	}
+}
+
+void RGPassBuilder::read(RGImage image, ImageUsage usage)
+{
+	assert(image.valid());
+	_graph._passes[_passIndex].accesses.push_back({ image.index, usage, false, false });
+}
+
+void RGPassBuilder::write(RGImage image, ImageUsage usage, bool discardContents)
+{
+	assert(image.valid());
+	_graph._passes[_passIndex].accesses.push_back({ image.index, usage, true, discardContents });
+}
+
+void RGPassBuilder::has_side_effects()
+{
+	_graph._passes[_passIndex].sideEffects = true;
+}
+
+void RenderGraph::init(VkDevice device, VmaAllocator allocator, ImageStateTracker* tracker, DeletionQueue* retireQueue)
+{
+	_device = device;
+	_allocator = allocator;
+	_tracker = tracker;
+	_retireQueue = retireQueue;
+}
+
+void RenderGraph::destroy()
+{
+	// Called once the device is idle, so the transient images can be destroyed right away instead of being retired
+	DeletionQueue* retireQueue = _retireQueue;
+	DeletionQueue immediate;
+	_retireQueue = &immediate;
+
+	release_transients();
+	immediate.flush();
+
+	_retireQueue = retireQueue;
+
+	reset();
+}
+
+void RenderGraph::reset()
+{
+	_passes.clear();
+	_resources.clear();
+	_executionOrder.clear();
+	_finalBarriers.clear();
+}
+
+RGImage RenderGraph::import_image(const char* name, VkImage image, VkImageView view, VkExtent2D extent, bool output, ImageUsage finalUsage)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.imported = true;
+	resource.output = output;
+	resource.finalUsage = finalUsage;
+	resource.image = image;
+	resource.view = view;
+	resource.extent = extent;
+	resource.transientIndex = UINT32_MAX;
+
+	_resources.push_back(resource);
+
+	return RGImage{ (uint32_t)_resources.size() - 1 };
+}
+
+RGImage RenderGraph::create_transient_image(const char* name, const RGTransientImageDesc& desc)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.imported = false;
+	resource.output = false;
+	resource.finalUsage = ImageUsage::Undefined;
+	resource.image = VK_NULL_HANDLE;
+	resource.view = VK_NULL_HANDLE;
+	resource.extent = desc.extent;
+	resource.desc = desc;
+	resource.transientIndex = UINT32_MAX;
+
+	_resources.push_back(resource);
+
+	return RGImage{ (uint32_t)_resources.size() - 1 };
+}
+
+void RenderGraph::add_pass(const char* name, const std::function<void(RGPassBuilder& builder)>& setup, ExecuteFunction execute)
+{
+	Pass pass{};
+	pass.name = name;
+	pass.execute = std::move(execute);
+
+	_passes.push_back(std::move(pass));
+
+	RGPassBuilder builder(*this, (uint32_t)_passes.size() - 1);
+	setup(builder);
+}
+
+void RenderGraph::compile()
+{
+	// Find the dependencies between passes, in the order they were added.
+	// A pass depends on the last pass that wrote an image it uses,
+	// and a pass writing an image also has to wait for every pass that read the image since it was last written.
+	// Data dependencies are the subset where the previous contents are actually consumed, which is what culling follows.
+	std::vector<int> lastWriter(_resources.size(), -1);
+	std::vector<std::vector<uint32_t>> readersSinceWrite(_resources.size());
+
+	for (uint32_t passIndex = 0; passIndex < _passes.size(); passIndex++) {
+		Pass& pass = _passes[passIndex];
+
+		for (const Access& access : pass.accesses) {
+			int writer = lastWriter[access.resource];
+
+			if (writer >= 0) {
+				pass.dependencies.push_back((uint32_t)writer);
+
+				if (!access.discard) {
+					pass.dataDependencies.push_back((uint32_t)writer);
+				}
+			}
+
+			if (access.write) {
+				for (uint32_t reader : readersSinceWrite[access.resource]) {
+					if (reader != passIndex) {
+						pass.dependencies.push_back(reader);
+					}
+				}
+
+				readersSinceWrite[access.resource].clear();
+				lastWriter[access.resource] = (int)passIndex;
+			}
+			else {
+				readersSinceWrite[access.resource].push_back(passIndex);
+			}
+		}
+	}
+
+	cull_passes();
+	order_passes();
+	allocate_transients();
+	compute_barriers();
+}
+
+void RenderGraph::cull_passes()
+{
+	// Passes with side effects, or that write one of the frame's outputs, are always needed.
+	// Everything they consume is needed as well. Dependencies always point to earlier passes,
+	// so walking the passes backwards once is enough to find every needed pass.
+	std::vector<bool> needed(_passes.size(), false);
+
+	for (uint32_t passIndex = 0; passIndex < _passes.size(); passIndex++) {
+		const Pass& pass = _passes[passIndex];
+
+		if (pass.sideEffects) {
+			needed[passIndex] = true;
+		}
+
+		for (const Access& access : pass.accesses) {
+			if (access.write && _resources[access.resource].output) {
+				needed[passIndex] = true;
+			}
+		}
+	}
+
+	for (int passIndex = (int)_passes.size() - 1; passIndex >= 0; passIndex--) {
+		if (!needed[passIndex]) {
+			continue;
+		}
+
+		for (uint32_t dependency : _passes[passIndex].dataDependencies) {
+			needed[dependency] = true;
+		}
+	}
+
+	_stats.passes = (uint32_t)_passes.size();
+	_stats.culled_passes = 0;
+
+	for (uint32_t passIndex = 0; passIndex < _passes.size(); passIndex++) {
+		_passes[passIndex].culled = !needed[passIndex];
+
+		if (_passes[passIndex].culled) {
+			_stats.culled_passes++;
+		}
+	}
+}
+
+void RenderGraph::order_passes()
+{
+	// Topological sort of the passes that survived culling.
+	// When several passes are ready, one that does not depend on the previously scheduled pass is preferred,
+	// so the GPU can overlap the two instead of draining the pipeline at the barrier between them.
+	// Otherwise passes keep the order they were added in.
+	std::vector<uint32_t> remainingDependencies(_passes.size(), 0);
+	std::vector<std::vector<uint32_t>> dependents(_passes.size());
+
+	for (uint32_t passIndex = 0; passIndex < _passes.size(); passIndex++) {
+		Pass& pass = _passes[passIndex];
+		if (pass.culled) {
+			continue;
+		}
+
+		std::sort(pass.dependencies.begin(), pass.dependencies.end());
+		pass.dependencies.erase(std::unique(pass.dependencies.begin(), pass.dependencies.end()), pass.dependencies.end());
+
+		for (uint32_t dependency : pass.dependencies) {
+			// A needed pass can still depend on a culled one, if it only waits for it to stop reading an image
+			if (!_passes[dependency].culled) {
+				remainingDependencies[passIndex]++;
+				dependents[dependency].push_back(passIndex);
+			}
+		}
+	}
+
+	std::vector<uint32_t> ready;
+	for (uint32_t passIndex = 0; passIndex < _passes.size(); passIndex++) {
+		if (!_passes[passIndex].culled && remainingDependencies[passIndex] == 0) {
+			ready.push_back(passIndex);
+		}
+	}
+
+	_executionOrder.clear();
+
+	while (!ready.empty()) {
+		size_t pick = 0;
+
+		if (!_executionOrder.empty()) {
+			uint32_t previous = _executionOrder.back();
+
+			for (size_t i = 0; i < ready.size(); i++) {
+				const std::vector<uint32_t>& dependencies = _passes[ready[i]].dependencies;
+				if (!std::binary_search(dependencies.begin(), dependencies.end(), previous)) {
+					pick = i;
+					break;
+				}
+			}
+		}
+
+		uint32_t passIndex = ready[pick];
+		ready.erase(ready.begin() + pick);
+		_executionOrder.push_back(passIndex);
+
+		for (uint32_t dependent : dependents[passIndex]) {
+			if (--remainingDependencies[dependent] == 0) {
+				// Keep the ready list in declaration order
+				ready.insert(std::upper_bound(ready.begin(), ready.end(), dependent), dependent);
+			}
+		}
+	}
+}
+
+void RenderGraph::allocate_transients()
+{
+	// Find the lifetime of every transient image, as positions in the execution order
+	for (Resource& resource : _resources) {
+		resource.firstUse = UINT32_MAX;
+		resource.lastUse = 0;
+	}
+
+	for (uint32_t position = 0; position < _executionOrder.size(); position++) {
+		for (const Access& access : _passes[_executionOrder[position]].accesses) {
+			Resource& resource = _resources[access.resource];
+			resource.firstUse = std::min(resource.firstUse, position);
+			resource.lastUse = std::max(resource.lastUse, position);
+		}
+	}
+
+	// Transient images only used by culled passes are never created
+	std::vector<uint32_t> transients;
+	uint64_t signature = vkutil::HASH_SEED;
+
+	for (uint32_t resourceIndex = 0; resourceIndex < _resources.size(); resourceIndex++) {
+		const Resource& resource = _resources[resourceIndex];
+		if (resource.imported || resource.firstUse == UINT32_MAX) {
+			continue;
+		}
+
+		transients.push_back(resourceIndex);
+
+		signature = vkutil::hash_combine(signature, resource.desc.format);
+		signature = vkutil::hash_combine(signature, ((uint64_t)resource.desc.extent.width << 32) | resource.desc.extent.height);
+		signature = vkutil::hash_combine(signature, resource.desc.usage);
+		signature = vkutil::hash_combine(signature, ((uint64_t)resource.firstUse << 32) | resource.lastUse);
+	}
+
+	// The graph is usually the same every frame, so the transient images of the previous frame can be reused as is
+	if (signature != _transientSignature || transients.size() != _transientImages.size()) {
+		release_transients();
+
+		// Create the images first, as their memory requirements are needed to decide which ones can share memory
+		std::vector<VkMemoryRequirements> requirements(transients.size());
+
+		for (size_t i = 0; i < transients.size(); i++) {
+			const RGTransientImageDesc& desc = _resources[transients[i]].desc;
+
+			VkImageCreateInfo imageInfo = vkinit::image_create_info(desc.format, desc.usage, VkExtent3D{ desc.extent.width, desc.extent.height, 1 });
+
+			TransientImage transient{};
+			vk_check(vkCreateImage(_device, &imageInfo, nullptr, &transient.image));
+			vkGetImageMemoryRequirements(_device, transient.image, &requirements[i]);
+
+			_transientImages.push_back(transient);
+		}
+
+		// Greedily place every image into the first memory slot that is free for its whole lifetime.
+		// Images are placed in the order they start being used, so a slot is free once its last image has been used for the last time.
+		std::vector<size_t> byFirstUse(transients.size());
+		for (size_t i = 0; i < byFirstUse.size(); i++) {
+			byFirstUse[i] = i;
+		}
+		std::sort(byFirstUse.begin(), byFirstUse.end(), [&](size_t a, size_t b) {
+			return _resources[transients[a]].firstUse < _resources[transients[b]].firstUse;
+		});
+
+		std::vector<uint32_t> slotBusyUntil;
+		_stats.transient_bytes_requested = 0;
+
+		for (size_t i : byFirstUse) {
+			const Resource& resource = _resources[transients[i]];
+			const VkMemoryRequirements& imageRequirements = requirements[i];
+
+			_stats.transient_bytes_requested += imageRequirements.size;
+
+			uint32_t slot = UINT32_MAX;
+			for (uint32_t s = 0; s < _memorySlots.size(); s++) {
+				bool free = slotBusyUntil[s] < resource.firstUse;
+				bool compatible = (_memorySlots[s].requirements.memoryTypeBits & imageRequirements.memoryTypeBits) != 0;
+
+				if (free && compatible) {
+					slot = s;
+					break;
+				}
+			}
+
+			if (slot == UINT32_MAX) {
+				MemorySlot memorySlot{};
+				memorySlot.requirements = imageRequirements;
+
+				_memorySlots.push_back(memorySlot);
+				slotBusyUntil.push_back(resource.lastUse);
+				slot = (uint32_t)_memorySlots.size() - 1;
+			}
+			else {
+				// The slot has to be large enough, and aligned enough, for every image placed in it
+				VkMemoryRequirements& slotRequirements = _memorySlots[slot].requirements;
+				slotRequirements.alignment = std::max(slotRequirements.alignment, imageRequirements.alignment);
+				slotRequirements.size = vkutil::align_up(std::max(slotRequirements.size, imageRequirements.size), slotRequirements.alignment);
+				slotRequirements.memoryTypeBits &= imageRequirements.memoryTypeBits;
+
+				slotBusyUntil[slot] = resource.lastUse;
+			}
+
+			_transientImages[i].slot = slot;
+		}
+
+		// Allocate the memory of every slot, and bind the images placed in it
+		VmaAllocationCreateInfo allocInfo{};
+		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+		allocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		_stats.transient_bytes_allocated = 0;
+
+		for (MemorySlot& memorySlot : _memorySlots) {
+			vk_check(vmaAllocateMemory(_allocator, &memorySlot.requirements, &allocInfo, &memorySlot.allocation, nullptr));
+			vkutil::track_allocation(_allocator, memorySlot.allocation, MemoryCategory::Images);
+			_stats.transient_bytes_allocated += memorySlot.requirements.size;
+		}
+
+		for (size_t i = 0; i < transients.size(); i++) {
+			const RGTransientImageDesc& desc = _resources[transients[i]].desc;
+			TransientImage& transient = _transientImages[i];
+
+			vk_check(vmaBindImageMemory(_allocator, _memorySlots[transient.slot].allocation, transient.image));
+
+			VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(desc.format, transient.image, format_aspect(desc.format));
+			vk_check(vkCreateImageView(_device, &viewInfo, nullptr, &transient.view));
+
+			_tracker->track(transient.image, format_aspect(desc.format));
+		}
+
+		_transientSignature = signature;
+
+		if (!transients.empty()) {
+			SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Render graph allocated %zu transient images in %zu memory slots (%llu of %llu bytes)",
+				transients.size(), _memorySlots.size(),
+				(unsigned long long)_stats.transient_bytes_allocated, (unsigned long long)_stats.transient_bytes_requested);
+		}
+	}
+
+	_stats.transient_images = (uint32_t)transients.size();
+
+	for (size_t i = 0; i < transients.size(); i++) {
+		Resource& resource = _resources[transients[i]];
+		resource.transientIndex = (uint32_t)i;
+		resource.image = _transientImages[i].image;
+		resource.view = _transientImages[i].view;
+	}
+}
+
+void RenderGraph::release_transients()
+{
+	if (_transientImages.empty() && _memorySlots.empty()) {
+		return;
+	}
+
+	std::vector<TransientImage> images = std::move(_transientImages);
+	std::vector<MemorySlot> slots = std::move(_memorySlots);
+
+	for (const TransientImage& transient : images) {
+		_tracker->forget(transient.image);
+	}
+
+	// Frames in flight might still be using the images, so they are destroyed once those frames have finished
+	VkDevice device = _device;
+	VmaAllocator allocator = _allocator;
+
+	_retireQueue->push_function([=]() {
+		for (const TransientImage& transient : images) {
+			vkDestroyImageView(device, transient.view, nullptr);
+			vkDestroyImage(device, transient.image, nullptr);
+		}
+		for (const MemorySlot& slot : slots) {
+			vkutil::untrack_allocation(allocator, slot.allocation);
+			vmaFreeMemory(allocator, slot.allocation);
+		}
+	});
+
+	_transientImages.clear();
+	_memorySlots.clear();
+	_transientSignature = 0;
+}
+
+void RenderGraph::compute_barriers()
+{
+	// Run through the passes in execution order, declaring every access to the tracker,
+	// and keep the barriers it generates so they can be recorded right before each pass.
+	// Barriers only depend on the order of the passes, so they are all known before anything is recorded.
+	std::vector<VkMemoryBarrier2> unusedMemoryBarriers;
+
+	for (uint32_t position = 0; position < _executionOrder.size(); position++) {
+		Pass& pass = _passes[_executionOrder[position]];
+
+		for (const Access& access : pass.accesses) {
+			Resource& resource = _resources[access.resource];
+			bool discard = access.discard;
+
+			if (!resource.imported && resource.firstUse == position) {
+				// The previous contents of a transient image are never valid, its memory was last used by another image.
+				// The transition still has to wait for whatever last touched that memory, which might be from the previous frame.
+				const ImageState& slotState = _memorySlots[_transientImages[resource.transientIndex].slot].lastState;
+				_tracker->set_state(resource.image, ImageState{ VK_IMAGE_LAYOUT_UNDEFINED, slotState.stages, slotState.access });
+				discard = true;
+			}
+
+			_tracker->use(resource.image, access.usage, discard);
+
+			if (!resource.imported) {
+				_memorySlots[_transientImages[resource.transientIndex].slot].lastState = _tracker->get_state(resource.image);
+			}
+		}
+
+		_tracker->take_pending(pass.imageBarriers, pass.memoryBarriers);
+	}
+
+	// Move imported images into the state they are expected to be in after the graph, like the present layout for the swapchain
+	for (const Resource& resource : _resources) {
+		if (resource.imported && resource.finalUsage != ImageUsage::Undefined) {
+			_tracker->use(resource.image, resource.finalUsage);
+		}
+	}
+
+	_tracker->take_pending(_finalBarriers, unusedMemoryBarriers);
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd) const
+{
+	for (uint32_t position = 0; position < _executionOrder.size(); position++) {
+		record_pass(cmd, position);
+	}
+
+	record_final_barriers(cmd);
+}
+
+void RenderGraph::record_pass(VkCommandBuffer cmd, uint32_t position) const
+{
+	const Pass& pass = _passes[_executionOrder[position]];
+
+	record_barriers(cmd, pass.imageBarriers, pass.memoryBarriers);
+	pass.execute(cmd, *this);
+}
+
+void RenderGraph::record_final_barriers(VkCommandBuffer cmd) const
+{
+	record_barriers(cmd, _finalBarriers, {});
+}
+
+void RenderGraph::record_barriers(VkCommandBuffer cmd, const std::vector<VkImageMemoryBarrier2>& imageBarriers, const std::vector<VkMemoryBarrier2>& memoryBarriers)
+{
+	if (imageBarriers.empty() && memoryBarriers.empty()) {
+		return;
+	}
+
+	VkDependencyInfo depInfo{};
+	depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	depInfo.pNext = nullptr;
+
+	depInfo.memoryBarrierCount = (uint32_t)memoryBarriers.size();
+	depInfo.pMemoryBarriers = memoryBarriers.data();
+
+	depInfo.imageMemoryBarrierCount = (uint32_t)imageBarriers.size();
+	depInfo.pImageMemoryBarriers = imageBarriers.data();
+
+	vkCmdPipelineBarrier2(cmd, &depInfo);
+}
+
+VkImage RenderGraph::get_image(RGImage image) const
+{
+	return _resources[image.index].image;
+}
+
+VkImageView RenderGraph::get_image_view(RGImage image) const
+{
+	return _resources[image.index].view;
+}
+
+VkExtent2D RenderGraph::get_extent(RGImage image) const
+{
+	return _resources[image.index].extent;
+}
\ No newline at end of file
@@ -1,10 +1,15 @@
 ﻿#include <vector>
+#include <algorithm>
+#include <cstdarg>
 
 // SDL_main should only be included from a single file
 #include <SDL3/SDL_main.h>
 #include <SDL3/SDL_version.h>
 #include <SDL3/SDL_log.h>
 #include <SDL3/SDL_vulkan.h>
+#include <SDL3/SDL_timer.h>
+#include <SDL3/SDL_cpuinfo.h>
+#include <SDL3/SDL_stdinc.h>
 
 #include <vulkan/vulkan.h>
 
@@ -13,6 +18,27 @@
 #include <iostream>
 #include <deletionqueue.h>
 #include <vk_images.h>
+#include <vk_buffers.h>
+#include <frame_capture.h>
+#include <frame_timings.h>
+#include <frame_pacer.h>
+#include <config.h>
+#include <vk_timeline.h>
+#include <vk_image_state.h>
+#include <render_graph.h>
+#include <job_system.h>
+#include <vk_pipeline_cache.h>
+#include <vk_pipeline_registry.h>
+#include <shader_library.h>
+#include <vk_layout_cache.h>
+#include <vk_bindless.h>
+#include <upload_manager.h>
+#include <frame_arena.h>
+#include <vk_memory_budget.h>
+#include <tile_map.h>
+#include <tile_renderer.h>
+#include <sprite_batch.h>
+#include <tile_lighting.h>
 
 // When using VMA it is required to define VMA_IMPLEMENTATION a single time
 #define VMA_IMPLEMENTATION
@@ -21,22 +47,57 @@
 
 using namespace std;
 
-void panic_and_exit(const char* error_message, ...);
-void vk_check(VkResult vkResult);
+// Command buffers are allocated from a pool that can only be used by one thread at a time,
+// so every worker thread records into command buffers from its own pool
+struct WorkerCommandPool {
+	VkCommandPool pool;
+	// Reused every time the frame comes around, more are allocated when a frame needs them
+	std::vector<VkCommandBuffer> buffers;
+	uint32_t used;
+};
 
 struct FrameData {
 	VkCommandPool commandPool;
 	VkCommandBuffer main_command_buffer;
+	// One pool for every worker of the job system, including the main thread as worker 0
+	WorkerCommandPool worker_pools[MAX_WORKER_THREADS + 1];
 	VkSemaphore swapchain_semaphore;
 	VkSemaphore render_semaphore;
-	VkFence render_fence;
 	DeletionQueue _deletionQueue;
-};
 
-constexpr unsigned int FRAME_OVERLAP = 2;
+	// Value on the frame timeline signaled when the GPU has finished this frame's last submission
+	uint64_t timeline_value;
+
+	// Host visible buffer the draw image is copied into when running headless
+	AllocatedBuffer readback_buffer;
+
+	// Transient GPU data of the frame. Reset once the frame timeline reaches timeline_value.
+	FrameArena arena;
+
+	// Timestamps written at the start and end of main_command_buffer
+	VkQueryPool timestamp_query_pool;
+	bool timestamps_written;
+};
 
 DeletionQueue _mainDeletionQueue;
 
+// Runtime settings, loaded from the config file and the command line.
+// Headless mode (config.headless) renders into the draw image without a window, surface or swapchain.
+// This allows the frame loop to run on build machines and software drivers such as lavapipe.
+EngineConfig config;
+
+// Per-stage CPU and GPU timings of the most recent frames
+FrameTimings frame_timings;
+
+FramePacer frame_pacer;
+
+// GPU timestamps are only measured if the graphics queue supports them
+bool gpu_timestamps_supported = false;
+// Number of nanoseconds it takes for a timestamp query value to be incremented by 1
+float gpu_timestamp_period = 0.0f;
+// Timestamps only have this many valid bits, so the difference between two of them has to be masked
+uint64_t gpu_timestamp_mask = 0;
+
 VkInstance vk_instance;
 VkDebugUtilsMessengerEXT vk_debug_messenger;
 
@@ -52,35 +113,119 @@ std::vector<VkImage> vk_swapchain_images;
 std::vector<VkImageView> vk_swapchain_imageviews;
 VkExtent2D vk_swapchain_extent;
 
-FrameData frames[FRAME_OVERLAP];
+// Only the first frames_in_flight entries are used
+FrameData frames[MAX_FRAMES_IN_FLIGHT];
+uint32_t frames_in_flight = 2;
 int frame_number{ 0 };
-FrameData& get_current_frame() { return frames[frame_number % FRAME_OVERLAP]; }
+FrameData& get_current_frame() { return frames[frame_number % frames_in_flight]; }
+
+// Every submission to the graphics queue signals the next value on this timeline.
+// The CPU waits on exact values to know when a frame is done, and other GPU work can wait on the same values.
+Timeline frame_timeline;
 
 VkQueue graphics_queue;
 uint32_t graphics_queue_family;
 
-VkPipelineLayout _trianglePipelineLayout;
-VkPipeline _trianglePipeline;
+// Shared by every pipeline, and saved to disk on shutdown so the next launch starts warm
+PipelineCache pipeline_cache;
+
+// Every graphics pipeline is requested from the registry, so identical pipelines are only ever built once
+PipelineRegistry pipeline_registry;
+
+// Owns all shader modules, and reloads them when their files change
+ShaderLibrary shader_library;
+
+// Descriptor set and pipeline layouts, built from shader reflection and shared between pipelines
+LayoutCache layout_cache;
+
+// Every texture and storage buffer, bound once per command buffer and indexed by shaders
+BindlessHeap bindless_heap;
+
+// Copies data into GPU resources through a staging ring, on a dedicated transfer queue when there is one
+UploadManager upload_manager;
+
+// Compiled in the background. A flat colored fallback is drawn until it is ready.
+PipelineHandle _trianglePipeline;
+
+// The level, drawn on top of everything else with one draw call
+constexpr uint32_t MAP_WIDTH = 100;
+constexpr uint32_t MAP_HEIGHT = 60;
+TileMap tile_map;
+TileRenderer tile_renderer;
+
+// Monsters and items, drawn on top of the map with a draw per run of sprites that share a pipeline.
+// Until there is a real entity system, the map is filled with test entities that stand still.
+constexpr uint32_t TEST_ENTITY_COUNT = 4000;
+constexpr uint16_t LAYER_GLOW = 0;
+constexpr uint16_t LAYER_ITEMS = 1;
+constexpr uint16_t LAYER_MONSTERS = 2;
+std::vector<Sprite> test_entities;
+SpriteBatch sprite_batch;
+
+// Lights the map on the GPU every frame, into a light texture the tile renderer samples.
+// Until there are real light sources, torches are scattered over the map.
+constexpr uint32_t TEST_LIGHT_COUNT = 300;
+std::vector<TileLight> test_lights;
+TileLighting tile_lighting;
+
+// Tracks the layout and last access of the draw image and the swapchain images,
+// so every transition only waits for the work that actually touched the image
+ImageStateTracker image_states;
 
-VkImageSubresourceRange image_subresource_range(VkImageAspectFlags aspectMask);
-void transition_image(VkCommandBuffer cmd, VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout);
+// Rebuilt every frame from the passes that make up the frame.
+// It works out the order of the passes, the barriers between them and the memory of transient images.
+RenderGraph render_graph;
 
-VkSemaphoreSubmitInfo semaphore_submit_info(VkPipelineStageFlags2 stageMask, VkSemaphore semaphore);
-VkCommandBufferSubmitInfo command_buffer_submit_info(VkCommandBuffer cmd);
-VkSubmitInfo2 submit_info(VkCommandBufferSubmitInfo* cmd, VkSemaphoreSubmitInfo* signalSemaphoreInfo, VkSemaphoreSubmitInfo* waitSemaphoreInfo);
+// Render passes are recorded on these threads, each into its own command buffer
+JobSystem job_system;
 
 AllocatedImage _drawImage{};
 VkExtent2D _drawExtent{};
 
 VmaAllocator _allocator;
 
+// GPU memory usage per heap and per category, refreshed a few times per second
+MemoryBudget memory_budget;
+
+// Set when the window has been resized, or the swapchain reported that it no longer matches the surface
+bool resize_requested = false;
+// Nothing is rendered while the window is minimized, as the surface has no area to render to
+bool window_minimized = false;
+
+// Resources replaced by a resize which might still be used by frames in flight.
+// They are handed over to the deletion queue of the next frame that gets submitted,
+// and destroyed once that frame's timeline value has been reached.
+DeletionQueue retired_resources;
+
 void init_triangle_pipeline();
+void begin_color_rendering(VkCommandBuffer cmd, VkImageView colorView, VkExtent2D extent);
+void save_headless_capture(FrameData& frame);
+void read_gpu_timestamps(FrameData& frame);
+void create_swapchain(uint32_t width, uint32_t height);
+void resize_swapchain(SDL_Window* window);
+AllocatedImage create_draw_image(uint32_t width, uint32_t height);
+VkCommandBuffer get_worker_command_buffer(FrameData& frame, uint32_t workerIndex);
+void destroy_draw_image(const AllocatedImage& image);
+void spawn_test_entities(uint32_t count, uint64_t seed);
+void spawn_test_lights(uint32_t count, uint64_t seed);
 
 int main(int argc, char** argv)
 {
+	// Settings from the config file are applied first, so the command line can override them
+	const char* config_path = config_file_path(argc, argv);
+	if (!load_config_file(config_path, config)) {
+		SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "No config file found at %s, using defaults", config_path);
+	}
+	apply_command_line(argc, argv, config);
+
+	frames_in_flight = config.frames_in_flight;
+	frame_pacer.set_target_fps(config.target_fps);
+
 	// SDL_INIT_VIDEO = Initialize SDL's video subsytem.
 	// This is largely abstracting window management from the underlying OS.
-	if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO) != true)
+	// When running headless there might not be a display at all, so only the event subsystem is initialized.
+	SDL_InitFlags sdl_init_flags = config.headless ? SDL_INIT_EVENTS : (SDL_INIT_AUDIO | SDL_INIT_VIDEO);
+	if (SDL_Init(sdl_init_flags) != true)
 	{
 		std::cout << "Failed to initialize SDL!" << std::endl;
 		exit(1);
@@ -93,9 +238,12 @@ int main(int argc, char** argv)
 
 	// Creating a window with SDL_WINDOW_VULKAN means that the corresponding LoadLibrary function will be called.
 	// The corresponding UnloadLibrary function will also be called by SDL_DestroyWindow()
-	auto main_window = SDL_CreateWindow("Roguelike-X", 800, 600, SDL_WINDOW_VULKAN);
-	if (main_window == NULL) {
-		panic_and_exit("Could not create window: %s\n", SDL_GetError());
+	SDL_Window* main_window = nullptr;
+	if (!config.headless) {
+		main_window = SDL_CreateWindow("Roguelike-X", config.window_width, config.window_height, SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+		if (main_window == NULL) {
+			panic_and_exit("Could not create window: %s\n", SDL_GetError());
+		}
 	}
 
 	// Initialize Vulkan
@@ -106,8 +254,14 @@ int main(int argc, char** argv)
 		.request_validation_layers(true)
 		.use_default_debug_messenger()
 		.require_api_version(1, 3, 0)
+		// A headless instance does not enable any surface extensions
+		.set_headless(config.headless)
 		.build();
 
+	if (!instance_build_result) {
+		panic_and_exit("Failed to create Vulkan instance: %s\n", instance_build_result.error().message().c_str());
+	}
+
 	vkb::Instance vkb_instance = instance_build_result.value();
 
 	vk_instance = vkb_instance.instance;
@@ -115,7 +269,9 @@ int main(int argc, char** argv)
 
 	// A Surface represents and abstract handle to a native platform window which can be rendered to.
 	// We create a surface for our SDL window, which we will render to.
-	SDL_Vulkan_CreateSurface(main_window, vk_instance, nullptr, &vk_surface);
+	if (!config.headless) {
+		SDL_Vulkan_CreateSurface(main_window, vk_instance, nullptr, &vk_surface);
+	}
 
 	// Vulkan 1.3 features
 	VkPhysicalDeviceVulkan13Features features_13{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES };
@@ -126,17 +282,50 @@ int main(int argc, char** argv)
 	VkPhysicalDeviceVulkan12Features features_12{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
 	features_12.bufferDeviceAddress = true;
 	features_12.descriptorIndexing = true;
+	features_12.timelineSemaphore = true;
+
+	// Descriptor indexing features used by the bindless descriptor heap
+	features_12.runtimeDescriptorArray = true;
+	features_12.descriptorBindingPartiallyBound = true;
+	features_12.descriptorBindingVariableDescriptorCount = true;
+	features_12.descriptorBindingUpdateUnusedWhilePending = true;
+	features_12.descriptorBindingSampledImageUpdateAfterBind = true;
+	features_12.descriptorBindingStorageBufferUpdateAfterBind = true;
+	features_12.shaderSampledImageArrayNonUniformIndexing = true;
+	features_12.shaderStorageBufferArrayNonUniformIndexing = true;
 
 	// We use VkBootstrap to select a GPU
 	// We want a GPU that can write to the SDL surface and supports Vulkan 1.3 with the correct features
+	// When headless there is no surface, and VkBootstrap will not require presentation support
 	vkb::PhysicalDeviceSelector selector{ vkb_instance };
-	vkb::PhysicalDevice physicalDevice = selector
+	selector
 		.set_minimum_version(1, 3)
 		.set_required_features_13(features_13)
-		.set_required_features_12(features_12)
-		.set_surface(vk_surface)
-		.select()
-		.value();
+		.set_required_features_12(features_12);
+
+	if (!config.headless) {
+		selector.set_surface(vk_surface);
+	}
+
+	auto physical_device_result = selector.select();
+	if (!physical_device_result) {
+		panic_and_exit("Failed to select a physical device: %s\n", physical_device_result.error().message().c_str());
+	}
+
+	vkb::PhysicalDevice physicalDevice = physical_device_result.value();
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Selected physical device: %s", physicalDevice.name.c_str());
+
+	// Shader module identifiers are optional.
+	// They identify a shader by a short driver defined id that stays the same between runs, instead of by its full SPIR-V.
+	VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT identifier_features{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT };
+	identifier_features.shaderModuleIdentifier = true;
+
+	bool shader_module_identifiers =
+		physicalDevice.enable_extension_if_present(VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME) &&
+		physicalDevice.enable_extension_features_if_present(identifier_features);
+
+	// Lets VMA ask the driver how much memory the process uses and how much it may use, instead of estimating it
+	bool memory_budget_extension = physicalDevice.enable_extension_if_present(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
 
 	// Create the final vulkan device
 	vkb::DeviceBuilder deviceBuilder{ physicalDevice };
@@ -150,81 +339,54 @@ int main(int argc, char** argv)
 	allocatorInfo.physicalDevice = physicalDevice;
 	allocatorInfo.device = vk_device;
 	allocatorInfo.instance = vk_instance;
+	// Without the API version, VMA assumes Vulkan 1.0 and would need extra extensions to read memory budgets
+	allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_3;
 	allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+	if (memory_budget_extension) {
+		allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+	}
 
 	vk_check(vmaCreateAllocator(&allocatorInfo, &_allocator));
+	memory_budget.init(_allocator, memory_budget_extension);
 
 	_mainDeletionQueue.push_function([&]() {
 		vmaDestroyAllocator(_allocator);
 		});
 
 	// Create Vulkan swapchain
-	vkb::SwapchainBuilder swapchainBuilder{
-		vk_physical_device,
-		vk_device,
-		vk_surface
-	};
-
-	vk_swapchain_image_format = VK_FORMAT_B8G8R8A8_UNORM;
-
-	vkb::Swapchain vkbSwapchain = swapchainBuilder
-		.set_desired_format(VkSurfaceFormatKHR{
-			.format = vk_swapchain_image_format, .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR })
-		// Use vsync present mode
-		// This will limit FPS to the refresh rate of the monitor
-		.set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
-		.set_desired_extent(800, 600)
-		.add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
-		.build()
-		.value();
-
-	vk_swapchain_extent = vkbSwapchain.extent;
-	vk_swapchain = vkbSwapchain.swapchain;
-	vk_swapchain_images = vkbSwapchain.get_images().value();
-	vk_swapchain_imageviews = vkbSwapchain.get_image_views().value();
+	// A headless renderer has nothing to present to, so it only ever renders into the draw image
+	if (!config.headless) {
+		create_swapchain(config.window_width, config.window_height);
+	}
 
 	// Draw image size will match the window
-	VkExtent3D drawImageExtent = {};
-	drawImageExtent.width = 800;
-	drawImageExtent.height = 600;
-	drawImageExtent.depth = 1;
-
-	_drawImage.imageFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
-	_drawImage.imageExtent = drawImageExtent;
-
-	// All images and buffers need to specify usage flags.
-	// These allow the driver to perform optimizations in the background depending on what that
-	// buffer or image is going to do later.
-	VkImageUsageFlags drawImageUsages{};
-	drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-	drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-	drawImageUsages |= VK_IMAGE_USAGE_STORAGE_BIT;
-	drawImageUsages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-
-	VkImageCreateInfo rimg_info = vkinit::image_create_info(_drawImage.imageFormat, drawImageUsages, drawImageExtent);
-
-	// For the draw image, we want to allocate it from GPU local memory
-	VmaAllocationCreateInfo rimg_allocinfo = {};
-	rimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-	rimg_allocinfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	// Allocate and create the image
-	vk_check(vmaCreateImage(_allocator, &rimg_info, &rimg_allocinfo, &_drawImage.image, &_drawImage.allocation, nullptr));
-
-	// Build a image-view for the draw image to use for rendering
-	VkImageViewCreateInfo rview_info = vkinit::imageview_create_info(_drawImage.imageFormat, _drawImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
-	vk_check(vkCreateImageView(vk_device, &rview_info, nullptr, &_drawImage.imageView));
+	_drawImage = create_draw_image(config.window_width, config.window_height);
+	image_states.track(_drawImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
 
 	// Add to deletion queues
+	// When the window is resized, the draw image is replaced and the old one is retired separately,
+	// so this destroys whichever draw image is current at shutdown.
 	_mainDeletionQueue.push_function([=]() {
-		vkDestroyImageView(vk_device, _drawImage.imageView, nullptr);
-		vmaDestroyImage(_allocator, _drawImage.image, _drawImage.allocation);
+		destroy_draw_image(_drawImage);
 	});
 
 	// Get queue that supports all types of commands
 	graphics_queue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
 	graphics_queue_family = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+	// A queue family with transfer support only maps to the copy engines of the GPU, which run alongside rendering.
+	// Not every device has one, in which case uploads go through the graphics queue.
+	VkQueue transfer_queue = graphics_queue;
+	uint32_t transfer_queue_family = graphics_queue_family;
+
+	auto dedicated_transfer_queue = vkbDevice.get_dedicated_queue(vkb::QueueType::transfer);
+	if (dedicated_transfer_queue.has_value()) {
+		transfer_queue = dedicated_transfer_queue.value();
+		transfer_queue_family = vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer).value();
+	}
+
+	upload_manager.init(vk_device, _allocator, transfer_queue, transfer_queue_family, graphics_queue_family);
+
 	// Initialize command structures
 	// Create a command pool for commands submitted to the graphics queue
 	// We also want the pool to allow for resetting of individual command buffers
@@ -240,7 +402,7 @@ int main(int argc, char** argv)
 	commandPoolInfo.queueFamilyIndex = graphics_queue_family;
 
 	// Create a command pool for each frame
-	for (int i = 0; i < FRAME_OVERLAP; i++) {
+	for (uint32_t i = 0; i < frames_in_flight; i++) {
 		vk_check(vkCreateCommandPool(vk_device, &commandPoolInfo, nullptr, &frames[i].commandPool));
 
 		// Allocate the default command buffer that we will use for rendering
@@ -254,31 +416,164 @@ int main(int argc, char** argv)
 		vk_check(vkAllocateCommandBuffers(vk_device, &cmdAllocInfo, &frames[i].main_command_buffer));
 	}
 
+	// Start the worker threads that record render passes
+	uint32_t worker_threads = config.worker_threads;
+	if (worker_threads == WORKER_THREADS_AUTO) {
+		// One thread per core, the main thread takes up the last one
+		worker_threads = std::min((uint32_t)std::max(SDL_GetNumLogicalCPUCores() - 1, 0), MAX_WORKER_THREADS);
+	}
+	job_system.init(worker_threads);
+
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Recording render passes on %u threads", job_system.worker_count());
+
+	// Worker command buffers are only recorded once and the whole pool is reset at the start of the frame,
+	// which is cheaper than resetting the command buffers one by one
+	VkCommandPoolCreateInfo workerPoolInfo = {};
+	workerPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	workerPoolInfo.pNext = nullptr;
+	workerPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	workerPoolInfo.queueFamilyIndex = graphics_queue_family;
+
+	for (uint32_t i = 0; i < frames_in_flight; i++) {
+		for (uint32_t worker = 0; worker < job_system.worker_count(); worker++) {
+			vk_check(vkCreateCommandPool(vk_device, &workerPoolInfo, nullptr, &frames[i].worker_pools[worker].pool));
+			frames[i].worker_pools[worker].used = 0;
+		}
+	}
+
 	// Create synchronization structures for our frame data structs
-	// One fence to control when the GPU has finished rendering the frame
-	// 2 semaphores to synchronize rendering with swapchain
-	VkFenceCreateInfo fenceCreateInfo{};
-	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceCreateInfo.pNext = nullptr;
-	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	// The frame timeline controls when the GPU has finished rendering a frame
+	// 2 binary semaphores per frame synchronize rendering with the swapchain, as presentation does not support timeline semaphores
+	vk_check(frame_timeline.init(vk_device));
 
 	VkSemaphoreCreateInfo semaphoreCreateInfo{};
 	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 	semaphoreCreateInfo.pNext = nullptr;
 
-	for (int i = 0; i < FRAME_OVERLAP; i++) {
-		vk_check(vkCreateFence(vk_device, &fenceCreateInfo, nullptr, &frames[i].render_fence));
+	for (uint32_t i = 0; i < frames_in_flight; i++) {
+		frames[i].timeline_value = 0;
 
 		vk_check(vkCreateSemaphore(vk_device, &semaphoreCreateInfo, nullptr, &frames[i].swapchain_semaphore));
 		vk_check(vkCreateSemaphore(vk_device, &semaphoreCreateInfo, nullptr, &frames[i].render_semaphore));
 	}
 
+	// Create timestamp query pools, so we can measure how long the GPU spends on each frame
+	// Not every queue supports timestamps. If timestampValidBits is zero, timestamps can not be written at all.
+	uint32_t timestamp_valid_bits = vkbDevice.queue_families[graphics_queue_family].timestampValidBits;
+	gpu_timestamps_supported = timestamp_valid_bits > 0 && physicalDevice.properties.limits.timestampPeriod > 0.0f;
+	gpu_timestamp_period = physicalDevice.properties.limits.timestampPeriod;
+	gpu_timestamp_mask = timestamp_valid_bits >= 64 ? ~0ull : ((1ull << timestamp_valid_bits) - 1);
+
+	if (gpu_timestamps_supported) {
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.pNext = nullptr;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2;
+
+		for (uint32_t i = 0; i < frames_in_flight; i++) {
+			vk_check(vkCreateQueryPool(vk_device, &queryPoolInfo, nullptr, &frames[i].timestamp_query_pool));
+		}
+	}
+	else {
+		SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Graphics queue does not support timestamps, GPU frame times will not be measured");
+	}
+
+	if (!config.timings_csv_path.empty() && !frame_timings.open_csv(config.timings_csv_path.c_str())) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to open frame timings CSV file %s", config.timings_csv_path.c_str());
+	}
+
+	// Uniform and storage buffer offsets have to be aligned to the device limits, which cover vertex and index data as well
+	VkDeviceSize arena_alignment = std::max({ (VkDeviceSize)16,
+		physicalDevice.properties.limits.minUniformBufferOffsetAlignment, physicalDevice.properties.limits.minStorageBufferOffsetAlignment });
+
+	for (uint32_t i = 0; i < frames_in_flight; i++) {
+		frames[i].arena.init(_allocator, vk_device, (VkDeviceSize)config.frame_arena_kb * 1024, arena_alignment);
+	}
+
+	// Create readback buffers for headless mode
+	// Each frame gets its own buffer, so copying a frame never races with the CPU reading an older one
+	if (config.headless) {
+		VkDeviceSize readbackSize = (VkDeviceSize)_drawImage.imageExtent.width * _drawImage.imageExtent.height * 4 * sizeof(uint16_t);
+
+		// The buffer is only read by the CPU, so we want it in host visible memory that stays mapped
+		for (uint32_t i = 0; i < frames_in_flight; i++) {
+			frames[i].readback_buffer = vkutil::create_buffer(_allocator, vk_device, readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, BufferMemory::Readback);
+		}
+	}
+
 	// Initialize pipeline
+	pipeline_cache.init(vk_device, physicalDevice.properties, config.pipeline_cache_path);
+	pipeline_registry.init(vk_device, pipeline_cache.handle(), &job_system);
+	layout_cache.init(vk_device);
+	bindless_heap.init(vk_device, vk_physical_device, layout_cache);
+
+	shader_library.init(vk_device, &pipeline_registry, &job_system, shader_module_identifiers);
+	shader_library.open_archive("resources/shaders/shaders.pak");
+	if (config.shader_hot_reload) {
+		shader_library.enable_hot_reload(config.shader_compiler);
+	}
+
+	Uint64 pipeline_start_counter = SDL_GetPerformanceCounter();
 	init_triangle_pipeline();
+	double pipeline_ms = (double)(SDL_GetPerformanceCounter() - pipeline_start_counter) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Pipeline setup blocked startup for %.3f ms (%s pipeline cache)", pipeline_ms, pipeline_cache.warm() ? "warm" : "cold");
+
+	// A fixed seed, so headless captures of the map are the same on every run
+	tile_map.init(vk_device, _allocator, bindless_heap, MAP_WIDTH, MAP_HEIGHT);
+	generate_test_dungeon(tile_map, 1337);
+	tile_renderer.init(vk_device, _allocator, _drawImage.imageFormat, bindless_heap, layout_cache,
+		shader_library, pipeline_registry, upload_manager, image_states);
+	if (config.headless) {
+		// The map is not drawn until its pipeline is ready, and captures must not depend on how long that takes
+		tile_renderer.wait_for_pipeline(pipeline_registry);
+	}
+	sprite_batch.init(_drawImage.imageFormat, bindless_heap, layout_cache, shader_library, pipeline_registry);
+	if (config.headless) {
+		// Captures must not depend on how long the background compiles take
+		sprite_batch.wait_for_pipelines(pipeline_registry);
+	}
+	spawn_test_entities(TEST_ENTITY_COUNT, 1337);
+	tile_lighting.init(vk_device, physicalDevice.properties.limits, _allocator, pipeline_cache.handle(), bindless_heap,
+		layout_cache, shader_library, image_states, MAP_WIDTH, MAP_HEIGHT);
+	tile_renderer.set_light_texture(tile_lighting.light_slot());
+	spawn_test_lights(TEST_LIGHT_COUNT, 1337);
+
+	// Transient images replaced by the render graph go through the same retirement as resources replaced by a resize
+	render_graph.init(vk_device, _allocator, &image_states, &retired_resources);
+
+	// The last frame that was submitted, used to save a capture when running headless
+	FrameData* last_submitted_frame = nullptr;
+	Uint64 loop_start_ticks = SDL_GetTicksNS();
+
+	// The window title doubles as a simple timing overlay, which is refreshed a couple of times per second
+	Uint64 last_overlay_update_ticks = loop_start_ticks;
 
 	// Game Loop
 	bool should_quit = false;
 	while (!should_quit) {
+		Uint64 frame_start_counter = SDL_GetPerformanceCounter();
+		frame_timings.begin_frame(frame_number);
+
+		{
+			CpuTimingScope scope(frame_timings, FrameStage::Wait);
+
+			// Wait until the GPU has finished rendering the last frame that used this frame data. Timeout of 1 second
+			// This is done before sampling input, so the time spent waiting for the GPU does not add to input latency.
+			vk_check(frame_timeline.wait(vk_device, get_current_frame().timeline_value, 1000000000));
+		}
+
+		// Nothing the GPU reads from the arena is still in use, so the frame can start filling it from the beginning
+		get_current_frame().arena.reset();
+
+		{
+			CpuTimingScope scope(frame_timings, FrameStage::Pace);
+
+			// Sleep as long as possible before sampling input, while still leaving time to finish the frame on schedule
+			frame_pacer.wait_before_input();
+		}
+
 		// SDL_PollEvent is the favored way of receiving system events since it can be done from the main loop
 		// without suspending / blocking it while waiting for an event to be posted.
 		SDL_Event sdl_event;
@@ -287,23 +582,54 @@ int main(int argc, char** argv)
 		while (SDL_PollEvent(&sdl_event)) {
 			switch (sdl_event.type) {
 				case SDL_EVENT_WINDOW_CLOSE_REQUESTED:
+				case SDL_EVENT_QUIT:
 					should_quit = true;
 					break;
+				case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED:
+					resize_requested = true;
+					break;
+				case SDL_EVENT_WINDOW_MINIMIZED:
+					window_minimized = true;
+					break;
+				case SDL_EVENT_WINDOW_RESTORED:
+					window_minimized = false;
+					resize_requested = true;
+					break;
 				default:
 					break;
 			}
 		}
 
-		// Drawing
-		// Wait until the GPU has finished rendering the last frame. Timeout of 1 second
-		vk_check(vkWaitForFences(vk_device, 1, &get_current_frame().render_fence, true, 1000000000));
+		// While minimized there is nothing to render to, so wait for events instead of spinning the CPU
+		if (window_minimized) {
+			frame_timings.discard_frame();
+			SDL_WaitEventTimeout(nullptr, 100);
+			continue;
+		}
+
+		if (resize_requested) {
+			resize_swapchain(main_window);
+
+			// A zero sized window can not have a swapchain. Try again once the window has an area.
+			if (resize_requested) {
+				frame_timings.discard_frame();
+				SDL_WaitEventTimeout(nullptr, 100);
+				continue;
+			}
+		}
 
-		// Fences have to be reset between uses, you can't use the same fence on multiple GPU commands without resetting
-		vk_check(vkResetFences(vk_device, 1, &get_current_frame().render_fence));
+		// Drawing
+		// The GPU is done with this frame's previous submission, so its timestamps are available
+		read_gpu_timestamps(get_current_frame());
 
 		// Flush Vulkan object queue for the frame
 		get_current_frame()._deletionQueue.flush();
 
+		// Pick up shaders that changed on disk, and swap in the pipelines rebuilt from them.
+		// This happens between frames, so all passes of a frame use the same version of a pipeline.
+		shader_library.poll(retired_resources);
+		pipeline_registry.swap_rebuilt_pipelines(retired_resources);
+
 		// Request image from the swapchain to draw to
 		// vkAcquireNextImageKHR will request an image index from the swapchain.
 		// If the swapchain doesn't have an image we can use, it will block the thread with a maximum timeout.
@@ -312,99 +638,403 @@ int main(int argc, char** argv)
 		// Even though an image index is returned at the time of this call, it might still not be ready for use.
 		// By providing a semaphore, we can use this semaphore as a wait signal when submitting the command buffer to the queue,
 		// Which will guarentee that the command buffer will first start execution once the swapchain image is actually ready for use.
-		uint32_t swapchain_image_index;
-		vk_check(vkAcquireNextImageKHR(
-			vk_device,
-			vk_swapchain,
-			1000000000,
-			get_current_frame().swapchain_semaphore,
-			nullptr,
-			&swapchain_image_index));
+		uint32_t swapchain_image_index = 0;
+		bool swapchain_out_of_date = false;
+		if (!config.headless) {
+			CpuTimingScope scope(frame_timings, FrameStage::Acquire);
+
+			VkResult acquire_result = vkAcquireNextImageKHR(
+				vk_device,
+				vk_swapchain,
+				1000000000,
+				get_current_frame().swapchain_semaphore,
+				nullptr,
+				&swapchain_image_index);
+
+			// An out of date swapchain can no longer be presented to, so it has to be recreated before rendering.
+			// The semaphore is not signaled in that case, and nothing has been submitted yet, so the frame can simply be skipped.
+			// A suboptimal swapchain can still be used, so this frame is finished and the swapchain is recreated next frame.
+			if (acquire_result == VK_ERROR_OUT_OF_DATE_KHR) {
+				swapchain_out_of_date = true;
+			}
+			else if (acquire_result == VK_SUBOPTIMAL_KHR) {
+				resize_requested = true;
+			}
+			else {
+				vk_check(acquire_result);
+			}
+
+			// The presentation engine is done with the image once the acquire semaphore signals.
+			// The semaphore wait happens at the transfer stage, where the image is first written,
+			// so the layout transition only has to wait for that stage.
+			if (!swapchain_out_of_date) {
+				image_states.set_state(vk_swapchain_images[swapchain_image_index],
+					ImageState{ VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_NONE });
+			}
+		}
+
+		if (swapchain_out_of_date) {
+			resize_requested = true;
+			frame_timings.discard_frame();
+			continue;
+		}
 
 		// Record rendering commands
-		VkCommandBuffer cmd = get_current_frame().main_command_buffer;
+		// The main command buffer only starts the frame. Every render pass is recorded into its own command buffer,
+		// and all of them are submitted together in order.
+		FrameData& frame = get_current_frame();
+		VkCommandBuffer cmd = frame.main_command_buffer;
+		std::vector<VkCommandBuffer> frame_command_buffers;
+		uint64_t upload_wait_value = 0;
+
+		{
+			CpuTimingScope scope(frame_timings, FrameStage::Record);
+
+			// Everything uploaded since the last frame is submitted ahead of it, so this frame can use it
+			upload_manager.flush();
+			frame_timings.count(FrameCounter::UploadBytes, upload_manager.stats().bytes_uploaded);
+
+			// A command buffer has to be reset before we can use it again
+			vk_check(vkResetCommandBuffer(cmd, 0));
+
+			// The GPU is done with this frame's previous command buffers, so the worker pools can be reset as a whole
+			for (uint32_t worker = 0; worker < job_system.worker_count(); worker++) {
+				vk_check(vkResetCommandPool(vk_device, frame.worker_pools[worker].pool, 0));
+				frame.worker_pools[worker].used = 0;
+			}
 
-		// A command buffer has to be reset before we can use it again
-		vk_check(vkResetCommandBuffer(cmd, 0));
+			// Begin the command buffer recording.
+			// We will use this command buffer exactly once, which we will let Vulkan know
+			VkCommandBufferBeginInfo cmd_begin_info{};
+			cmd_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			cmd_begin_info.pNext = nullptr;
+			cmd_begin_info.pInheritanceInfo = nullptr;
+			cmd_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			_drawExtent.width = _drawImage.imageExtent.width;
+			_drawExtent.height = _drawImage.imageExtent.height;
+
+			// Start command buffer recording
+			vk_check(vkBeginCommandBuffer(cmd, &cmd_begin_info));
+
+			// Queries have to be reset before they can be written again.
+			// The first timestamp is written once all previous commands have started executing.
+			if (gpu_timestamps_supported) {
+				vkCmdResetQueryPool(cmd, get_current_frame().timestamp_query_pool, 0, 2);
+				vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, get_current_frame().timestamp_query_pool, 0);
+			}
 
-		// Begin the command buffer recording.
-		// We will use this command buffer exactly once, which we will let Vulkan know
-		VkCommandBufferBeginInfo cmd_begin_info{};
-		cmd_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		cmd_begin_info.pNext = nullptr;
-		cmd_begin_info.pInheritanceInfo = nullptr;
-		cmd_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			// Take over the resources uploaded since the last frame, before any pass uses them
+			upload_wait_value = upload_manager.record_acquire_barriers(cmd, image_states);
 
-		_drawExtent.width = _drawImage.imageExtent.width;
-		_drawExtent.height = _drawImage.imageExtent.height;
+			// Tiles changed since the last frame are copied before any pass draws the map
+			tile_map.record_upload(cmd, frame.arena);
+			frame_timings.count(FrameCounter::TileUploadBytes, tile_map.bytes_uploaded());
+			frame_timings.count(FrameCounter::TileUploadRegions, tile_map.regions_uploaded());
 
-		// Start command buffer recording
-		vk_check(vkBeginCommandBuffer(cmd, &cmd_begin_info));
+			// Sprites are sorted and written into the frame arena before any pass draws them
+			sprite_batch.begin();
+			for (const Sprite& entity : test_entities) {
+				sprite_batch.add(entity);
+			}
+			sprite_batch.prepare(frame.arena);
+			frame_timings.count(FrameCounter::Sprites, sprite_batch.stats().sprites);
+			frame_timings.count(FrameCounter::SpriteDraws, sprite_batch.stats().draws);
+
+			// Lights flicker in real time. Headless runs step a fixed 60th of a second per frame instead,
+			// so their captures stay the same on every run, like the clear color.
+			float light_time = config.headless ? frame_number / 60.f : (SDL_GetTicksNS() - loop_start_ticks) / 1e9f;
+			tile_lighting.prepare(frame.arena, test_lights, light_time);
+			frame_timings.count(FrameCounter::Lights, tile_lighting.stats().lights);
+
+			vk_check(vkEndCommandBuffer(cmd));
+			frame_command_buffers.push_back(cmd);
+
+			image_states.reset_counters();
+
+			// Describe the frame as a render graph.
+			// The graph decides which barriers are needed between the passes, so the passes only record their own work.
+			render_graph.reset();
+
+			RGImage drawImage = render_graph.import_image("draw image", _drawImage.image, _drawImage.imageView, _drawExtent);
+
+			//make a clear-color from frame number. This will flash with a 120 frame period.
+			VkClearColorValue clearValue;
+			float flash = std::abs(std::sin(frame_number / 120.f));
+			clearValue = { { 0.0f, 0.0f, flash, 1.0f } };
+
+			// We will overwrite all of the draw image, so we dont care about what it contained before
+			render_graph.add_pass("clear",
+				[&](RGPassBuilder& builder) {
+					builder.write(drawImage, ImageUsage::TransferDst, true);
+				},
+				[=](VkCommandBuffer cmd, const RenderGraph& graph) {
+					VkImageSubresourceRange clearRange = vkinit::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+					vkCmdClearColorImage(cmd, graph.get_image(drawImage), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearValue, 1, &clearRange);
+				});
+
+			// Draw the triangle on top of the cleared image, so the attachment is loaded instead of cleared
+			// The fallback pipeline is used for as long as the triangle pipeline is still compiling
+			VkPipeline trianglePipeline = _trianglePipeline.get();
+
+			render_graph.add_pass("geometry",
+				[&](RGPassBuilder& builder) {
+					builder.write(drawImage, ImageUsage::ColorAttachment);
+				},
+				[=](VkCommandBuffer cmd, const RenderGraph& graph) {
+					VkExtent2D extent = graph.get_extent(drawImage);
+
+					begin_color_rendering(cmd, graph.get_image_view(drawImage), extent);
+
+					vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, trianglePipeline);
+					bindless_heap.bind(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+					// The vertex shader has the triangle's vertices hardcoded
+					vkCmdDraw(cmd, 3, 1, 0, 0);
+
+					vkCmdEndRendering(cmd);
+				});
+
+			// The map is blended on top of the geometry
+			RGImage tileAtlas = render_graph.import_image("tile atlas", tile_renderer.atlas_image(), tile_renderer.atlas_view(), tile_renderer.atlas_extent());
+			RGImage lightImage = render_graph.import_image("tile lights", tile_lighting.light_image(), tile_lighting.light_view(), tile_lighting.light_extent());
+
+			// Every tile is lit on the GPU, and the whole light texture is rewritten
+			render_graph.add_pass("lighting",
+				[&](RGPassBuilder& builder) {
+					builder.write(lightImage, ImageUsage::ComputeStorageWrite, true);
+				},
+				[=](VkCommandBuffer cmd, const RenderGraph& graph) {
+					tile_lighting.record(cmd, tile_map);
+				});
+
+			render_graph.add_pass("tiles",
+				[&](RGPassBuilder& builder) {
+					builder.read(tileAtlas, ImageUsage::FragmentSampled);
+					builder.read(lightImage, ImageUsage::FragmentSampled);
+					builder.write(drawImage, ImageUsage::ColorAttachment);
+				},
+				[=](VkCommandBuffer cmd, const RenderGraph& graph) {
+					VkExtent2D extent = graph.get_extent(drawImage);
+
+					begin_color_rendering(cmd, graph.get_image_view(drawImage), extent);
+
+					bindless_heap.bind(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+					tile_renderer.draw(cmd, tile_map, extent);
+
+					vkCmdEndRendering(cmd);
+				});
+
+			// Entities stand on top of the map, so they are placed with the map's view
+			render_graph.add_pass("sprites",
+				[&](RGPassBuilder& builder) {
+					builder.read(tileAtlas, ImageUsage::FragmentSampled);
+					builder.write(drawImage, ImageUsage::ColorAttachment);
+				},
+				[=](VkCommandBuffer cmd, const RenderGraph& graph) {
+					VkExtent2D extent = graph.get_extent(drawImage);
+
+					begin_color_rendering(cmd, graph.get_image_view(drawImage), extent);
+
+					bindless_heap.bind(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+					MapView view = fit_map_view(tile_map.width(), tile_map.height(), extent);
+					sprite_batch.draw(cmd, view, extent, TileRenderer::ATLAS_COLUMNS);
+
+					vkCmdEndRendering(cmd);
+				});
+
+			if (config.headless) {
+				// Read the draw image back into host memory instead of presenting it.
+				// Nothing in the graph consumes the readback, so the pass is marked as having side effects to keep it alive.
+				VkBuffer readbackBuffer = get_current_frame().readback_buffer.buffer;
+
+				render_graph.add_pass("readback",
+					[&](RGPassBuilder& builder) {
+						builder.read(drawImage, ImageUsage::TransferSrc);
+						builder.has_side_effects();
+					},
+					[=](VkCommandBuffer cmd, const RenderGraph& graph) {
+						vkutil::copy_image_to_buffer(cmd, graph.get_image(drawImage), readbackBuffer, graph.get_extent(drawImage));
+
+						// Make the copied pixels visible to the CPU once the frame has finished
+						VkMemoryBarrier2 hostBarrier{};
+						hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+						hostBarrier.pNext = nullptr;
+						hostBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+						hostBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+						hostBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+						hostBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+
+						VkDependencyInfo depInfo{};
+						depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+						depInfo.pNext = nullptr;
+						depInfo.memoryBarrierCount = 1;
+						depInfo.pMemoryBarriers = &hostBarrier;
+
+						vkCmdPipelineBarrier2(cmd, &depInfo);
+					});
+			}
+			else {
+				// The swapchain image is the output of the frame. After the last pass it is transitioned for presenting.
+				RGImage swapchainImage = render_graph.import_image("swapchain image",
+					vk_swapchain_images[swapchain_image_index], vk_swapchain_imageviews[swapchain_image_index], vk_swapchain_extent,
+					true, ImageUsage::Present);
+
+				// Execute a copy from the draw image into the swapchain
+				render_graph.add_pass("present",
+					[&](RGPassBuilder& builder) {
+						builder.read(drawImage, ImageUsage::TransferSrc);
+						builder.write(swapchainImage, ImageUsage::TransferDst, true);
+					},
+					[=](VkCommandBuffer cmd, const RenderGraph& graph) {
+						vkutil::copy_image_to_image(cmd, graph.get_image(drawImage), graph.get_image(swapchainImage),
+							graph.get_extent(drawImage), graph.get_extent(swapchainImage));
+					});
+			}
 
-		// Transition our main draw image into general layout so we can write into it
-		// We will overwrite it all so we dont care about what the older layout was
-		transition_image(cmd, _drawImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+			render_graph.compile();
 
-		//make a clear-color from frame number. This will flash with a 120 frame period.
-		VkClearColorValue clearValue;
-		float flash = std::abs(std::sin(frame_number / 120.f));
-		clearValue = { { 0.0f, 0.0f, flash, 1.0f } };
+			frame_timings.count(FrameCounter::Barriers, image_states.barriers_emitted());
+			frame_timings.count(FrameCounter::BarrierBatches, image_states.barrier_batches_emitted());
 
-		VkImageSubresourceRange clearRange = image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+			// Record the passes in parallel.
+			// All barriers were worked out when the graph was compiled, so each pass can be recorded without knowing about the others.
+			uint32_t pass_count = render_graph.executed_pass_count();
+			std::vector<VkCommandBuffer> pass_command_buffers(pass_count);
 
-		//clear image
-		vkCmdClearColorImage(cmd, _drawImage.image, VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &clearRange);
+			job_system.parallel_for(pass_count, [&](uint32_t position, uint32_t workerIndex) {
+				VkCommandBuffer passCmd = get_worker_command_buffer(frame, workerIndex);
 
-		// Begin a render pass connected to our draw image
-		//VkRenderingAttachmentInfo colorAttachment = v
+				vk_check(vkBeginCommandBuffer(passCmd, &cmd_begin_info));
+				render_graph.record_pass(passCmd, position);
+				vk_check(vkEndCommandBuffer(passCmd));
 
-		// Transition the draw image and the swapchain image into their correct transfer layouts
-		transition_image(cmd, _drawImage.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-		transition_image(cmd, vk_swapchain_images[swapchain_image_index], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+				pass_command_buffers[position] = passCmd;
+			});
 
-		// Execute a copy from the draw image into the swapchain
-		vkutil::copy_image_to_image(cmd, _drawImage.image, vk_swapchain_images[swapchain_image_index], _drawExtent, vk_swapchain_extent);
+			frame_command_buffers.insert(frame_command_buffers.end(), pass_command_buffers.begin(), pass_command_buffers.end());
 
-		// Set swapchain image layout to present so we can show it on the screen
-		transition_image(cmd, vk_swapchain_images[swapchain_image_index], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+			// The last command buffer moves the images into their final layouts, and ends the frame
+			VkCommandBuffer endCmd = get_worker_command_buffer(frame, 0);
+			vk_check(vkBeginCommandBuffer(endCmd, &cmd_begin_info));
 
-		// Finalize the command buffer (we can no longer add commands, but it can now be executed)
-		vk_check(vkEndCommandBuffer(cmd));
+			render_graph.record_final_barriers(endCmd);
 
-		// Prepare the submission to the queue.
-		// We want to wait on the presentSemaphore, as that semaphore is signaled when the swapchain is ready
-		// We will signal the renderSemaphore, to singal that rendering has finished
-		VkCommandBufferSubmitInfo cmdInfo = command_buffer_submit_info(cmd);
+			// The second timestamp is written once all commands of the frame have finished executing
+			if (gpu_timestamps_supported) {
+				vkCmdWriteTimestamp2(endCmd, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, frame.timestamp_query_pool, 1);
+				frame.timestamps_written = true;
+			}
 
-		VkSemaphoreSubmitInfo waitInfo = semaphore_submit_info(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, get_current_frame().swapchain_semaphore);
-		VkSemaphoreSubmitInfo signalInfo = semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, get_current_frame().render_semaphore);
+			// Finalize the command buffer (we can no longer add commands, but it can now be executed)
+			vk_check(vkEndCommandBuffer(endCmd));
+			frame_command_buffers.push_back(endCmd);
+		}
+
+		{
+			CpuTimingScope scope(frame_timings, FrameStage::Submit);
+
+			// Prepare the submission to the queue.
+			// We want to wait on the presentSemaphore, as that semaphore is signaled when the swapchain is ready
+			// We will signal the renderSemaphore, to singal that rendering has finished,
+			// and the next value on the frame timeline, to let the CPU know when the frame data can be reused.
+			// All command buffers of the frame go into a single submission, and execute in the order they are listed
+			std::vector<VkCommandBufferSubmitInfo> cmdInfos;
+			for (VkCommandBuffer frameCmd : frame_command_buffers) {
+				cmdInfos.push_back(vkinit::command_buffer_submit_info(frameCmd));
+			}
+
+			get_current_frame().timeline_value = frame_timeline.next_value();
+
+			frame.arena.flush();
+			frame_timings.count(FrameCounter::ArenaBytes, frame.arena.stats().used);
+
+			// When headless there is no swapchain image to wait for or present, so the timeline is all we need
+			std::vector<VkSemaphoreSubmitInfo> waitInfos;
+			if (!config.headless) {
+				waitInfos.push_back(vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, get_current_frame().swapchain_semaphore));
+			}
+			// The frame can only start once the copies of the resources it uses have finished
+			if (upload_wait_value != 0) {
+				waitInfos.push_back(vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, upload_manager.timeline_semaphore(), upload_wait_value));
+			}
+
+			VkSemaphoreSubmitInfo signalInfos[] = {
+				vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame_timeline.semaphore, get_current_frame().timeline_value),
+				// Covers the blit to the swapchain image, which is a transfer, and its transition to the present layout
+				vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, get_current_frame().render_semaphore)
+			};
+
+			VkSubmitInfo2 submit = vkinit::submit_info(cmdInfos.data(), signalInfos, config.headless ? 1 : 2,
+				waitInfos.data(), (uint32_t)waitInfos.size(), (uint32_t)cmdInfos.size());
 
-		VkSubmitInfo2 submit = submit_info(&cmdInfo, &signalInfo, &waitInfo);
+			// Submit command buffer to the queue and execute it
+			// The frame timeline will reach this frame's value once the graphic commands finish execution
+			vk_check(vkQueueSubmit2(graphics_queue, 1, &submit, VK_NULL_HANDLE));
 
-		// Submit command buffer to the queue and execute it
-		// renderFence will now block until the graphic commands finish execution
-		vk_check(vkQueueSubmit2(graphics_queue, 1, &submit, get_current_frame().render_fence));
+			// Anything retired by a resize can be destroyed once this submission has finished.
+			// Submissions to a queue signal the timeline in order, so no frame in flight can still be using them by then.
+			for (auto& deletor : retired_resources.deletors) {
+				get_current_frame()._deletionQueue.push_function(std::move(deletor));
+			}
+			retired_resources.deletors.clear();
+		}
+
+		last_submitted_frame = &get_current_frame();
+
+		if (!config.headless) {
+			CpuTimingScope scope(frame_timings, FrameStage::Present);
+
+			// Prepare present
+			// This will put the image we just rendered to into the visible window.
+			// We want to wait on the renderSemaphore for that,
+			// As its necessary that drawing commands have finished before the image is displayed to the user
+			VkPresentInfoKHR presentInfo{};
+			presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+			presentInfo.pNext = nullptr;
 
-		// Prepare present
-		// This will put the image we just rendered to into the visible window.
-		// We want to wait on the renderSemaphore for that,
-		// As its necessary that drawing commands have finished before the image is displayed to the user
-		VkPresentInfoKHR presentInfo{};
-		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-		presentInfo.pNext = nullptr;
+			presentInfo.pSwapchains = &vk_swapchain;
+			presentInfo.swapchainCount = 1;
 
-		presentInfo.pSwapchains = &vk_swapchain;
-		presentInfo.swapchainCount = 1;
+			presentInfo.pWaitSemaphores = &get_current_frame().render_semaphore;
+			presentInfo.waitSemaphoreCount = 1;
 
-		presentInfo.pWaitSemaphores = &get_current_frame().render_semaphore;
-		presentInfo.waitSemaphoreCount = 1;
+			presentInfo.pImageIndices = &swapchain_image_index;
 
-		presentInfo.pImageIndices = &swapchain_image_index;
+			// The swapchain is recreated at the start of the next frame if it no longer matches the window
+			VkResult present_result = vkQueuePresentKHR(graphics_queue, &presentInfo);
+			if (present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR) {
+				resize_requested = true;
+			}
+			else {
+				vk_check(present_result);
+			}
+		}
 
-		vk_check(vkQueuePresentKHR(graphics_queue, &presentInfo));
+		frame_pacer.end_frame();
 
 		// increase the number of frames drawn
 		frame_number++;
+
+		if (config.headless && frame_number >= (int)config.headless_frame_count) {
+			should_quit = true;
+		}
+
+		Uint64 frame_counter = SDL_GetPerformanceCounter() - frame_start_counter;
+		frame_timings.record(FrameStage::CpuFrame, (double)frame_counter * 1000.0 / (double)SDL_GetPerformanceFrequency());
+		frame_timings.end_frame();
+
+		if (SDL_GetTicksNS() - last_overlay_update_ticks > 500000000) {
+			memory_budget.update((uint32_t)frame_number);
+
+			if (main_window != nullptr) {
+				std::string title = "Roguelike-X | " + frame_timings.summary() + " | " + memory_budget.summary();
+				SDL_SetWindowTitle(main_window, title.c_str());
+			}
+			last_overlay_update_ticks = SDL_GetTicksNS();
+		}
 	}
 
 	// Vulkan cleanup
@@ -415,30 +1045,121 @@ int main(int argc, char** argv)
 	// Wait for the GPU to stop doing its thing
 	vkDeviceWaitIdle(vk_device);
 
+	// The worker count is needed to destroy the worker command pools later on
+	uint32_t job_system_workers = job_system.worker_count();
+	job_system.shutdown();
+
+	if (config.headless) {
+		Uint64 elapsed_ns = SDL_GetTicksNS() - loop_start_ticks;
+		double elapsed_ms = (double)elapsed_ns / 1000000.0;
+
+		SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Rendered %i headless frames in %.2f ms (%.3f ms/frame)",
+			frame_number, elapsed_ms, frame_number > 0 ? elapsed_ms / frame_number : 0.0);
+
+		if (last_submitted_frame != nullptr) {
+			save_headless_capture(*last_submitted_frame);
+		}
+	}
+
+	// Summarize where the frame time went
+	for (uint32_t stage = 0; stage < (uint32_t)FrameStage::Count; stage++) {
+		FrameStageStats stats = frame_timings.stats((FrameStage)stage);
+		SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "%-10s min %7.3f ms | avg %7.3f ms | p99 %7.3f ms",
+			frame_stage_name((FrameStage)stage), stats.min_ms, stats.avg_ms, stats.p99_ms);
+	}
+	frame_timings.close_csv();
+
+	// Memory usage is taken before anything is destroyed, so it shows what the game was using
+	memory_budget.update((uint32_t)frame_number);
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "%s", memory_budget.summary().c_str());
+	if (!config.memory_stats_path.empty() && !memory_budget.write_json(config.memory_stats_path.c_str())) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to write memory statistics to %s", config.memory_stats_path.c_str());
+	}
+
+	if (config.headless) {
+		for (uint32_t i = 0; i < frames_in_flight; i++) {
+			vkutil::destroy_buffer(_allocator, frames[i].readback_buffer);
+		}
+	}
+
+	tile_lighting.destroy();
+	tile_renderer.destroy();
+	tile_map.destroy();
+
+	const UploadManager::Stats& upload_stats = upload_manager.stats();
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Upload manager copied %llu bytes in %u submissions, stalled %u times on a full staging ring",
+		(unsigned long long)upload_stats.total_bytes_uploaded, upload_stats.submissions, upload_stats.stalls);
+	upload_manager.destroy();
+
+	VkDeviceSize arena_high_water_mark = 0;
+	uint32_t arena_failed_allocations = 0;
+	for (uint32_t i = 0; i < frames_in_flight; i++) {
+		arena_high_water_mark = std::max(arena_high_water_mark, frames[i].arena.stats().high_water_mark);
+		arena_failed_allocations += frames[i].arena.stats().failed_allocations;
+		frames[i].arena.destroy();
+	}
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Frame arenas: at most %llu bytes of %u KB used in a frame, %u allocations did not fit",
+		(unsigned long long)arena_high_water_mark, config.frame_arena_kb, arena_failed_allocations);
+
 	// Destroy command pool
 	// Destroying the command pool will destroy associated command buffers
-	for (int i = 0; i < FRAME_OVERLAP; i++) {
+	for (uint32_t i = 0; i < frames_in_flight; i++) {
 		vkDestroyCommandPool(vk_device, frames[i].commandPool, nullptr);
+		for (uint32_t worker = 0; worker < job_system_workers; worker++) {
+			vkDestroyCommandPool(vk_device, frames[i].worker_pools[worker].pool, nullptr);
+		}
+
+		if (gpu_timestamps_supported) {
+			vkDestroyQueryPool(vk_device, frames[i].timestamp_query_pool, nullptr);
+		}
 
 		// Destroy sync objects
-		vkDestroyFence(vk_device, frames[i].render_fence, nullptr);
 		vkDestroySemaphore(vk_device, frames[i].render_semaphore, nullptr);
 		vkDestroySemaphore(vk_device, frames[i].swapchain_semaphore, nullptr);
 
 		frames[i]._deletionQueue.flush();
 	}
 
+	// Resources retired by a resize right before shutting down, which never got handed to a frame
+	retired_resources.flush();
+
+	const RenderGraph::Stats& graph_stats = render_graph.stats();
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Render graph: %u passes (%u culled), %u transient images using %llu of %llu bytes",
+		graph_stats.passes, graph_stats.culled_passes, graph_stats.transient_images,
+		(unsigned long long)graph_stats.transient_bytes_allocated, (unsigned long long)graph_stats.transient_bytes_requested);
+
+	render_graph.destroy();
+
+	frame_timeline.destroy(vk_device);
+
 	// Flush the global deletion queue
 	_mainDeletionQueue.flush();
 
-	// Destroy swapchain
-	vkDestroySwapchainKHR(vk_device, vk_swapchain, nullptr);
-	for (int i = 0; i < vk_swapchain_imageviews.size(); i++) {
-		vkDestroyImageView(vk_device, vk_swapchain_imageviews[i], nullptr);
-	}
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Pipeline registry built %u pipelines, %u requests reused an existing one",
+		pipeline_registry.pipeline_count(), pipeline_registry.cache_hits());
+	pipeline_registry.destroy();
+	shader_library.destroy();
+
+	bindless_heap.destroy();
+
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Layout cache created %u descriptor set layouts and %u pipeline layouts",
+		layout_cache.descriptor_set_layout_count(), layout_cache.pipeline_layout_count());
+	layout_cache.destroy();
+
+	// Save the pipeline cache, so the next launch can skip compiling pipelines
+	pipeline_cache.save();
+	pipeline_cache.destroy();
 
-	// Destroy surface
-	vkDestroySurfaceKHR(vk_instance, vk_surface, nullptr);
+	if (!config.headless) {
+		// Destroy swapchain
+		vkDestroySwapchainKHR(vk_device, vk_swapchain, nullptr);
+		for (int i = 0; i < vk_swapchain_imageviews.size(); i++) {
+			vkDestroyImageView(vk_device, vk_swapchain_imageviews[i], nullptr);
+		}
+
+		// Destroy surface
+		vkDestroySurfaceKHR(vk_instance, vk_surface, nullptr);
+	}
 
 	// Destroy device
 	vkDestroyDevice(vk_device, nullptr);
@@ -450,7 +1171,9 @@ int main(int argc, char** argv)
 	vkDestroyInstance(vk_instance, nullptr);
 
 	// Close and destroy the window
-	SDL_DestroyWindow(main_window);
+	if (main_window != nullptr) {
+		SDL_DestroyWindow(main_window);
+	}
 
 	// Clean up SDL allocations
 	// Also revert display resolution back to what the user expects (if you changed it during the game)
@@ -463,136 +1186,394 @@ int main(int argc, char** argv)
 void panic_and_exit(const char* error_message, ...) 
 {
 	SDL_LogCritical(SDL_LOG_CATEGORY_ERROR, "Application is panicking and exiting!");
-	SDL_LogCritical(SDL_LOG_CATEGORY_ERROR, error_message);
+
+	// The message is a format string, like the ones the SDL log functions take
+	va_list args;
+	va_start(args, error_message);
+	SDL_LogMessageV(SDL_LOG_CATEGORY_ERROR, SDL_LOG_PRIORITY_CRITICAL, error_message, args);
+	va_end(args);
+
 	exit(1);
 }
 
-void vk_check(VkResult vkResult) 
+void create_swapchain(uint32_t width, uint32_t height)
 {
-	if (vkResult != VK_SUCCESS) {
-		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Detected vulkan error: %i", vkResult);
-		exit(1);
+	vkb::SwapchainBuilder swapchainBuilder{
+		vk_physical_device,
+		vk_device,
+		vk_surface
+	};
+
+	vk_swapchain_image_format = VK_FORMAT_B8G8R8A8_UNORM;
+
+	// The configured present mode is tried first.
+	// The two modes that do not wait for vsync fall back to each other, since they are closest in latency.
+	// FIFO (vsync, which limits FPS to the refresh rate of the monitor) is always supported, so it is the final fallback.
+	swapchainBuilder.set_desired_present_mode(config.present_mode);
+	if (config.present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
+		swapchainBuilder.add_fallback_present_mode(VK_PRESENT_MODE_IMMEDIATE_KHR);
+	}
+	else if (config.present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+		swapchainBuilder.add_fallback_present_mode(VK_PRESENT_MODE_MAILBOX_KHR);
+	}
+	swapchainBuilder.add_fallback_present_mode(VK_PRESENT_MODE_FIFO_KHR);
+
+	// Passing the old swapchain lets the driver reuse its resources, and allows images acquired from it
+	// to still be presented while the new one is being created
+	vkb::Swapchain vkbSwapchain = swapchainBuilder
+		.set_old_swapchain(vk_swapchain)
+		.set_desired_format(VkSurfaceFormatKHR{
+			.format = vk_swapchain_image_format, .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR })
+		.set_desired_extent(width, height)
+		.add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+		.build()
+		.value();
+
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Using present mode %s (requested %s) with %u frames in flight",
+		present_mode_name(vkbSwapchain.present_mode), present_mode_name(config.present_mode), frames_in_flight);
+
+	vk_swapchain_extent = vkbSwapchain.extent;
+	vk_swapchain = vkbSwapchain.swapchain;
+	vk_swapchain_images = vkbSwapchain.get_images().value();
+	vk_swapchain_imageviews = vkbSwapchain.get_image_views().value();
+
+	for (VkImage image : vk_swapchain_images) {
+		image_states.track(image, VK_IMAGE_ASPECT_COLOR_BIT);
 	}
 }
 
-void transition_image(VkCommandBuffer cmd, VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout) 
+void resize_swapchain(SDL_Window* window)
 {
-	VkImageMemoryBarrier2 image_barrier{};
-	image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-	image_barrier.pNext = nullptr;
-	
-	// Specify the pipeline stages where memory operations must complete before the transition
-	// VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT = All commands in the pipeline should be completed.
-	image_barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	int width, height;
+	SDL_GetWindowSizeInPixels(window, &width, &height);
+
+	// A minimized or zero sized window has no surface area, so there is nothing to create yet
+	if (width <= 0 || height <= 0) {
+		return;
+	}
+
+	// The old swapchain, its image views and the old draw image might still be used by frames in flight.
+	// Instead of waiting for the whole device to go idle right away, they are retired and destroyed once the GPU is done with them.
+	VkSwapchainKHR old_swapchain = vk_swapchain;
+	std::vector<VkImageView> old_imageviews = vk_swapchain_imageviews;
+	AllocatedImage old_draw_image = _drawImage;
+
+	// The old images will never be used again, so their states no longer need to be tracked
+	for (VkImage image : vk_swapchain_images) {
+		image_states.forget(image);
+	}
+	image_states.forget(old_draw_image.image);
+
+	create_swapchain((uint32_t)width, (uint32_t)height);
+	_drawImage = create_draw_image((uint32_t)width, (uint32_t)height);
+	image_states.track(_drawImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
+
+	retired_resources.push_function([=]() {
+		for (VkImageView imageview : old_imageviews) {
+			vkDestroyImageView(vk_device, imageview, nullptr);
+		}
+		destroy_draw_image(old_draw_image);
+
+		// The frame timeline only covers rendering. The last presents of the old swapchain signal nothing it could wait on
+		// (that needs present fences from VK_EXT_swapchain_maintenance1), so the queue is drained before the swapchain is destroyed.
+		// By now every frame that rendered to it has finished, so this is a short stall, once per resize.
+		vk_check(vkQueueWaitIdle(graphics_queue));
+		vkDestroySwapchainKHR(vk_device, old_swapchain, nullptr);
+	});
+
+	resize_requested = false;
+}
+
+AllocatedImage create_draw_image(uint32_t width, uint32_t height)
+{
+	AllocatedImage drawImage{};
+
+	VkExtent3D drawImageExtent = {};
+	drawImageExtent.width = width;
+	drawImageExtent.height = height;
+	drawImageExtent.depth = 1;
 
-	// Any previous write operations have to complete before transitioning the image.
-	image_barrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+	drawImage.imageFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+	drawImage.imageExtent = drawImageExtent;
 
-	// After transition, any command can use the image
-	image_barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	// All images and buffers need to specify usage flags.
+	// These allow the driver to perform optimizations in the background depending on what that
+	// buffer or image is going to do later.
+	VkImageUsageFlags drawImageUsages{};
+	drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	drawImageUsages |= VK_IMAGE_USAGE_STORAGE_BIT;
+	drawImageUsages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-	// After transition, both read and write access is allowed
-	image_barrier.dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT;
+	VkImageCreateInfo rimg_info = vkinit::image_create_info(drawImage.imageFormat, drawImageUsages, drawImageExtent);
 
-	// Describe the transition
-	image_barrier.oldLayout = currentLayout;
-	image_barrier.newLayout = newLayout;
+	// For the draw image, we want to allocate it from GPU local memory
+	VmaAllocationCreateInfo rimg_allocinfo = {};
+	rimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	rimg_allocinfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	VkImageAspectFlags aspectMask = (newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL) ?
-		VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+	// Allocate and create the image
+	vk_check(vmaCreateImage(_allocator, &rimg_info, &rimg_allocinfo, &drawImage.image, &drawImage.allocation, nullptr));
+	vkutil::track_allocation(_allocator, drawImage.allocation, MemoryCategory::Images);
+
+	// Build a image-view for the draw image to use for rendering
+	VkImageViewCreateInfo rview_info = vkinit::imageview_create_info(drawImage.imageFormat, drawImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
+	vk_check(vkCreateImageView(vk_device, &rview_info, nullptr, &drawImage.imageView));
 
-	image_barrier.subresourceRange = image_subresource_range(aspectMask);
-	image_barrier.image = image;
+	return drawImage;
+}
 
-	VkDependencyInfo depInfo{};
-	depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-	depInfo.pNext = nullptr;
+void destroy_draw_image(const AllocatedImage& image)
+{
+	vkDestroyImageView(vk_device, image.imageView, nullptr);
+	vkutil::untrack_allocation(_allocator, image.allocation);
+	vmaDestroyImage(_allocator, image.image, image.allocation);
+}
 
-	depInfo.imageMemoryBarrierCount = 1;
-	depInfo.pImageMemoryBarriers = &image_barrier;
+VkCommandBuffer get_worker_command_buffer(FrameData& frame, uint32_t workerIndex)
+{
+	WorkerCommandPool& workerPool = frame.worker_pools[workerIndex];
 
-	vkCmdPipelineBarrier2(cmd, &depInfo);
+	if (workerPool.used == workerPool.buffers.size()) {
+		VkCommandBufferAllocateInfo cmdAllocInfo{};
+		cmdAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		cmdAllocInfo.pNext = nullptr;
+		cmdAllocInfo.commandPool = workerPool.pool;
+		cmdAllocInfo.commandBufferCount = 1;
+		cmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+		VkCommandBuffer cmd;
+		vk_check(vkAllocateCommandBuffers(vk_device, &cmdAllocInfo, &cmd));
+		workerPool.buffers.push_back(cmd);
+	}
+
+	return workerPool.buffers[workerPool.used++];
 }
 
-VkImageSubresourceRange image_subresource_range(VkImageAspectFlags aspectMask) 
+void spawn_test_entities(uint32_t count, uint64_t seed)
 {
-	VkImageSubresourceRange subImage{};
-	subImage.aspectMask = aspectMask;
-	subImage.baseMipLevel = 0;
-	subImage.levelCount = VK_REMAINING_MIP_LEVELS;
-	subImage.baseArrayLayer = 0;
-	subImage.layerCount = VK_REMAINING_ARRAY_LAYERS;
-
-	return subImage;
+	// Entities only stand on floor tiles
+	std::vector<std::pair<uint32_t, uint32_t>> floors;
+	for (uint32_t y = 0; y < tile_map.height(); y++) {
+		for (uint32_t x = 0; x < tile_map.width(); x++) {
+			if ((tile_map.get(x, y) & 0xFF) == '.') {
+				floors.push_back({ x, y });
+			}
+		}
+	}
+
+	test_entities.clear();
+	if (floors.empty()) {
+		return;
+	}
+
+	uint32_t atlas = tile_renderer.atlas_slot();
+	Uint64 state = seed;
+
+	for (uint32_t i = 0; i < count; i++) {
+		auto [x, y] = floors[SDL_rand_r(&state, (Sint32)floors.size())];
+
+		Sprite sprite{};
+		sprite.x = (float)x;
+		sprite.y = (float)y;
+		sprite.texture = atlas;
+		sprite.blend = SpriteBlend::Alpha;
+
+		// Added in no particular order, the sprite batch sorts them into as few draws as it can
+		if (SDL_rand_r(&state, 3) == 0) {
+			sprite.cell = '$';
+			sprite.tint = pack_tint(240, 215, 60);
+			sprite.layer = LAYER_ITEMS;
+		}
+		else {
+			sprite.cell = 'g';
+			sprite.tint = pack_tint(90, 205, 75);
+			sprite.layer = LAYER_MONSTERS;
+
+			// Some monsters glow
+			if (SDL_rand_r(&state, 8) == 0) {
+				Sprite glow = sprite;
+				glow.cell = 219;
+				glow.tint = pack_tint(255, 140, 40, 70);
+				glow.layer = LAYER_GLOW;
+				glow.blend = SpriteBlend::Additive;
+				test_entities.push_back(glow);
+			}
+		}
+
+		test_entities.push_back(sprite);
+	}
 }
 
-VkSemaphoreSubmitInfo semaphore_submit_info(VkPipelineStageFlags2 stageMask, VkSemaphore semaphore) 
+void spawn_test_lights(uint32_t count, uint64_t seed)
 {
-	VkSemaphoreSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
-	submitInfo.pNext = nullptr;
-	submitInfo.semaphore = semaphore;
-	submitInfo.stageMask = stageMask;
-	submitInfo.deviceIndex = 0;
-	submitInfo.value = 1;
-
-	return submitInfo;
+	test_lights.clear();
+
+	std::vector<std::pair<uint32_t, uint32_t>> floors;
+	for (uint32_t y = 0; y < tile_map.height(); y++) {
+		for (uint32_t x = 0; x < tile_map.width(); x++) {
+			uint8_t glyph = tile_map.get(x, y) & 0xFF;
+
+			// The player carries a light of their own
+			if (glyph == '@') {
+				TileLight light{};
+				light.position[0] = x + 0.5f;
+				light.position[1] = y + 0.5f;
+				light.radius = 10.0f;
+				light.intensity = 1.0f;
+				light.color = pack_tint(255, 255, 235);
+				test_lights.push_back(light);
+			}
+			else if (glyph == '.') {
+				floors.push_back({ x, y });
+			}
+		}
+	}
+
+	if (floors.empty()) {
+		return;
+	}
+
+	Uint64 state = seed;
+
+	for (uint32_t i = 0; i < count; i++) {
+		auto [x, y] = floors[SDL_rand_r(&state, (Sint32)floors.size())];
+
+		TileLight torch{};
+		torch.position[0] = x + 0.5f;
+		torch.position[1] = y + 0.5f;
+		torch.radius = 4.0f + (float)SDL_rand_r(&state, 5);
+		torch.intensity = 0.6f;
+		torch.color = pack_tint(255, 150 + SDL_rand_r(&state, 40), 70);
+		torch.flickerSeed = i + 1;
+		test_lights.push_back(torch);
+	}
 }
 
-VkCommandBufferSubmitInfo command_buffer_submit_info(VkCommandBuffer cmd) 
+void save_headless_capture(FrameData& frame)
 {
-	VkCommandBufferSubmitInfo info{};
-	info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
-	info.pNext = nullptr;
-	info.commandBuffer = cmd;
-	info.deviceMask = 0;
+	VkDeviceSize size = (VkDeviceSize)_drawExtent.width * _drawExtent.height * 4 * sizeof(uint16_t);
+
+	// The memory might not be host coherent, so make sure the GPU writes are visible to the CPU
+	vk_check(vmaInvalidateAllocation(_allocator, frame.readback_buffer.allocation, 0, size));
 
-	return info;
+	// The checksum makes it possible to compare the output of two runs from the log alone
+	uint64_t checksum = vkutil::frame_checksum(frame.readback_buffer.info.pMappedData, size);
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Last frame checksum: %016llx", (unsigned long long)checksum);
+
+	if (config.headless_capture_path.empty()) {
+		return;
+	}
+
+	const char* capture_path = config.headless_capture_path.c_str();
+	if (!vkutil::write_frame_ppm(capture_path, frame.readback_buffer.info.pMappedData, _drawExtent.width, _drawExtent.height)) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to write frame capture to %s", capture_path);
+		return;
+	}
+
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Wrote frame capture to %s", capture_path);
 }
 
-VkSubmitInfo2 submit_info(VkCommandBufferSubmitInfo* cmd,
-	VkSemaphoreSubmitInfo* signalSemaphoreInfo,
-	VkSemaphoreSubmitInfo* waitSemaphoreInfo) 
+void read_gpu_timestamps(FrameData& frame)
 {
-	VkSubmitInfo2 info = {};
-	info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
-	info.pNext = nullptr;
+	if (!gpu_timestamps_supported || !frame.timestamps_written) {
+		return;
+	}
 
-	info.waitSemaphoreInfoCount = waitSemaphoreInfo == nullptr ? 0 : 1;
-	info.pWaitSemaphoreInfos = waitSemaphoreInfo;
+	// The frame's timeline value has already been waited on, so the results are available without having to wait for them
+	uint64_t timestamps[2];
+	VkResult result = vkGetQueryPoolResults(
+		vk_device,
+		frame.timestamp_query_pool,
+		0,
+		2,
+		sizeof(timestamps),
+		timestamps,
+		sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT);
+
+	if (result != VK_SUCCESS) {
+		return;
+	}
 
-	info.signalSemaphoreInfoCount = signalSemaphoreInfo == nullptr ? 0 : 1;
-	info.pSignalSemaphoreInfos = signalSemaphoreInfo;
+	// Note that this measures the previous use of this frame data, so GPU timings lag frames_in_flight frames behind
+	uint64_t ticks = (timestamps[1] - timestamps[0]) & gpu_timestamp_mask;
+	frame_timings.record(FrameStage::GpuFrame, (double)ticks * gpu_timestamp_period / 1000000.0);
+}
 
-	info.commandBufferInfoCount = 1;
-	info.pCommandBufferInfos = cmd;
+void vk_check(VkResult vkResult) 
+{
+	if (vkResult != VK_SUCCESS) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Detected vulkan error: %i", vkResult);
+		exit(1);
+	}
+}
 
-	return info;
+// Starts dynamic rendering into a single color attachment that is already in the attachment layout, keeping what it holds.
+// Viewport and scissor are dynamic state in our pipelines, so they are set to cover the whole attachment.
+void begin_color_rendering(VkCommandBuffer cmd, VkImageView colorView, VkExtent2D extent)
+{
+	VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(colorView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	VkRenderingInfo renderInfo = vkinit::rendering_info(extent, &colorAttachment, nullptr);
+	vkCmdBeginRendering(cmd, &renderInfo);
+
+	VkViewport viewport{};
+	viewport.x = 0;
+	viewport.y = 0;
+	viewport.width = (float)extent.width;
+	viewport.height = (float)extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+	VkRect2D scissor{};
+	scissor.offset = { 0, 0 };
+	scissor.extent = extent;
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
 }
 
 void init_triangle_pipeline()
 {
 	// load shader files
-	VkShaderModule triangleFragShader;
-	if (!vkutil::load_shader_module("resources/shaders/colored_triangle.frag.spv", vk_device, &triangleFragShader))
+	// The shader library owns the modules, and replaces them when the files change
+	VkShaderModule triangleFragShader = shader_library.load("resources/shaders/colored_triangle.frag.spv");
+	if (triangleFragShader == VK_NULL_HANDLE)
 	{
 		panic_and_exit("Failed to load fragment shader!");
 	}
 
-	VkShaderModule triangleVertexShader;
-	if (!vkutil::load_shader_module("resources/shaders/colored_triangle.vert.spv", vk_device, &triangleVertexShader))
+	VkShaderModule triangleVertexShader = shader_library.load("resources/shaders/colored_triangle.vert.spv");
+	if (triangleVertexShader == VK_NULL_HANDLE)
 	{
 		panic_and_exit("Failed to load vertex shader!");
 	}
 
-	// Build the pipeline layout that controls the inputs/outputs of the shader
-	VkPipelineLayoutCreateInfo pipeline_layout_info = vkinit::pipeline_layout_create_info();
-	vk_check(vkCreatePipelineLayout(vk_device, &pipeline_layout_info, nullptr, &_trianglePipelineLayout));
+	VkShaderModule fallbackFragShader = shader_library.load("resources/shaders/fallback.frag.spv");
+	if (fallbackFragShader == VK_NULL_HANDLE)
+	{
+		panic_and_exit("Failed to load fallback fragment shader!");
+	}
 
-	PipelineBuilder pipelineBuilder;
+	// The pipeline layouts that control the inputs/outputs of the shaders are built from what the shaders declare.
+	// Set 0 and the push constants are always the bindless heap's, so the heap stays bound across pipelines.
+	// Both pipelines declare the same interface, so they end up sharing one layout.
+	std::vector<LayoutCache::FixedSet> bindlessSet = { { BindlessHeap::SET, bindless_heap.set_layout() } };
+	VkPushConstantRange bindlessPushConstants = bindless_heap.push_constant_range();
+
+	std::string layoutError;
+	VkPipelineLayout triangleLayout = layout_cache.reflect_pipeline_layout(
+		{ shader_library.reflection(triangleVertexShader), shader_library.reflection(triangleFragShader) }, layoutError, bindlessSet, &bindlessPushConstants);
+	if (triangleLayout == VK_NULL_HANDLE) {
+		panic_and_exit("Triangle shaders do not fit together: %s", layoutError.c_str());
+	}
 
-	pipelineBuilder._pipelineLayout = _trianglePipelineLayout;
-	pipelineBuilder.set_shaders(triangleVertexShader, triangleFragShader);
+	VkPipelineLayout fallbackLayout = layout_cache.reflect_pipeline_layout(
+		{ shader_library.reflection(triangleVertexShader), shader_library.reflection(fallbackFragShader) }, layoutError, bindlessSet, &bindlessPushConstants);
+	if (fallbackLayout == VK_NULL_HANDLE) {
+		panic_and_exit("Fallback shaders do not fit together: %s", layoutError.c_str());
+	}
+
+	PipelineBuilder pipelineBuilder;
 
 	// Draw filled triangles
 	pipelineBuilder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
@@ -610,15 +1591,25 @@ void init_triangle_pipeline()
 	pipelineBuilder.set_color_attachment_format(_drawImage.imageFormat);
 	pipelineBuilder.set_depth_format(VK_FORMAT_UNDEFINED);
 
-	// finally build the pipeline
-	_trianglePipeline = pipelineBuilder.build_pipeline(vk_device);
+	// The fallback has a trivial fragment shader, so it is quick to build and is built right away.
+	// It has to exist before the first frame, as it is drawn until the real pipeline is ready.
+	pipelineBuilder.set_shaders(triangleVertexShader, fallbackFragShader);
+	pipelineBuilder._pipelineLayout = fallbackLayout;
+	PipelineHandle fallbackPipeline = pipeline_registry.request_pipeline("triangle fallback", pipelineBuilder);
+	pipeline_registry.wait(fallbackPipeline);
+	if (fallbackPipeline.get() == VK_NULL_HANDLE) {
+		panic_and_exit("Failed to build fallback pipeline!");
+	}
 
-	// clean structure
-	vkDestroyShaderModule(vk_device, triangleFragShader, nullptr);
-	vkDestroyShaderModule(vk_device, triangleVertexShader, nullptr);
+	// finally request the pipeline, which is compiled on a worker thread
+	pipelineBuilder.set_shaders(triangleVertexShader, triangleFragShader);
+	pipelineBuilder._pipelineLayout = triangleLayout;
+	_trianglePipeline = pipeline_registry.request_pipeline("triangle", pipelineBuilder, fallbackPipeline);
+	if (config.headless) {
+		// Headless captures have to show the real pipeline from the first frame, not the fallback for as long as compiling takes
+		pipeline_registry.wait(_trianglePipeline);
+	}
 
-	_mainDeletionQueue.push_function([&]() {
-		vkDestroyPipelineLayout(vk_device, _trianglePipelineLayout, nullptr);
-		vkDestroyPipeline(vk_device, _trianglePipeline, nullptr);
-	});
+	// The pipelines are owned by the registry, the shader modules by the shader library and the layouts by the layout cache.
+	// The layouts are part of the registry's key for the pipelines, and live until shutdown.
 }
\ No newline at end of file
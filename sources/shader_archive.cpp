@@ -0,0 +1,223 @@
+#include <shader_archive.h>
+#include <hash.h>
+#include <align.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+	bool valid_entry(const ShaderArchiveEntry& entry, const ShaderArchiveHeader& header)
+	{
+		return entry.nameOffset < header.namesSize &&
+			entry.entryPointOffset < header.namesSize &&
+			entry.codeOffset % SHADER_ARCHIVE_ALIGNMENT == 0 &&
+			entry.codeSize % sizeof(uint32_t) == 0 &&
+			entry.codeSize >= sizeof(uint32_t) * 5 &&
+			(uint64_t)entry.codeOffset + entry.codeSize <= header.fileSize &&
+			(uint64_t)entry.firstBinding + entry.bindingCount <= header.bindingCount;
+	}
+}
+
+bool ShaderArchive::open(const char* filePath, std::string& error)
+{
+	close();
+
+	if (!_file.open(filePath)) {
+		error = "could not open the file";
+		return false;
+	}
+
+	const ShaderArchiveHeader* header = (const ShaderArchiveHeader*)_file.data();
+	if (_file.size() < sizeof(ShaderArchiveHeader) || header->magic != SHADER_ARCHIVE_MAGIC || header->version != SHADER_ARCHIVE_VERSION) {
+		error = "unknown format";
+		close();
+		return false;
+	}
+
+	uint64_t indexEnd = sizeof(ShaderArchiveHeader) +
+		(uint64_t)header->shaderCount * sizeof(ShaderArchiveEntry) +
+		(uint64_t)header->bindingCount * sizeof(ShaderArchiveBinding);
+
+	if (header->fileSize != _file.size() ||
+		indexEnd > header->namesOffset ||
+		(uint64_t)header->namesOffset + header->namesSize > header->fileSize) {
+		error = "truncated or inconsistent index";
+		close();
+		return false;
+	}
+
+	const uint8_t* base = (const uint8_t*)_file.data();
+	const ShaderArchiveEntry* entries = (const ShaderArchiveEntry*)(base + sizeof(ShaderArchiveHeader));
+	const char* names = (const char*)(base + header->namesOffset);
+
+	// With the last name terminated, every name offset inside the table points to a terminated string
+	if (header->shaderCount > 0 && (header->namesSize == 0 || names[header->namesSize - 1] != '\0')) {
+		error = "unterminated name table";
+		close();
+		return false;
+	}
+
+	for (uint32_t i = 0; i < header->shaderCount; i++) {
+		if (!valid_entry(entries[i], *header)) {
+			error = "shader " + std::to_string(i) + " lies outside of the file";
+			close();
+			return false;
+		}
+
+		// Lookups are a binary search, which needs the names in order
+		if (i > 0 && std::strcmp(names + entries[i - 1].nameOffset, names + entries[i].nameOffset) >= 0) {
+			error = "index is not sorted";
+			close();
+			return false;
+		}
+	}
+
+	_header = header;
+	_entries = entries;
+	_bindings = (const ShaderArchiveBinding*)(entries + header->shaderCount);
+	_names = names;
+
+	return true;
+}
+
+void ShaderArchive::close()
+{
+	_file.close();
+	_header = nullptr;
+	_entries = nullptr;
+	_bindings = nullptr;
+	_names = nullptr;
+}
+
+bool ShaderArchive::find(std::string_view name, ArchivedShader& shader) const
+{
+	if (_header == nullptr) {
+		return false;
+	}
+
+	const ShaderArchiveEntry* end = _entries + _header->shaderCount;
+	const ShaderArchiveEntry* entry = std::lower_bound(_entries, end, name, [this](const ShaderArchiveEntry& entry, std::string_view name) {
+		return std::string_view(_names + entry.nameOffset) < name;
+	});
+
+	if (entry == end || std::string_view(_names + entry->nameOffset) != name) {
+		return false;
+	}
+
+	const uint8_t* base = (const uint8_t*)_file.data();
+	shader.code = (const uint32_t*)(base + entry->codeOffset);
+	shader.codeSize = entry->codeSize;
+	shader.contentHash = entry->contentHash;
+
+	ShaderReflection& reflection = shader.reflection;
+	reflection.stage = (VkShaderStageFlagBits)entry->stage;
+	reflection.entryPoint = _names + entry->entryPointOffset;
+	reflection.pushConstantSize = entry->pushConstantSize;
+	std::memcpy(reflection.localSize, entry->localSize, sizeof(reflection.localSize));
+
+	reflection.bindings.clear();
+	for (uint32_t i = 0; i < entry->bindingCount; i++) {
+		const ShaderArchiveBinding& archived = _bindings[entry->firstBinding + i];
+		reflection.bindings.push_back({ archived.set, archived.binding, (VkDescriptorType)archived.descriptorType, archived.count });
+	}
+
+	return true;
+}
+
+bool vkutil::write_shader_archive(const char* filePath, std::vector<ShaderArchiveInput> shaders, std::string& error)
+{
+	std::sort(shaders.begin(), shaders.end(), [](const ShaderArchiveInput& a, const ShaderArchiveInput& b) {
+		return a.name < b.name;
+	});
+
+	for (size_t i = 1; i < shaders.size(); i++) {
+		if (shaders[i - 1].name == shaders[i].name) {
+			error = "more than one shader named " + shaders[i].name;
+			return false;
+		}
+	}
+
+	ShaderArchiveHeader header{};
+	header.magic = SHADER_ARCHIVE_MAGIC;
+	header.version = SHADER_ARCHIVE_VERSION;
+	header.shaderCount = (uint32_t)shaders.size();
+
+	std::vector<ShaderArchiveEntry> entries(shaders.size());
+	std::vector<ShaderArchiveBinding> bindings;
+	std::string names;
+
+	for (size_t i = 0; i < shaders.size(); i++) {
+		const ShaderArchiveInput& shader = shaders[i];
+		ShaderArchiveEntry& entry = entries[i];
+
+		entry.nameOffset = (uint32_t)names.size();
+		names.append(shader.name);
+		names.push_back('\0');
+
+		entry.entryPointOffset = (uint32_t)names.size();
+		names.append(shader.reflection.entryPoint);
+		names.push_back('\0');
+
+		entry.contentHash = vkutil::hash_bytes(shader.code.data(), shader.code.size() * sizeof(uint32_t));
+		entry.codeSize = (uint32_t)(shader.code.size() * sizeof(uint32_t));
+
+		entry.stage = shader.reflection.stage;
+		entry.pushConstantSize = shader.reflection.pushConstantSize;
+		std::memcpy(entry.localSize, shader.reflection.localSize, sizeof(entry.localSize));
+
+		entry.firstBinding = (uint32_t)bindings.size();
+		entry.bindingCount = (uint32_t)shader.reflection.bindings.size();
+		for (const ReflectedBinding& binding : shader.reflection.bindings) {
+			bindings.push_back({ binding.set, binding.binding, (uint32_t)binding.type, binding.count });
+		}
+	}
+
+	header.bindingCount = (uint32_t)bindings.size();
+	header.namesOffset = (uint32_t)(sizeof(ShaderArchiveHeader) + entries.size() * sizeof(ShaderArchiveEntry) + bindings.size() * sizeof(ShaderArchiveBinding));
+	header.namesSize = (uint32_t)names.size();
+
+	// Code goes after the names, every shader starting on an aligned offset
+	uint32_t codeOffset = vkutil::align_up(header.namesOffset + header.namesSize, SHADER_ARCHIVE_ALIGNMENT);
+	for (ShaderArchiveEntry& entry : entries) {
+		entry.codeOffset = codeOffset;
+		codeOffset = vkutil::align_up(codeOffset + entry.codeSize, SHADER_ARCHIVE_ALIGNMENT);
+	}
+	header.fileSize = entries.empty() ? header.namesOffset + header.namesSize : entries.back().codeOffset + entries.back().codeSize;
+
+	// Written to a temporary file first, and only moved into place once complete
+	std::string tempPath = std::string(filePath) + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			error = "could not create " + tempPath;
+			return false;
+		}
+
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)entries.data(), entries.size() * sizeof(ShaderArchiveEntry));
+		file.write((const char*)bindings.data(), bindings.size() * sizeof(ShaderArchiveBinding));
+		file.write(names.data(), names.size());
+
+		const char padding[SHADER_ARCHIVE_ALIGNMENT] = {};
+		for (size_t i = 0; i < shaders.size(); i++) {
+			file.write(padding, entries[i].codeOffset - (uint32_t)file.tellp());
+			file.write((const char*)shaders[i].code.data(), entries[i].codeSize);
+		}
+
+		if (!file.good()) {
+			error = "failed to write " + tempPath;
+			return false;
+		}
+	}
+
+	std::error_code renameError;
+	std::filesystem::rename(tempPath, filePath, renameError);
+	if (renameError) {
+		error = "failed to replace " + std::string(filePath) + ": " + renameError.message();
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,316 @@
+#include <shader_library.h>
+#include <mapped_file.h>
+#include <hash.h>
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_timer.h>
+
+#include <cstdlib>
+#include <unordered_set>
+
+namespace {
+	// Files are checked this often at most, as checking is a couple of file system calls per shader
+	constexpr uint64_t POLL_INTERVAL_NS = 250000000;
+
+	constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+	std::filesystem::file_time_type modified_time(const std::string& path)
+	{
+		std::error_code error;
+		std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+		return error ? std::filesystem::file_time_type::min() : time;
+	}
+}
+
+void ShaderLibrary::init(VkDevice device, PipelineRegistry* registry, JobSystem* jobs, bool moduleIdentifiers)
+{
+	_device = device;
+	_registry = registry;
+	_jobs = jobs;
+
+	if (moduleIdentifiers) {
+		_getShaderModuleIdentifier = (PFN_vkGetShaderModuleIdentifierEXT)vkGetDeviceProcAddr(_device, "vkGetShaderModuleIdentifierEXT");
+	}
+}
+
+void ShaderLibrary::destroy()
+{
+	// Shaders with the same contents can share a module, which is only destroyed once
+	std::unordered_set<VkShaderModule> modules;
+	for (auto& [path, shader] : _shaders) {
+		modules.insert(shader->module);
+	}
+	for (VkShaderModule module : modules) {
+		vkDestroyShaderModule(_device, module, nullptr);
+	}
+
+	_shaders.clear();
+	_sharedModules.clear();
+	_archive.close();
+}
+
+bool ShaderLibrary::open_archive(const char* archivePath)
+{
+	std::string error;
+	if (!_archive.open(archivePath, error)) {
+		SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Shader archive %s not used (%s), loading shaders from their own files", archivePath, error.c_str());
+		return false;
+	}
+
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Opened shader archive %s with %u shaders", archivePath, _archive.shader_count());
+	return true;
+}
+
+void ShaderLibrary::enable_hot_reload(const std::string& compilerPath)
+{
+	_hotReload = true;
+	_compilerPath = compilerPath;
+	_lastPollTicks = SDL_GetTicksNS();
+
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Shader hot reload enabled%s",
+		_compilerPath.empty() ? ", watching SPIR-V files only" : "");
+}
+
+VkShaderModule ShaderLibrary::load(const char* spirvPath)
+{
+	auto it = _shaders.find(spirvPath);
+	if (it != _shaders.end()) {
+		return it->second->module;
+	}
+
+	// Record the times before reading, so a file changed while it is read is picked up on the next poll
+	std::unique_ptr<Shader> shader = std::make_unique<Shader>();
+	shader->spirvPath = spirvPath;
+	shader->spirvTime = modified_time(shader->spirvPath);
+
+	std::filesystem::path sourcePath = std::filesystem::path(spirvPath).replace_extension();
+	if (sourcePath.has_extension() && std::filesystem::exists(sourcePath)) {
+		shader->sourcePath = sourcePath.string();
+		shader->sourceTime = modified_time(shader->sourcePath);
+	}
+
+	// Shaders in the archive are named after their SPIR-V file, minus the .spv extension
+	ArchivedShader archived;
+	if (_archive.find(std::filesystem::path(spirvPath).stem().string(), archived)) {
+		shader->module = create_module_from_code(archived.code, archived.codeSize, archived.contentHash, shader->spirvPath);
+		shader->contentHash = archived.contentHash;
+		shader->reflection = std::move(archived.reflection);
+	}
+	else {
+		shader->module = create_module(shader->spirvPath, 0, shader->contentHash, shader->reflection);
+	}
+
+	if (shader->module == VK_NULL_HANDLE) {
+		return VK_NULL_HANDLE;
+	}
+
+	query_identifier(*shader);
+
+	VkShaderModule module = shader->module;
+	_shaders.emplace(spirvPath, std::move(shader));
+
+	return module;
+}
+
+void ShaderLibrary::poll(DeletionQueue& retireQueue)
+{
+	if (!_hotReload || SDL_GetTicksNS() - _lastPollTicks < POLL_INTERVAL_NS) {
+		return;
+	}
+	_lastPollTicks = SDL_GetTicksNS();
+
+	for (auto& [path, shader] : _shaders) {
+		// Recompile changed sources. The new SPIR-V is picked up by a later poll, like any other SPIR-V change.
+		if (!shader->sourcePath.empty() && !_compilerPath.empty() && shader->compiling.done()) {
+			std::filesystem::file_time_type sourceTime = modified_time(shader->sourcePath);
+
+			if (sourceTime != shader->sourceTime) {
+				shader->sourceTime = sourceTime;
+
+				// Compiling takes a while, so it runs in the background when there are worker threads to run it
+				const Shader* compiled = shader.get();
+				if (_jobs->worker_count() > 1) {
+					_jobs->submit_background([this, compiled](uint32_t) { compile_source(*compiled); }, &shader->compiling);
+				}
+				else {
+					compile_source(*compiled);
+				}
+			}
+		}
+
+		std::filesystem::file_time_type spirvTime = modified_time(shader->spirvPath);
+		if (spirvTime == shader->spirvTime) {
+			continue;
+		}
+
+		// The file might still be in the middle of being written. Invalid SPIR-V is retried on the next poll.
+		uint64_t contentHash = 0;
+		ShaderReflection reflection;
+		VkShaderModule module = create_module(shader->spirvPath, shader->contentHash, contentHash, reflection);
+
+		if (module == VK_NULL_HANDLE) {
+			// Rewritten with the same contents, like a rebuild that produced identical SPIR-V. There is nothing to reload.
+			if (contentHash == shader->contentHash) {
+				shader->spirvTime = spirvTime;
+			}
+			continue;
+		}
+		shader->spirvTime = spirvTime;
+
+		// Compute pipelines are built directly instead of through the registry, so there is nothing that could be rebuilt
+		if (shader->reflection.stage == VK_SHADER_STAGE_COMPUTE_BIT) {
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Compute shader %s changed, compute shaders are not reloaded without a restart", shader->spirvPath.c_str());
+			vkDestroyShaderModule(_device, module, nullptr);
+			continue;
+		}
+
+		// Pipelines keep their layout when they are rebuilt, so a shader that changed its bindings or push constants
+		// can not be swapped in. Restarting picks it up with a new layout.
+		if (!vkutil::same_interface(shader->reflection, reflection)) {
+			SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Shader %s changed its descriptor bindings or push constants, it can not be reloaded without a restart", shader->spirvPath.c_str());
+			vkDestroyShaderModule(_device, module, nullptr);
+			continue;
+		}
+
+		VkShaderModule oldModule = shader->module;
+		shader->module = module;
+		shader->contentHash = contentHash;
+		shader->reflection = std::move(reflection);
+		query_identifier(*shader);
+
+		uint32_t rebuilt = _registry->rebuild_with_shader(oldModule, module);
+		SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Reloaded shader %s, rebuilding %u pipelines", shader->spirvPath.c_str(), rebuilt);
+
+		// Nothing is built from the old module anymore, but it is retired like everything else that was replaced
+		VkDevice device = _device;
+		retireQueue.push_function([=]() {
+			vkDestroyShaderModule(device, oldModule, nullptr);
+		});
+	}
+}
+
+bool ShaderLibrary::module_identifier(VkShaderModule module, std::vector<uint8_t>& identifier) const
+{
+	for (const auto& [path, shader] : _shaders) {
+		if (shader->module == module && !shader->identifier.empty()) {
+			identifier = shader->identifier;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const ShaderReflection* ShaderLibrary::reflection(VkShaderModule module) const
+{
+	for (const auto& [path, shader] : _shaders) {
+		if (shader->module == module) {
+			return &shader->reflection;
+		}
+	}
+
+	return nullptr;
+}
+
+VkShaderModule ShaderLibrary::create_module(const std::string& spirvPath, uint64_t knownHash, uint64_t& contentHash, ShaderReflection& reflection)
+{
+	contentHash = 0;
+
+	MappedFile file;
+	if (!file.open(spirvPath.c_str())) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to open shader %s", spirvPath.c_str());
+		return VK_NULL_HANDLE;
+	}
+
+	// SPIR-V is a stream of 32 bit words starting with a magic number, anything else can not be a complete module
+	const uint32_t* code = (const uint32_t*)file.data();
+	if (file.size() < sizeof(uint32_t) * 5 || file.size() % sizeof(uint32_t) != 0 || code[0] != SPIRV_MAGIC) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Shader %s is not valid SPIR-V", spirvPath.c_str());
+		return VK_NULL_HANDLE;
+	}
+
+	contentHash = vkutil::hash_bytes(file.data(), file.size());
+	if (knownHash != 0 && contentHash == knownHash) {
+		return VK_NULL_HANDLE;
+	}
+
+	std::string error;
+	if (!vkutil::reflect_spirv(code, file.size() / sizeof(uint32_t), reflection, error)) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Shader %s is not valid SPIR-V: %s", spirvPath.c_str(), error.c_str());
+		return VK_NULL_HANDLE;
+	}
+
+	// The driver reads the code straight from the mapped file
+	return create_module_from_code(code, file.size(), contentHash, spirvPath);
+}
+
+VkShaderModule ShaderLibrary::create_module_from_code(const uint32_t* code, size_t codeSize, uint64_t contentHash, const std::string& spirvPath)
+{
+	// Hot reload replaces the module of a single file, so modules are only shared when it is disabled
+	if (!_hotReload) {
+		auto it = _sharedModules.find(contentHash);
+		if (it != _sharedModules.end()) {
+			return it->second;
+		}
+	}
+
+	VkShaderModuleCreateInfo shaderCreateInfo = {};
+	shaderCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderCreateInfo.pNext = nullptr;
+	shaderCreateInfo.codeSize = codeSize;
+	shaderCreateInfo.pCode = code;
+
+	VkShaderModule module;
+	if (vkCreateShaderModule(_device, &shaderCreateInfo, nullptr, &module) != VK_SUCCESS) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to create shader module from %s", spirvPath.c_str());
+		return VK_NULL_HANDLE;
+	}
+
+	if (!_hotReload) {
+		_sharedModules.emplace(contentHash, module);
+	}
+
+	return module;
+}
+
+void ShaderLibrary::query_identifier(Shader& shader)
+{
+	shader.identifier.clear();
+
+	if (_getShaderModuleIdentifier == nullptr) {
+		return;
+	}
+
+	VkShaderModuleIdentifierEXT identifier{};
+	identifier.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_IDENTIFIER_EXT;
+	identifier.pNext = nullptr;
+
+	_getShaderModuleIdentifier(_device, shader.module, &identifier);
+
+	shader.identifier.assign(identifier.identifier, identifier.identifier + identifier.identifierSize);
+}
+
+void ShaderLibrary::compile_source(const Shader& shader)
+{
+	// Compile to a temporary file and move it into place once it is complete,
+	// so the watcher never sees a half written SPIR-V file
+	std::string tempPath = shader.spirvPath + ".tmp";
+	std::string command = "\"" + _compilerPath + "\" -V \"" + shader.sourcePath + "\" -o \"" + tempPath + "\"";
+#ifdef _WIN32
+	// cmd.exe strips the first and last quote of the command line, so the whole command needs another pair around it
+	command = "\"" + command + "\"";
+#endif
+
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Compiling %s", shader.sourcePath.c_str());
+
+	if (std::system(command.c_str()) != 0) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to compile %s, keeping the previous version", shader.sourcePath.c_str());
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, shader.spirvPath, error);
+	if (error) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to replace %s: %s", shader.spirvPath.c_str(), error.message().c_str());
+	}
+}
\ No newline at end of file
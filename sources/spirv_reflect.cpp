@@ -0,0 +1,411 @@
+#include <spirv_reflect.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+	constexpr uint32_t SPIRV_HEADER_WORDS = 5;
+
+	// The parts of the SPIR-V specification needed to find bindings and push constants.
+	// See https://registry.khronos.org/SPIR-V/specs/unified1/SPIRV.html for the full lists.
+	enum Op : uint32_t {
+		OpEntryPoint = 15,
+		OpExecutionMode = 16,
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeImage = 25,
+		OpTypeSampler = 26,
+		OpTypeSampledImage = 27,
+		OpTypeArray = 28,
+		OpTypeRuntimeArray = 29,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72,
+		OpTypeAccelerationStructureKHR = 5341
+	};
+
+	enum Decoration : uint32_t {
+		DecorationBufferBlock = 3,
+		DecorationArrayStride = 6,
+		DecorationMatrixStride = 7,
+		DecorationBinding = 33,
+		DecorationDescriptorSet = 34,
+		DecorationOffset = 35
+	};
+
+	enum StorageClass : uint32_t {
+		StorageClassUniformConstant = 0,
+		StorageClassUniform = 2,
+		StorageClassPushConstant = 9,
+		StorageClassStorageBuffer = 12
+	};
+
+	constexpr uint32_t EXECUTION_MODE_LOCAL_SIZE = 17;
+	constexpr uint32_t DIM_BUFFER = 5;
+	constexpr uint32_t DIM_SUBPASS_DATA = 6;
+
+	// Everything known about one SPIR-V id
+	struct Id {
+		// The instruction that defined the id, nullptr if it was not defined by an instruction reflection cares about
+		const uint32_t* instruction = nullptr;
+		uint32_t opcode = 0;
+
+		uint32_t set = UINT32_MAX;
+		uint32_t binding = UINT32_MAX;
+		bool bufferBlock = false;
+		uint32_t arrayStride = 0;
+
+		// Struct members
+		std::vector<uint32_t> memberOffsets;
+		std::vector<uint32_t> memberMatrixStrides;
+	};
+
+	bool stage_from_execution_model(uint32_t model, VkShaderStageFlagBits& stage)
+	{
+		switch (model) {
+		case 0: stage = VK_SHADER_STAGE_VERTEX_BIT; return true;
+		case 1: stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT; return true;
+		case 2: stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT; return true;
+		case 3: stage = VK_SHADER_STAGE_GEOMETRY_BIT; return true;
+		case 4: stage = VK_SHADER_STAGE_FRAGMENT_BIT; return true;
+		case 5: stage = VK_SHADER_STAGE_COMPUTE_BIT; return true;
+		default: return false;
+		}
+	}
+
+	// The number of words a type instruction needs at least, for reflection to read all of its operands
+	uint32_t type_instruction_length(uint32_t opcode)
+	{
+		switch (opcode) {
+		case OpTypeSampler:
+		case OpTypeStruct:
+		case OpTypeAccelerationStructureKHR:
+			return 2;
+		case OpTypeInt:
+		case OpTypeFloat:
+		case OpTypeSampledImage:
+		case OpTypeRuntimeArray:
+			return 3;
+		case OpTypeImage:
+			return 9;
+		default:
+			return 4;
+		}
+	}
+
+	void resize_members(Id& id, uint32_t member)
+	{
+		if (id.memberOffsets.size() <= member) {
+			id.memberOffsets.resize(member + 1, 0);
+			id.memberMatrixStrides.resize(member + 1, 0);
+		}
+	}
+
+	const Id* find_id(const std::vector<Id>& ids, uint32_t id)
+	{
+		return id < ids.size() && ids[id].instruction != nullptr ? &ids[id] : nullptr;
+	}
+
+	uint32_t constant_value(const std::vector<Id>& ids, uint32_t id)
+	{
+		const Id* constant = find_id(ids, id);
+		return constant != nullptr && constant->opcode == OpConstant ? constant->instruction[3] : 0;
+	}
+
+	// Size in bytes of a type, following the offsets and strides the compiler decorated it with.
+	// matrixStride is the stride of a matrix struct member, 0 if the type is not one.
+	uint32_t type_size(const std::vector<Id>& ids, uint32_t typeId, uint32_t matrixStride, uint32_t depth)
+	{
+		const Id* type = find_id(ids, typeId);
+		// Types can not nest this deep in valid SPIR-V, so this only guards against broken files
+		if (type == nullptr || depth > 32) {
+			return 0;
+		}
+
+		const uint32_t* instruction = type->instruction;
+		switch (type->opcode) {
+		case OpTypeInt:
+		case OpTypeFloat:
+			return instruction[2] / 8;
+		case OpTypeVector:
+			return instruction[3] * type_size(ids, instruction[2], 0, depth + 1);
+		case OpTypeMatrix: {
+			uint32_t stride = matrixStride != 0 ? matrixStride : type_size(ids, instruction[2], 0, depth + 1);
+			return instruction[3] * stride;
+		}
+		case OpTypeArray: {
+			uint32_t stride = type->arrayStride != 0 ? type->arrayStride : type_size(ids, instruction[2], 0, depth + 1);
+			return constant_value(ids, instruction[3]) * stride;
+		}
+		case OpTypeStruct: {
+			uint32_t size = 0;
+			uint32_t memberCount = (instruction[0] >> 16) - 2;
+
+			for (uint32_t member = 0; member < memberCount; member++) {
+				uint32_t offset = member < type->memberOffsets.size() ? type->memberOffsets[member] : 0;
+				uint32_t stride = member < type->memberMatrixStrides.size() ? type->memberMatrixStrides[member] : 0;
+				size = std::max(size, offset + type_size(ids, instruction[2 + member], stride, depth + 1));
+			}
+
+			return size;
+		}
+		case OpTypePointer:
+			// Buffer device addresses
+			return 8;
+		default:
+			// Runtime arrays have no size of their own
+			return 0;
+		}
+	}
+
+	// Works out the descriptor type of a variable in a descriptor set, from the type it points to
+	bool descriptor_type(const std::vector<Id>& ids, uint32_t typeId, uint32_t storageClass, VkDescriptorType& descriptorType, uint32_t& count)
+	{
+		const Id* type = find_id(ids, typeId);
+		if (type == nullptr) {
+			return false;
+		}
+
+		count = 1;
+		if (type->opcode == OpTypeArray) {
+			count = constant_value(ids, type->instruction[3]);
+			type = find_id(ids, type->instruction[2]);
+		}
+		else if (type->opcode == OpTypeRuntimeArray) {
+			count = 0;
+			type = find_id(ids, type->instruction[2]);
+		}
+
+		if (type == nullptr) {
+			return false;
+		}
+
+		switch (type->opcode) {
+		case OpTypeSampler:
+			descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+			return true;
+		case OpTypeSampledImage:
+			descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			return true;
+		case OpTypeImage: {
+			uint32_t dim = type->instruction[3];
+			// 1 means the image is used with a sampler, 2 means it is used as a storage image
+			uint32_t sampled = type->instruction[7];
+
+			if (dim == DIM_BUFFER) {
+				descriptorType = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			}
+			else if (dim == DIM_SUBPASS_DATA) {
+				descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			}
+			else {
+				descriptorType = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			}
+			return true;
+		}
+		case OpTypeStruct:
+			// Older GLSL compilers mark storage buffers as Uniform blocks with the BufferBlock decoration
+			if (storageClass == StorageClassStorageBuffer || type->bufferBlock) {
+				descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			}
+			else {
+				descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			}
+			return true;
+		case OpTypeAccelerationStructureKHR:
+			descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+			return true;
+		default:
+			return false;
+		}
+	}
+}
+
+bool vkutil::reflect_spirv(const uint32_t* code, size_t wordCount, ShaderReflection& reflection, std::string& error)
+{
+	reflection = ShaderReflection{};
+
+	if (wordCount < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC) {
+		error = "missing SPIR-V header";
+		return false;
+	}
+
+	// Every id in the module is smaller than the bound in the header
+	uint32_t bound = code[3];
+	if (bound > wordCount) {
+		error = "id bound larger than the module";
+		return false;
+	}
+
+	std::vector<Id> ids(bound);
+	std::vector<uint32_t> variables;
+	uint32_t entryPointId = UINT32_MAX;
+
+	// First pass over the instructions, collecting types, decorations and variables
+	size_t position = SPIRV_HEADER_WORDS;
+	while (position < wordCount) {
+		const uint32_t* instruction = code + position;
+		uint32_t opcode = instruction[0] & 0xFFFF;
+		uint32_t length = instruction[0] >> 16;
+
+		if (length == 0 || position + length > wordCount) {
+			error = "truncated instruction";
+			return false;
+		}
+		position += length;
+
+		switch (opcode) {
+		case OpEntryPoint:
+			if (length >= 4 && entryPointId == UINT32_MAX) {
+				if (!stage_from_execution_model(instruction[1], reflection.stage)) {
+					error = "unsupported execution model";
+					return false;
+				}
+				entryPointId = instruction[2];
+
+				// The name is a null terminated string packed into the following words
+				const char* name = (const char*)(instruction + 3);
+				reflection.entryPoint.assign(name, strnlen(name, (length - 3) * sizeof(uint32_t)));
+			}
+			break;
+		case OpExecutionMode:
+			if (length >= 6 && instruction[1] == entryPointId && instruction[2] == EXECUTION_MODE_LOCAL_SIZE) {
+				reflection.localSize[0] = instruction[3];
+				reflection.localSize[1] = instruction[4];
+				reflection.localSize[2] = instruction[5];
+			}
+			break;
+		case OpDecorate:
+			if (length >= 3 && instruction[1] < bound) {
+				Id& target = ids[instruction[1]];
+				uint32_t literal = length >= 4 ? instruction[3] : 0;
+
+				switch (instruction[2]) {
+				case DecorationDescriptorSet: target.set = literal; break;
+				case DecorationBinding: target.binding = literal; break;
+				case DecorationBufferBlock: target.bufferBlock = true; break;
+				case DecorationArrayStride: target.arrayStride = literal; break;
+				default: break;
+				}
+			}
+			break;
+		case OpMemberDecorate:
+			if (length >= 5 && instruction[1] < bound) {
+				Id& target = ids[instruction[1]];
+				uint32_t member = instruction[2];
+
+				if (instruction[3] == DecorationOffset) {
+					resize_members(target, member);
+					target.memberOffsets[member] = instruction[4];
+				}
+				else if (instruction[3] == DecorationMatrixStride) {
+					resize_members(target, member);
+					target.memberMatrixStrides[member] = instruction[4];
+				}
+			}
+			break;
+		case OpTypeInt:
+		case OpTypeFloat:
+		case OpTypeVector:
+		case OpTypeMatrix:
+		case OpTypeImage:
+		case OpTypeSampler:
+		case OpTypeSampledImage:
+		case OpTypeArray:
+		case OpTypeRuntimeArray:
+		case OpTypeStruct:
+		case OpTypePointer:
+		case OpTypeAccelerationStructureKHR: {
+			// Types have their result id first
+			if (length >= type_instruction_length(opcode) && instruction[1] < bound) {
+				ids[instruction[1]].instruction = instruction;
+				ids[instruction[1]].opcode = opcode;
+			}
+			break;
+		}
+		case OpConstant:
+			if (length >= 4 && instruction[2] < bound) {
+				ids[instruction[2]].instruction = instruction;
+				ids[instruction[2]].opcode = opcode;
+			}
+			break;
+		case OpVariable:
+			if (length >= 4 && instruction[2] < bound) {
+				ids[instruction[2]].instruction = instruction;
+				ids[instruction[2]].opcode = opcode;
+				variables.push_back(instruction[2]);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (entryPointId == UINT32_MAX) {
+		error = "no entry point";
+		return false;
+	}
+
+	// Second pass over the variables, now that every type and decoration is known
+	for (uint32_t variableId : variables) {
+		const Id& variable = ids[variableId];
+		uint32_t storageClass = variable.instruction[3];
+
+		const Id* pointer = find_id(ids, variable.instruction[1]);
+		if (pointer == nullptr || pointer->opcode != OpTypePointer) {
+			continue;
+		}
+		uint32_t typeId = pointer->instruction[3];
+
+		if (storageClass == StorageClassPushConstant) {
+			reflection.pushConstantSize = std::max(reflection.pushConstantSize, type_size(ids, typeId, 0, 0));
+			continue;
+		}
+
+		bool descriptor = storageClass == StorageClassUniformConstant || storageClass == StorageClassUniform || storageClass == StorageClassStorageBuffer;
+		if (!descriptor || variable.set == UINT32_MAX || variable.binding == UINT32_MAX) {
+			continue;
+		}
+
+		ReflectedBinding binding{};
+		binding.set = variable.set;
+		binding.binding = variable.binding;
+
+		if (!descriptor_type(ids, typeId, storageClass, binding.type, binding.count)) {
+			error = "unsupported descriptor type at set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding);
+			return false;
+		}
+
+		reflection.bindings.push_back(binding);
+	}
+
+	std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b) {
+		return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+	});
+
+	return true;
+}
+
+bool vkutil::same_interface(const ShaderReflection& a, const ShaderReflection& b)
+{
+	if (a.stage != b.stage || a.entryPoint != b.entryPoint || a.pushConstantSize != b.pushConstantSize || a.bindings.size() != b.bindings.size()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < a.bindings.size(); i++) {
+		const ReflectedBinding& bindingA = a.bindings[i];
+		const ReflectedBinding& bindingB = b.bindings[i];
+
+		if (bindingA.set != bindingB.set || bindingA.binding != bindingB.binding || bindingA.type != bindingB.type || bindingA.count != bindingB.count) {
+			return false;
+		}
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include <sprite_batch.h>
+#include <vk_types.h>
+#include <vk_buffers.h>
+
+#include <cstring>
+#include <string>
+
+namespace {
+	// Least significant digit first radix sort of the entries on their keys, one byte at a time.
+	// Every pass is stable, so entries with the same key keep the order they were added in.
+	// Returns the number of passes that moved entries.
+	template<typename Entry>
+	uint32_t radix_sort(std::vector<Entry>& entries, std::vector<Entry>& scratch)
+	{
+		constexpr uint32_t DIGITS = 8;
+		constexpr uint32_t BUCKETS = 256;
+
+		// Count every digit of every key in a single walk over the entries
+		uint32_t counts[DIGITS][BUCKETS] = {};
+		for (const Entry& entry : entries) {
+			for (uint32_t digit = 0; digit < DIGITS; digit++) {
+				counts[digit][(entry.key >> (digit * 8)) & 0xFF]++;
+			}
+		}
+
+		scratch.resize(entries.size());
+
+		uint32_t passes = 0;
+		for (uint32_t digit = 0; digit < DIGITS; digit++) {
+			uint32_t shift = digit * 8;
+
+			// When every key has the same byte here the pass would leave the entries where they are.
+			// Most bytes of a key are the same in every sprite of a frame, so most passes are skipped.
+			if (entries.empty() || counts[digit][(entries[0].key >> shift) & 0xFF] == entries.size()) {
+				continue;
+			}
+
+			uint32_t offsets[BUCKETS];
+			uint32_t offset = 0;
+			for (uint32_t bucket = 0; bucket < BUCKETS; bucket++) {
+				offsets[bucket] = offset;
+				offset += counts[digit][bucket];
+			}
+
+			for (const Entry& entry : entries) {
+				scratch[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+			}
+
+			entries.swap(scratch);
+			passes++;
+		}
+
+		return passes;
+	}
+}
+
+void SpriteBatch::init(VkFormat colorFormat, BindlessHeap& heap, LayoutCache& layouts, ShaderLibrary& shaders, PipelineRegistry& pipelines)
+{
+	VkShaderModule vertexShader = shaders.load("resources/shaders/sprite.vert.spv");
+	VkShaderModule fragmentShader = shaders.load("resources/shaders/sprite.frag.spv");
+	if (vertexShader == VK_NULL_HANDLE || fragmentShader == VK_NULL_HANDLE) {
+		panic_and_exit("Failed to load sprite shaders!");
+	}
+
+	std::vector<LayoutCache::FixedSet> bindlessSet = { { BindlessHeap::SET, heap.set_layout() } };
+	VkPushConstantRange bindlessPushConstants = heap.push_constant_range();
+
+	std::string layoutError;
+	_pipelineLayout = layouts.reflect_pipeline_layout(
+		{ shaders.reflection(vertexShader), shaders.reflection(fragmentShader) }, layoutError, bindlessSet, &bindlessPushConstants);
+	if (_pipelineLayout == VK_NULL_HANDLE) {
+		panic_and_exit("Sprite shaders do not fit together: %s", layoutError.c_str());
+	}
+
+	PipelineBuilder pipelineBuilder;
+	pipelineBuilder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+	pipelineBuilder.set_polygon_mode(VK_POLYGON_MODE_FILL);
+	pipelineBuilder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE);
+	pipelineBuilder.set_multisampling_none();
+	pipelineBuilder.disable_depthtest();
+	pipelineBuilder.set_color_attachment_format(colorFormat);
+	pipelineBuilder.set_depth_format(VK_FORMAT_UNDEFINED);
+	pipelineBuilder.set_shaders(vertexShader, fragmentShader);
+	pipelineBuilder._pipelineLayout = _pipelineLayout;
+
+	// The pipelines only differ in blending, and share the layout so the push constants stay valid between them
+	pipelineBuilder.enable_blending_alphablend();
+	_pipelines[(uint32_t)SpriteBlend::Alpha] = pipelines.request_pipeline("sprites alpha", pipelineBuilder);
+
+	pipelineBuilder.enable_blending_additive();
+	_pipelines[(uint32_t)SpriteBlend::Additive] = pipelines.request_pipeline("sprites additive", pipelineBuilder);
+}
+
+void SpriteBatch::wait_for_pipelines(PipelineRegistry& pipelines) const
+{
+	for (const PipelineHandle& pipeline : _pipelines) {
+		pipelines.wait(pipeline);
+	}
+}
+
+void SpriteBatch::begin()
+{
+	_sprites.clear();
+	_draws.clear();
+	_instances = 0;
+}
+
+void SpriteBatch::add(const Sprite& sprite)
+{
+	_sprites.push_back(sprite);
+}
+
+void SpriteBatch::prepare(FrameArena& arena)
+{
+	_stats = {};
+	_stats.sprites = (uint32_t)_sprites.size();
+
+	if (_sprites.empty()) {
+		return;
+	}
+
+	_entries.resize(_sprites.size());
+	for (uint32_t i = 0; i < (uint32_t)_sprites.size(); i++) {
+		const Sprite& sprite = _sprites[i];
+		_entries[i].key = ((uint64_t)sprite.layer << LAYER_SHIFT) |
+			((uint64_t)sprite.blend << PIPELINE_SHIFT) |
+			(((uint64_t)sprite.texture & TEXTURE_MASK) << TEXTURE_SHIFT);
+		_entries[i].sprite = i;
+	}
+
+	_stats.sort_passes = radix_sort(_entries, _scratch);
+
+	FrameAllocation allocation = arena.allocate<SpriteInstance>((uint32_t)_entries.size());
+	if (!allocation) {
+		_stats.dropped = _stats.sprites;
+		return;
+	}
+
+	SpriteInstance* instances = (SpriteInstance*)allocation.data;
+	for (uint32_t i = 0; i < (uint32_t)_entries.size(); i++) {
+		const Sprite& sprite = _sprites[_entries[i].sprite];
+
+		SpriteInstance instance{};
+		instance.position[0] = sprite.x;
+		instance.position[1] = sprite.y;
+		instance.cell = sprite.cell;
+		instance.tint = sprite.tint;
+		instance.texture = sprite.texture;
+		// Written whole, as the arena is write combined memory
+		std::memcpy(&instances[i], &instance, sizeof(SpriteInstance));
+
+		// The vertex shader reads the instance at gl_InstanceIndex, which counts up from the draw's first instance,
+		// so a run of sprites with the same pipeline is a single draw
+		if (!_draws.empty() && _draws.back().blend == sprite.blend) {
+			_draws.back().instanceCount++;
+		}
+		else {
+			_draws.push_back({ sprite.blend, i, 1 });
+		}
+	}
+
+	_instances = allocation.deviceAddress;
+	_stats.draws = (uint32_t)_draws.size();
+}
+
+void SpriteBatch::draw(VkCommandBuffer cmd, const MapView& view, VkExtent2D extent, uint32_t atlasColumns) const
+{
+	if (_draws.empty()) {
+		return;
+	}
+
+	SpritePushConstants constants{};
+	constants.instances = _instances;
+	constants.origin[0] = view.origin[0];
+	constants.origin[1] = view.origin[1];
+	constants.tileSize[0] = view.tileSize;
+	constants.tileSize[1] = view.tileSize;
+	constants.viewportSize[0] = (float)extent.width;
+	constants.viewportSize[1] = (float)extent.height;
+	constants.atlasColumns = atlasColumns;
+
+	// Every pipeline has the same layout, so the push constants survive the pipeline changes between draws
+	vkutil::push_constants(cmd, _pipelineLayout, constants);
+
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	for (const Draw& draw : _draws) {
+		VkPipeline pipeline = _pipelines[(uint32_t)draw.blend].get();
+		if (pipeline == VK_NULL_HANDLE) {
+			continue;
+		}
+
+		if (pipeline != boundPipeline) {
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			boundPipeline = pipeline;
+		}
+
+		vkCmdDraw(cmd, 6, draw.instanceCount, 0, draw.firstInstance);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include <tile_lighting.h>
+#include <vk_types.h>
+#include <vk_buffers.h>
+#include <vk_initializers.h>
+#include <vk_memory_budget.h>
+
+#include <cstring>
+#include <string>
+
+void TileLighting::init(VkDevice device, const VkPhysicalDeviceLimits& limits, VmaAllocator allocator, VkPipelineCache pipelineCache, BindlessHeap& heap,
+	LayoutCache& layouts, ShaderLibrary& shaders, ImageStateTracker& imageStates, uint32_t mapWidth, uint32_t mapHeight)
+{
+	_device = device;
+	_allocator = allocator;
+	_heap = &heap;
+	_imageStates = &imageStates;
+
+	create_light_image(mapWidth, mapHeight);
+
+	// Light is filtered between tiles, so it fades smoothly from one tile to the next
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.pNext = nullptr;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = 0.0f;
+	vk_check(vkCreateSampler(_device, &samplerInfo, nullptr, &_sampler));
+
+	_lightSlot = _heap->add_texture(_lightImage.imageView, _sampler);
+
+	create_storage_set(layouts);
+
+	VkShaderModule computeShader = shaders.load("resources/shaders/tile_lighting.comp.spv");
+	if (computeShader == VK_NULL_HANDLE) {
+		panic_and_exit("Failed to load tile lighting shader!");
+	}
+
+	std::vector<LayoutCache::FixedSet> fixedSets = {
+		{ BindlessHeap::SET, _heap->set_layout() },
+		{ STORAGE_SET, _storageSetLayout }
+	};
+	VkPushConstantRange bindlessPushConstants = _heap->push_constant_range();
+
+	std::string layoutError;
+	_pipelineLayout = layouts.reflect_pipeline_layout({ shaders.reflection(computeShader) }, layoutError, fixedSets, &bindlessPushConstants);
+	if (_pipelineLayout == VK_NULL_HANDLE) {
+		panic_and_exit("Tile lighting shader does not fit its layout: %s", layoutError.c_str());
+	}
+
+	// A single small shader, so it is built right away instead of going through the pipeline registry
+	ComputePipelineBuilder pipelineBuilder;
+	pipelineBuilder.set_shader(computeShader, *shaders.reflection(computeShader));
+	pipelineBuilder.set_workgroup_size({ GROUP_SIZE, GROUP_SIZE, 1 }, limits);
+	pipelineBuilder._pipelineLayout = _pipelineLayout;
+	_workgroupSize = pipelineBuilder.workgroup_size();
+
+	_pipeline = pipelineBuilder.build_pipeline(_device, pipelineCache);
+	if (_pipeline == VK_NULL_HANDLE) {
+		panic_and_exit("Failed to build the tile lighting pipeline!");
+	}
+}
+
+void TileLighting::destroy()
+{
+	vkDestroyPipeline(_device, _pipeline, nullptr);
+
+	// Destroying the pool frees the set. The layouts belong to the layout cache.
+	vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
+
+	_heap->remove_texture(_lightSlot);
+	_imageStates->forget(_lightImage.image);
+
+	vkDestroySampler(_device, _sampler, nullptr);
+	vkDestroyImageView(_device, _lightImage.imageView, nullptr);
+	vkutil::untrack_allocation(_allocator, _lightImage.allocation);
+	vmaDestroyImage(_allocator, _lightImage.image, _lightImage.allocation);
+}
+
+void TileLighting::prepare(FrameArena& arena, const std::vector<TileLight>& lights, float time)
+{
+	_stats = {};
+	_stats.lights = (uint32_t)lights.size();
+	_lights = 0;
+	_lightCount = 0;
+	_time = time;
+
+	if (lights.empty()) {
+		return;
+	}
+
+	FrameAllocation allocation = arena.allocate<TileLight>((uint32_t)lights.size());
+	if (!allocation) {
+		// The map is still lit by the ambient light
+		_stats.dropped = _stats.lights;
+		return;
+	}
+
+	std::memcpy(allocation.data, lights.data(), lights.size() * sizeof(TileLight));
+
+	_lights = allocation.deviceAddress;
+	_lightCount = (uint32_t)lights.size();
+}
+
+void TileLighting::record(VkCommandBuffer cmd, const TileMap& map) const
+{
+	TileLightingPushConstants constants{};
+	constants.lights = _lights;
+	constants.lightCount = _lightCount;
+	constants.mapWidth = map.width();
+	constants.mapHeight = map.height();
+	constants.tileBuffer = map.buffer_slot();
+	constants.ambient = _ambient;
+	constants.time = _time;
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+	_heap->bind(cmd, VK_PIPELINE_BIND_POINT_COMPUTE);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, STORAGE_SET, 1, &_storageSet, 0, nullptr);
+	vkutil::push_constants(cmd, _pipelineLayout, constants);
+
+	// One invocation per tile
+	vkutil::dispatch(cmd, VkExtent2D{ map.width(), map.height() }, _workgroupSize);
+}
+
+void TileLighting::create_light_image(uint32_t width, uint32_t height)
+{
+	_lightImage.imageFormat = LIGHT_FORMAT;
+	_lightImage.imageExtent = { width, height, 1 };
+
+	VkImageCreateInfo imageInfo = vkinit::image_create_info(_lightImage.imageFormat,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, _lightImage.imageExtent);
+
+	VmaAllocationCreateInfo allocInfo{};
+	allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+	vk_check(vmaCreateImage(_allocator, &imageInfo, &allocInfo, &_lightImage.image, &_lightImage.allocation, nullptr));
+	vkutil::track_allocation(_allocator, _lightImage.allocation, MemoryCategory::Images);
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(_lightImage.imageFormat, _lightImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
+	vk_check(vkCreateImageView(_device, &viewInfo, nullptr, &_lightImage.imageView));
+
+	// Every texel is written by the lighting pass before anything reads it
+	_imageStates->track(_lightImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
+}
+
+void TileLighting::create_storage_set(LayoutCache& layouts)
+{
+	VkDescriptorSetLayoutBinding binding{};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	_storageSetLayout = layouts.get_descriptor_set_layout({ binding });
+
+	VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 };
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.pNext = nullptr;
+	poolInfo.flags = 0;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	vk_check(vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptorPool));
+
+	VkDescriptorSetAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.pNext = nullptr;
+	allocateInfo.descriptorPool = _descriptorPool;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &_storageSetLayout;
+
+	vk_check(vkAllocateDescriptorSets(_device, &allocateInfo, &_storageSet));
+
+	// The light image lives as long as the set, so the set is written once
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.sampler = VK_NULL_HANDLE;
+	imageInfo.imageView = _lightImage.imageView;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = _storageSet;
+	write.dstBinding = 0;
+	write.dstArrayElement = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	write.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+}
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include <tile_map.h>
+#include <vk_buffers.h>
+
+#include <algorithm>
+#include <cstring>
+
+void TileMap::init(VkDevice device, VmaAllocator allocator, BindlessHeap& heap, uint32_t width, uint32_t height)
+{
+	_allocator = allocator;
+	_heap = &heap;
+	_width = width;
+	_height = height;
+
+	_chunksX = (_width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	_chunksY = (_height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	uint32_t chunkCount = _chunksX * _chunksY;
+
+	_tiles.assign(chunkCount * CHUNK_TILES, EMPTY_TILE);
+
+	_buffer = vkutil::create_storage_buffer(_allocator, device, _tiles.size() * sizeof(uint16_t));
+	_bufferSlot = _heap->add_storage_buffer(_buffer.buffer);
+
+	// The buffer starts out with undefined contents, so the first frame uploads every chunk
+	_dirtyChunks.clear();
+	_chunkDirty.assign(chunkCount, false);
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+		mark_dirty(chunk);
+	}
+}
+
+void TileMap::destroy()
+{
+	_heap->remove_storage_buffer(_bufferSlot);
+	vkutil::destroy_buffer(_allocator, _buffer);
+	_tiles.clear();
+	_dirtyChunks.clear();
+	_chunkDirty.clear();
+}
+
+void TileMap::set(uint32_t x, uint32_t y, uint16_t tile)
+{
+	uint16_t& current = _tiles[tile_index(x, y)];
+	if (current != tile) {
+		current = tile;
+		mark_dirty((y / CHUNK_SIZE) * _chunksX + x / CHUNK_SIZE);
+	}
+}
+
+void TileMap::fill(uint16_t tile)
+{
+	for (uint32_t y = 0; y < _height; y++) {
+		for (uint32_t x = 0; x < _width; x++) {
+			set(x, y, tile);
+		}
+	}
+}
+
+void TileMap::mark_dirty(uint32_t chunk)
+{
+	if (!_chunkDirty[chunk]) {
+		_chunkDirty[chunk] = true;
+		_dirtyChunks.push_back(chunk);
+	}
+}
+
+void TileMap::record_upload(VkCommandBuffer cmd, FrameArena& arena)
+{
+	_bytesUploaded = 0;
+	_chunksUploaded = 0;
+	_regionsUploaded = 0;
+
+	if (_dirtyChunks.empty()) {
+		return;
+	}
+
+	const VkDeviceSize chunkBytes = CHUNK_TILES * sizeof(uint16_t);
+
+	VkDeviceSize size = _dirtyChunks.size() * chunkBytes;
+	FrameAllocation staging = arena.allocate(size, 4);
+	if (!staging) {
+		return;
+	}
+
+	// The chunks are staged in order, so chunks that follow each other in the map also follow each other in the arena,
+	// and are copied with a single region
+	std::sort(_dirtyChunks.begin(), _dirtyChunks.end());
+
+	std::vector<VkBufferCopy> regions;
+	for (size_t i = 0; i < _dirtyChunks.size(); i++) {
+		uint32_t chunk = _dirtyChunks[i];
+		VkDeviceSize stagingOffset = staging.offset + i * chunkBytes;
+		std::memcpy((uint8_t*)staging.data + i * chunkBytes, &_tiles[chunk * CHUNK_TILES], chunkBytes);
+
+		if (i > 0 && chunk == _dirtyChunks[i - 1] + 1) {
+			regions.back().size += chunkBytes;
+		}
+		else {
+			VkBufferCopy region{};
+			region.srcOffset = stagingOffset;
+			region.dstOffset = chunk * chunkBytes;
+			region.size = chunkBytes;
+			regions.push_back(region);
+		}
+
+		_chunkDirty[chunk] = false;
+	}
+
+	// Earlier frames might still be reading the tiles, to draw them or to light them.
+	// The copy overwrites them, so it has to wait for those reads to finish, but does not need to make anything visible.
+	const VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+
+	VkMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	barrier.pNext = nullptr;
+	barrier.srcStageMask = readStages;
+	barrier.srcAccessMask = VK_ACCESS_2_NONE;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+	VkDependencyInfo dependencyInfo{};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.pNext = nullptr;
+	dependencyInfo.memoryBarrierCount = 1;
+	dependencyInfo.pMemoryBarriers = &barrier;
+	vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+	vkCmdCopyBuffer(cmd, staging.buffer, _buffer.buffer, (uint32_t)regions.size(), regions.data());
+
+	// The passes of this frame read the new tiles
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	barrier.dstStageMask = readStages;
+	barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+	vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+
+	_bytesUploaded = size;
+	_chunksUploaded = (uint32_t)_dirtyChunks.size();
+	_regionsUploaded = (uint32_t)regions.size();
+	_dirtyChunks.clear();
+}
+
+namespace {
+	// Small xorshift generator, so the same seed always gives the same dungeon on every platform
+	struct Random {
+		uint32_t state;
+
+		uint32_t next()
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		// In [min, max]
+		uint32_t range(uint32_t min, uint32_t max)
+		{
+			return min + next() % (max - min + 1);
+		}
+	};
+
+	struct Room {
+		uint32_t x, y, width, height;
+
+		uint32_t center_x() const { return x + width / 2; }
+		uint32_t center_y() const { return y + height / 2; }
+
+		// Rooms keep at least one tile between them, so their walls never merge
+		bool overlaps(const Room& other) const
+		{
+			return x <= other.x + other.width + 1 && other.x <= x + width + 1 &&
+				y <= other.y + other.height + 1 && other.y <= y + height + 1;
+		}
+	};
+}
+
+void generate_test_dungeon(TileMap& map, uint32_t seed)
+{
+	const uint16_t floor = make_tile('.', TileColor::DarkGray);
+	const uint16_t wall = make_tile('#', TileColor::Tan);
+
+	Random random{ seed == 0 ? 1u : seed };
+	map.fill(EMPTY_TILE);
+
+	// The outermost ring of tiles is left for the walls
+	if (map.width() < 8 || map.height() < 8) {
+		return;
+	}
+
+	std::vector<Room> rooms;
+	for (uint32_t attempt = 0; attempt < 200; attempt++) {
+		Room room;
+		room.width = random.range(4, std::min(14u, map.width() - 4));
+		room.height = random.range(3, std::min(8u, map.height() - 4));
+		room.x = random.range(1, map.width() - room.width - 2);
+		room.y = random.range(1, map.height() - room.height - 2);
+
+		bool overlapping = std::any_of(rooms.begin(), rooms.end(), [&](const Room& other) { return room.overlaps(other); });
+		if (overlapping) {
+			continue;
+		}
+
+		for (uint32_t y = room.y; y < room.y + room.height; y++) {
+			for (uint32_t x = room.x; x < room.x + room.width; x++) {
+				map.set(x, y, floor);
+			}
+		}
+
+		// Join every room to the previous one with an L shaped corridor
+		if (!rooms.empty()) {
+			const Room& previous = rooms.back();
+			uint32_t x0 = std::min(previous.center_x(), room.center_x());
+			uint32_t x1 = std::max(previous.center_x(), room.center_x());
+			uint32_t y0 = std::min(previous.center_y(), room.center_y());
+			uint32_t y1 = std::max(previous.center_y(), room.center_y());
+
+			for (uint32_t x = x0; x <= x1; x++) {
+				map.set(x, previous.center_y(), floor);
+			}
+			for (uint32_t y = y0; y <= y1; y++) {
+				map.set(room.center_x(), y, floor);
+			}
+		}
+
+		rooms.push_back(room);
+	}
+
+	// Every empty tile next to a floor tile becomes a wall
+	for (uint32_t y = 0; y < map.height(); y++) {
+		for (uint32_t x = 0; x < map.width(); x++) {
+			if (map.get(x, y) != EMPTY_TILE) {
+				continue;
+			}
+
+			bool nextToFloor = false;
+			for (int dy = -1; dy <= 1 && !nextToFloor; dy++) {
+				for (int dx = -1; dx <= 1 && !nextToFloor; dx++) {
+					int nx = (int)x + dx;
+					int ny = (int)y + dy;
+					if (nx >= 0 && ny >= 0 && nx < (int)map.width() && ny < (int)map.height()) {
+						nextToFloor = map.get(nx, ny) == floor;
+					}
+				}
+			}
+
+			if (nextToFloor) {
+				map.set(x, y, wall);
+			}
+		}
+	}
+
+	// A few things to look at
+	for (size_t i = 1; i < rooms.size(); i++) {
+		const Room& room = rooms[i];
+		uint32_t x = random.range(room.x, room.x + room.width - 1);
+		uint32_t y = random.range(room.y, room.y + room.height - 1);
+		map.set(x, y, random.next() % 2 == 0 ? make_tile('$', TileColor::Yellow) : make_tile('g', TileColor::Green));
+	}
+
+	if (!rooms.empty()) {
+		map.set(rooms[0].center_x(), rooms[0].center_y(), make_tile('@', TileColor::White));
+	}
+}
\ No newline at end of file
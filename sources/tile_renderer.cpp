@@ -0,0 +1,205 @@
+#include <tile_renderer.h>
+#include <vk_types.h>
+#include <vk_buffers.h>
+#include <vk_initializers.h>
+#include <vk_memory_budget.h>
+
+#include <SDL3/SDL_log.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+	struct GlyphBitmap {
+		uint8_t glyph;
+		// One byte per row, top row first, with the leftmost pixel in the highest bit
+		uint8_t rows[8];
+	};
+
+	// The glyphs the game uses so far. Every other printable character is drawn as a box, to make it easy to spot.
+	const GlyphBitmap GLYPH_BITMAPS[] = {
+		{ '.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00 } },
+		{ '#', { 0x6C, 0x6C, 0xFE, 0x6C, 0xFE, 0x6C, 0x6C, 0x00 } },
+		{ '@', { 0x7C, 0xC6, 0xDE, 0xDE, 0xDE, 0xC0, 0x78, 0x00 } },
+		{ '$', { 0x30, 0x7C, 0xC0, 0x78, 0x0C, 0xF8, 0x30, 0x00 } },
+		{ 'g', { 0x00, 0x00, 0x76, 0xCC, 0xCC, 0x7C, 0x0C, 0xF8 } },
+		{ '+', { 0x00, 0x30, 0x30, 0xFC, 0x30, 0x30, 0x00, 0x00 } },
+		{ '<', { 0x18, 0x30, 0x60, 0xC0, 0x60, 0x30, 0x18, 0x00 } },
+		{ '>', { 0x60, 0x30, 0x18, 0x0C, 0x18, 0x30, 0x60, 0x00 } },
+		{ '~', { 0x76, 0xDC, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } },
+		// A full block, where code page 437 has it
+		{ 219, { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF } },
+	};
+
+	const uint8_t BOX_ROWS[8] = { 0x00, 0x7E, 0x42, 0x42, 0x42, 0x42, 0x7E, 0x00 };
+}
+
+MapView fit_map_view(uint32_t mapWidth, uint32_t mapHeight, VkExtent2D extent)
+{
+	MapView view{};
+	if (mapWidth == 0 || mapHeight == 0) {
+		return view;
+	}
+
+	view.tileSize = std::min((float)extent.width / mapWidth, (float)extent.height / mapHeight);
+	view.origin[0] = ((float)extent.width - view.tileSize * mapWidth) * 0.5f;
+	view.origin[1] = ((float)extent.height - view.tileSize * mapHeight) * 0.5f;
+	return view;
+}
+
+void TileRenderer::init(VkDevice device, VmaAllocator allocator, VkFormat colorFormat, BindlessHeap& heap, LayoutCache& layouts,
+	ShaderLibrary& shaders, PipelineRegistry& pipelines, UploadManager& uploads, ImageStateTracker& imageStates)
+{
+	_device = device;
+	_allocator = allocator;
+	_heap = &heap;
+	_imageStates = &imageStates;
+
+	create_atlas(uploads);
+
+	// Glyphs are sampled texel for texel, and tiles never sample outside of their own cell
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.pNext = nullptr;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = 0.0f;
+	vk_check(vkCreateSampler(_device, &samplerInfo, nullptr, &_sampler));
+
+	_atlasSlot = _heap->add_texture(_atlas.imageView, _sampler);
+
+	VkShaderModule vertexShader = shaders.load("resources/shaders/tile_map.vert.spv");
+	VkShaderModule fragmentShader = shaders.load("resources/shaders/tile_map.frag.spv");
+	if (vertexShader == VK_NULL_HANDLE || fragmentShader == VK_NULL_HANDLE) {
+		panic_and_exit("Failed to load tile map shaders!");
+	}
+
+	std::vector<LayoutCache::FixedSet> bindlessSet = { { BindlessHeap::SET, _heap->set_layout() } };
+	VkPushConstantRange bindlessPushConstants = _heap->push_constant_range();
+
+	std::string layoutError;
+	_pipelineLayout = layouts.reflect_pipeline_layout(
+		{ shaders.reflection(vertexShader), shaders.reflection(fragmentShader) }, layoutError, bindlessSet, &bindlessPushConstants);
+	if (_pipelineLayout == VK_NULL_HANDLE) {
+		panic_and_exit("Tile map shaders do not fit together: %s", layoutError.c_str());
+	}
+
+	PipelineBuilder pipelineBuilder;
+	pipelineBuilder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+	pipelineBuilder.set_polygon_mode(VK_POLYGON_MODE_FILL);
+	pipelineBuilder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE);
+	pipelineBuilder.set_multisampling_none();
+	// Only the glyphs themselves cover what is behind the map
+	pipelineBuilder.enable_blending_alphablend();
+	pipelineBuilder.disable_depthtest();
+	pipelineBuilder.set_color_attachment_format(colorFormat);
+	pipelineBuilder.set_depth_format(VK_FORMAT_UNDEFINED);
+	pipelineBuilder.set_shaders(vertexShader, fragmentShader);
+	pipelineBuilder._pipelineLayout = _pipelineLayout;
+
+	_pipeline = pipelines.request_pipeline("tile map", pipelineBuilder);
+}
+
+void TileRenderer::wait_for_pipeline(PipelineRegistry& pipelines) const
+{
+	pipelines.wait(_pipeline);
+}
+
+void TileRenderer::destroy()
+{
+	_heap->remove_texture(_atlasSlot);
+	_imageStates->forget(_atlas.image);
+
+	vkDestroySampler(_device, _sampler, nullptr);
+	vkDestroyImageView(_device, _atlas.imageView, nullptr);
+	vkutil::untrack_allocation(_allocator, _atlas.allocation);
+	vmaDestroyImage(_allocator, _atlas.image, _atlas.allocation);
+}
+
+void TileRenderer::draw(VkCommandBuffer cmd, const TileMap& map, VkExtent2D extent) const
+{
+	VkPipeline pipeline = _pipeline.get();
+	if (pipeline == VK_NULL_HANDLE || map.width() == 0 || map.height() == 0) {
+		return;
+	}
+
+	MapView view = fit_map_view(map.width(), map.height(), extent);
+
+	TileMapPushConstants constants{};
+	constants.origin[0] = view.origin[0];
+	constants.origin[1] = view.origin[1];
+	constants.tileSize[0] = view.tileSize;
+	constants.tileSize[1] = view.tileSize;
+	constants.viewportSize[0] = (float)extent.width;
+	constants.viewportSize[1] = (float)extent.height;
+	constants.mapWidth = map.width();
+	constants.mapHeight = map.height();
+	constants.tileBuffer = map.buffer_slot();
+	constants.atlasTexture = _atlasSlot;
+	constants.atlasColumns = ATLAS_COLUMNS;
+	constants.lightTexture = _lightSlot;
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	vkutil::push_constants(cmd, _pipelineLayout, constants);
+
+	// One instance per tile, so the whole map is a single draw no matter how large it is
+	vkCmdDraw(cmd, 6, map.width() * map.height(), 0, 0);
+}
+
+void TileRenderer::create_atlas(UploadManager& uploads)
+{
+	uint32_t atlasSize = ATLAS_COLUMNS * GLYPH_SIZE;
+
+	// One byte of coverage per pixel
+	std::vector<uint8_t> pixels(atlasSize * atlasSize, 0);
+
+	for (uint32_t glyph = ' ' + 1; glyph < 256; glyph++) {
+		const uint8_t* rows = nullptr;
+		for (const GlyphBitmap& bitmap : GLYPH_BITMAPS) {
+			if (bitmap.glyph == glyph) {
+				rows = bitmap.rows;
+			}
+		}
+		if (rows == nullptr) {
+			if (glyph >= 127) {
+				continue;
+			}
+			rows = BOX_ROWS;
+		}
+
+		uint32_t cellX = (glyph % ATLAS_COLUMNS) * GLYPH_SIZE;
+		uint32_t cellY = (glyph / ATLAS_COLUMNS) * GLYPH_SIZE;
+
+		for (uint32_t y = 0; y < GLYPH_SIZE; y++) {
+			for (uint32_t x = 0; x < GLYPH_SIZE; x++) {
+				bool set = (rows[y] >> (7 - x)) & 1;
+				pixels[(cellY + y) * atlasSize + cellX + x] = set ? 255 : 0;
+			}
+		}
+	}
+
+	_atlas.imageFormat = VK_FORMAT_R8_UNORM;
+	_atlas.imageExtent = { atlasSize, atlasSize, 1 };
+
+	VkImageCreateInfo imageInfo = vkinit::image_create_info(_atlas.imageFormat,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, _atlas.imageExtent);
+
+	VmaAllocationCreateInfo allocInfo{};
+	allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+	vk_check(vmaCreateImage(_allocator, &imageInfo, &allocInfo, &_atlas.image, &_atlas.allocation, nullptr));
+	vkutil::track_allocation(_allocator, _atlas.allocation, MemoryCategory::Images);
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(_atlas.imageFormat, _atlas.image, VK_IMAGE_ASPECT_COLOR_BIT);
+	vk_check(vkCreateImageView(_device, &viewInfo, nullptr, &_atlas.imageView));
+
+	// The upload manager moves the image into its sampled layout when the upload is taken over by the graphics queue
+	_imageStates->track(_atlas.image, VK_IMAGE_ASPECT_COLOR_BIT);
+	if (uploads.upload_image(pixels.data(), pixels.size(), _atlas.image, _atlas.imageExtent, ImageUsage::FragmentSampled) == 0) {
+		panic_and_exit("Failed to upload the glyph atlas!");
+	}
+}
\ No newline at end of file
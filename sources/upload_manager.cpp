@@ -0,0 +1,394 @@
+#include <upload_manager.h>
+#include <vk_types.h>
+#include <vk_buffers.h>
+#include <vk_initializers.h>
+#include <align.h>
+
+#include <SDL3/SDL_log.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	// Offsets of copies into images have to be a multiple of the texel size, which this covers for every color format
+	constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+}
+
+void UploadManager::init(VkDevice device, VmaAllocator allocator, VkQueue transferQueue, uint32_t transferFamily, uint32_t graphicsFamily)
+{
+	_device = device;
+	_allocator = allocator;
+	_queue = transferQueue;
+	_transferFamily = transferFamily;
+	_graphicsFamily = graphicsFamily;
+
+	vk_check(_timeline.init(_device));
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.pNext = nullptr;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = _transferFamily;
+	vk_check(vkCreateCommandPool(_device, &poolInfo, nullptr, &_commandPool));
+
+	_staging = vkutil::create_buffer(_allocator, _device, STAGING_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, BufferMemory::Staging);
+
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Uploading through a %llu MB staging ring on %s",
+		(unsigned long long)(STAGING_RING_SIZE / (1024 * 1024)), dedicated_queue() ? "a dedicated transfer queue" : "the graphics queue");
+}
+
+void UploadManager::destroy()
+{
+	vkDestroyCommandPool(_device, _commandPool, nullptr);
+	vkutil::destroy_buffer(_allocator, _staging);
+	_timeline.destroy(_device);
+
+	_commandBuffers.clear();
+	_regions.clear();
+	_pendingBuffers.clear();
+	_pendingImages.clear();
+}
+
+uint64_t UploadManager::upload_buffer(const void* data, VkDeviceSize size, VkBuffer buffer, VkDeviceSize offset,
+	VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess)
+{
+	VkDeviceSize stagingOffset;
+	if (!allocate_staging(size, stagingOffset)) {
+		return 0;
+	}
+	copy_to_staging(data, size, stagingOffset);
+
+	BufferUpload upload{};
+	upload.buffer = buffer;
+	upload.region.srcOffset = stagingOffset;
+	upload.region.dstOffset = offset;
+	upload.region.size = size;
+	upload.dstStages = dstStages;
+	upload.dstAccess = dstAccess;
+	_pendingBuffers.push_back(upload);
+
+	return _timeline.submitted_value + 1;
+}
+
+uint64_t UploadManager::upload_image(const void* data, VkDeviceSize size, VkImage image, VkExtent3D extent, ImageUsage finalUsage)
+{
+	VkDeviceSize stagingOffset;
+	if (!allocate_staging(size, stagingOffset)) {
+		return 0;
+	}
+	copy_to_staging(data, size, stagingOffset);
+
+	ImageUpload upload{};
+	upload.image = image;
+	upload.region.bufferOffset = stagingOffset;
+	// Zero means tightly packed
+	upload.region.bufferRowLength = 0;
+	upload.region.bufferImageHeight = 0;
+	upload.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	upload.region.imageSubresource.mipLevel = 0;
+	upload.region.imageSubresource.baseArrayLayer = 0;
+	upload.region.imageSubresource.layerCount = 1;
+	upload.region.imageExtent = extent;
+	upload.size = size;
+	upload.finalUsage = finalUsage;
+	_pendingImages.push_back(upload);
+
+	return _timeline.submitted_value + 1;
+}
+
+void UploadManager::flush()
+{
+	submit();
+
+	_stats.bytes_uploaded = _bytesSinceFlush;
+	_stats.copies = _copiesSinceFlush;
+	_stats.total_bytes_uploaded += _bytesSinceFlush;
+	_bytesSinceFlush = 0;
+	_copiesSinceFlush = 0;
+}
+
+void UploadManager::submit()
+{
+	if (_pendingBuffers.empty() && _pendingImages.empty()) {
+		return;
+	}
+
+	VkCommandBuffer cmd = get_command_buffer();
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.pNext = nullptr;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vk_check(vkBeginCommandBuffer(cmd, &beginInfo));
+
+	// Images are completely overwritten, so their old contents are discarded by transitioning from undefined
+	std::vector<VkImageMemoryBarrier2> imageBarriers;
+	for (const ImageUpload& upload : _pendingImages) {
+		VkImageMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		barrier.pNext = nullptr;
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+		barrier.srcAccessMask = VK_ACCESS_2_NONE;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+		barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = upload.image;
+		barrier.subresourceRange = vkinit::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+		imageBarriers.push_back(barrier);
+	}
+
+	if (!imageBarriers.empty()) {
+		VkDependencyInfo dependencyInfo{};
+		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependencyInfo.pNext = nullptr;
+		dependencyInfo.imageMemoryBarrierCount = (uint32_t)imageBarriers.size();
+		dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+		vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+	}
+
+	// Copies into the same buffer are merged into one command
+	std::stable_sort(_pendingBuffers.begin(), _pendingBuffers.end(), [](const BufferUpload& a, const BufferUpload& b) {
+		return a.buffer < b.buffer;
+	});
+
+	std::vector<VkBufferCopy> regions;
+	for (size_t i = 0; i < _pendingBuffers.size(); i++) {
+		regions.push_back(_pendingBuffers[i].region);
+		_bytesSinceFlush += _pendingBuffers[i].region.size;
+
+		if (i + 1 == _pendingBuffers.size() || _pendingBuffers[i + 1].buffer != _pendingBuffers[i].buffer) {
+			vkCmdCopyBuffer(cmd, _staging.buffer, _pendingBuffers[i].buffer, (uint32_t)regions.size(), regions.data());
+			regions.clear();
+			_copiesSinceFlush++;
+		}
+	}
+
+	for (const ImageUpload& upload : _pendingImages) {
+		vkCmdCopyBufferToImage(cmd, _staging.buffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &upload.region);
+		_bytesSinceFlush += upload.size;
+		_copiesSinceFlush++;
+	}
+
+	// Release barriers. With a dedicated queue they hand the resources over to the graphics queue family,
+	// and the graphics queue records matching acquire barriers. On a single queue, only the images need a barrier,
+	// to move them into their final layout. The graphics submission waits on the upload timeline, which makes the copies visible.
+	std::vector<VkBufferMemoryBarrier2> releaseBuffers;
+	imageBarriers.clear();
+
+	for (const BufferUpload& upload : _pendingBuffers) {
+		if (!dedicated_queue()) {
+			break;
+		}
+
+		VkBufferMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+		barrier.pNext = nullptr;
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+		barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		// The second half of the transfer happens on the other queue, so the release itself does not wait for anything here
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+		barrier.dstAccessMask = VK_ACCESS_2_NONE;
+		barrier.srcQueueFamilyIndex = _transferFamily;
+		barrier.dstQueueFamilyIndex = _graphicsFamily;
+		barrier.buffer = upload.buffer;
+		barrier.offset = upload.region.dstOffset;
+		barrier.size = upload.region.size;
+		releaseBuffers.push_back(barrier);
+
+		// The acquire has to describe the same transfer, with the graphics queue's side of the dependency
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+		barrier.srcAccessMask = VK_ACCESS_2_NONE;
+		barrier.dstStageMask = upload.dstStages;
+		barrier.dstAccessMask = upload.dstAccess;
+		_acquireBufferBarriers.push_back(barrier);
+	}
+
+	for (const ImageUpload& upload : _pendingImages) {
+		ImageState finalState = image_usage_state(upload.finalUsage);
+
+		VkImageMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		barrier.pNext = nullptr;
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+		barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+		barrier.dstAccessMask = VK_ACCESS_2_NONE;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = finalState.layout;
+		barrier.srcQueueFamilyIndex = dedicated_queue() ? _transferFamily : VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = dedicated_queue() ? _graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = upload.image;
+		barrier.subresourceRange = vkinit::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+		imageBarriers.push_back(barrier);
+
+		if (dedicated_queue()) {
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+			barrier.srcAccessMask = VK_ACCESS_2_NONE;
+			barrier.dstStageMask = finalState.stages;
+			barrier.dstAccessMask = finalState.access;
+			_acquireImageBarriers.push_back(barrier);
+		}
+
+		_acquiredImages.push_back(upload);
+	}
+
+	if (!releaseBuffers.empty() || !imageBarriers.empty()) {
+		VkDependencyInfo dependencyInfo{};
+		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependencyInfo.pNext = nullptr;
+		dependencyInfo.bufferMemoryBarrierCount = (uint32_t)releaseBuffers.size();
+		dependencyInfo.pBufferMemoryBarriers = releaseBuffers.data();
+		dependencyInfo.imageMemoryBarrierCount = (uint32_t)imageBarriers.size();
+		dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+		vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+	}
+
+	vk_check(vkEndCommandBuffer(cmd));
+
+	uint64_t value = _timeline.next_value();
+	_commandBuffers.push_back({ cmd, value });
+
+	VkCommandBufferSubmitInfo cmdInfo = vkinit::command_buffer_submit_info(cmd);
+	VkSemaphoreSubmitInfo signalInfo = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _timeline.semaphore, value);
+	VkSubmitInfo2 submit = vkinit::submit_info(&cmdInfo, &signalInfo, 1, nullptr, 0);
+	vk_check(vkQueueSubmit2(_queue, 1, &submit, VK_NULL_HANDLE));
+
+	_stats.submissions++;
+
+	_pendingBuffers.clear();
+	_pendingImages.clear();
+	_unacquiredValue = value;
+}
+
+uint64_t UploadManager::record_acquire_barriers(VkCommandBuffer cmd, ImageStateTracker& tracker)
+{
+	if (!_acquireBufferBarriers.empty() || !_acquireImageBarriers.empty()) {
+		VkDependencyInfo dependencyInfo{};
+		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependencyInfo.pNext = nullptr;
+		dependencyInfo.bufferMemoryBarrierCount = (uint32_t)_acquireBufferBarriers.size();
+		dependencyInfo.pBufferMemoryBarriers = _acquireBufferBarriers.data();
+		dependencyInfo.imageMemoryBarrierCount = (uint32_t)_acquireImageBarriers.size();
+		dependencyInfo.pImageMemoryBarriers = _acquireImageBarriers.data();
+		vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+	}
+
+	// From here on the images are used like any other image on the graphics queue
+	for (const ImageUpload& upload : _acquiredImages) {
+		tracker.set_state(upload.image, image_usage_state(upload.finalUsage));
+	}
+
+	_acquireBufferBarriers.clear();
+	_acquireImageBarriers.clear();
+	_acquiredImages.clear();
+
+	uint64_t value = _unacquiredValue;
+	_unacquiredValue = 0;
+	return value;
+}
+
+bool UploadManager::allocate_staging(VkDeviceSize size, VkDeviceSize& offset)
+{
+	if (size > STAGING_RING_SIZE) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Upload of %llu bytes does not fit in the staging ring", (unsigned long long)size);
+		return false;
+	}
+
+	reclaim_staging();
+	if (try_allocate_staging(size, offset)) {
+		return true;
+	}
+
+	// The ring is full. Submit what is pending, so its memory can be reclaimed, and wait for the oldest submissions to finish.
+	_stats.stalls++;
+	submit();
+
+	while (!try_allocate_staging(size, offset)) {
+		if (_regions.empty()) {
+			return false;
+		}
+
+		vk_check(_timeline.wait(_device, _regions.front().value, UINT64_MAX));
+		reclaim_staging();
+	}
+
+	return true;
+}
+
+bool UploadManager::try_allocate_staging(VkDeviceSize size, VkDeviceSize& offset)
+{
+	if (_regions.empty()) {
+		_head = 0;
+		_tail = 0;
+	}
+
+	VkDeviceSize begin = vkutil::align_up(_head, STAGING_ALIGNMENT);
+
+	// Until the head wraps around, the free space is everything after the head, and everything before the tail
+	bool wrapped = _head < _tail || (_head == _tail && !_regions.empty());
+	if (!wrapped) {
+		if (begin + size > STAGING_RING_SIZE) {
+			// The end of the ring is skipped, and becomes free again together with the region before it
+			if (size > _tail) {
+				return false;
+			}
+			begin = 0;
+		}
+	}
+	else if (begin + size > _tail) {
+		return false;
+	}
+
+	offset = begin;
+	_head = begin + size;
+	_regions.push_back({ begin, begin + size, _timeline.submitted_value + 1 });
+
+	return true;
+}
+
+void UploadManager::reclaim_staging()
+{
+	uint64_t completed = _timeline.completed_value(_device);
+
+	while (!_regions.empty() && _regions.front().value <= completed) {
+		_regions.pop_front();
+	}
+
+	_tail = _regions.empty() ? _head : _regions.front().begin;
+}
+
+void UploadManager::copy_to_staging(const void* data, VkDeviceSize size, VkDeviceSize offset)
+{
+	std::memcpy((uint8_t*)_staging.info.pMappedData + offset, data, size);
+
+	// Does nothing on host coherent memory
+	vk_check(vmaFlushAllocation(_allocator, _staging.allocation, offset, size));
+}
+
+VkCommandBuffer UploadManager::get_command_buffer()
+{
+	uint64_t completed = _timeline.completed_value(_device);
+
+	for (size_t i = 0; i < _commandBuffers.size(); i++) {
+		if (_commandBuffers[i].value <= completed) {
+			VkCommandBuffer cmd = _commandBuffers[i].cmd;
+			_commandBuffers.erase(_commandBuffers.begin() + i);
+			vk_check(vkResetCommandBuffer(cmd, 0));
+			return cmd;
+		}
+	}
+
+	VkCommandBufferAllocateInfo cmdAllocInfo{};
+	cmdAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	cmdAllocInfo.pNext = nullptr;
+	cmdAllocInfo.commandPool = _commandPool;
+	cmdAllocInfo.commandBufferCount = 1;
+	cmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+	VkCommandBuffer cmd;
+	vk_check(vkAllocateCommandBuffers(_device, &cmdAllocInfo, &cmd));
+	return cmd;
+}
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include <vk_bindless.h>
+#include <vk_types.h>
+
+#include <SDL3/SDL_log.h>
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+
+namespace {
+	// Free slots are kept sorted from highest to lowest, so the lowest free slot is at the back and handed out first.
+	// Returns false if the slot was already free.
+	bool release_slot(std::vector<uint32_t>& freeSlots, uint32_t slot)
+	{
+		auto it = std::lower_bound(freeSlots.begin(), freeSlots.end(), slot, std::greater<uint32_t>());
+		if (it != freeSlots.end() && *it == slot) {
+			return false;
+		}
+
+		freeSlots.insert(it, slot);
+		return true;
+	}
+}
+
+void BindlessHeap::init(VkDevice device, VkPhysicalDevice physicalDevice, LayoutCache& layouts)
+{
+	_device = device;
+
+	// Update after bind descriptors have their own, usually much higher, limits
+	VkPhysicalDeviceVulkan12Properties properties12{};
+	properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+	properties12.pNext = nullptr;
+
+	VkPhysicalDeviceProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &properties12;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+	_storageBufferCapacity = std::min({ MAX_BINDLESS_STORAGE_BUFFERS,
+		properties12.maxDescriptorSetUpdateAfterBindStorageBuffers,
+		properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+
+	// Combined image samplers count as both a sampler and a sampled image
+	_textureCapacity = std::min({ MAX_BINDLESS_TEXTURES,
+		properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+		properties12.maxDescriptorSetUpdateAfterBindSamplers,
+		properties12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		properties12.maxPerStageDescriptorUpdateAfterBindSamplers,
+		properties12.maxPerStageUpdateAfterBindResources - _storageBufferCapacity });
+
+	std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+	bindings[STORAGE_BUFFER_BINDING].binding = STORAGE_BUFFER_BINDING;
+	bindings[STORAGE_BUFFER_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[STORAGE_BUFFER_BINDING].descriptorCount = _storageBufferCapacity;
+	bindings[STORAGE_BUFFER_BINDING].stageFlags = VK_SHADER_STAGE_ALL;
+
+	// The variable count is an upper bound here, the real count is given when the set is allocated
+	bindings[TEXTURE_BINDING].binding = TEXTURE_BINDING;
+	bindings[TEXTURE_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[TEXTURE_BINDING].descriptorCount = _textureCapacity;
+	bindings[TEXTURE_BINDING].stageFlags = VK_SHADER_STAGE_ALL;
+
+	VkDescriptorBindingFlags commonFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+		VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+	std::vector<VkDescriptorBindingFlags> bindingFlags(2);
+	bindingFlags[STORAGE_BUFFER_BINDING] = commonFlags;
+	bindingFlags[TEXTURE_BINDING] = commonFlags | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+
+	_setLayout = layouts.get_descriptor_set_layout(bindings, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT, bindingFlags);
+
+	VkPushConstantRange pushConstants = push_constant_range();
+	_pipelineLayout = layouts.get_pipeline_layout({ _setLayout }, { pushConstants });
+
+	VkDescriptorPoolSize poolSizes[] = {
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _storageBufferCapacity },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _textureCapacity }
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.pNext = nullptr;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+
+	vk_check(vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_pool));
+
+	VkDescriptorSetVariableDescriptorCountAllocateInfo countInfo{};
+	countInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+	countInfo.pNext = nullptr;
+	countInfo.descriptorSetCount = 1;
+	countInfo.pDescriptorCounts = &_textureCapacity;
+
+	VkDescriptorSetAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.pNext = &countInfo;
+	allocateInfo.descriptorPool = _pool;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &_setLayout;
+
+	vk_check(vkAllocateDescriptorSets(_device, &allocateInfo, &_set));
+
+	// Filled highest first, so slot 0 is handed out first. Removed slots are put back in order, so this stays true.
+	_freeTextureSlots.clear();
+	for (uint32_t slot = _textureCapacity; slot > 0; slot--) {
+		_freeTextureSlots.push_back(slot - 1);
+	}
+
+	_freeStorageBufferSlots.clear();
+	for (uint32_t slot = _storageBufferCapacity; slot > 0; slot--) {
+		_freeStorageBufferSlots.push_back(slot - 1);
+	}
+
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Bindless heap has room for %u textures and %u storage buffers", _textureCapacity, _storageBufferCapacity);
+}
+
+void BindlessHeap::destroy()
+{
+	// Destroying the pool frees the set. The layouts belong to the layout cache.
+	vkDestroyDescriptorPool(_device, _pool, nullptr);
+
+	_pool = VK_NULL_HANDLE;
+	_set = VK_NULL_HANDLE;
+	_freeTextureSlots.clear();
+	_freeStorageBufferSlots.clear();
+}
+
+uint32_t BindlessHeap::add_texture(VkImageView view, VkSampler sampler, VkImageLayout layout)
+{
+	if (_freeTextureSlots.empty()) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Bindless heap is out of texture slots");
+		return BINDLESS_INVALID_SLOT;
+	}
+
+	uint32_t slot = _freeTextureSlots.back();
+	_freeTextureSlots.pop_back();
+
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.sampler = sampler;
+	imageInfo.imageView = view;
+	imageInfo.imageLayout = layout;
+
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = _set;
+	write.dstBinding = TEXTURE_BINDING;
+	write.dstArrayElement = slot;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+
+	return slot;
+}
+
+uint32_t BindlessHeap::add_storage_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	if (_freeStorageBufferSlots.empty()) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Bindless heap is out of storage buffer slots");
+		return BINDLESS_INVALID_SLOT;
+	}
+
+	uint32_t slot = _freeStorageBufferSlots.back();
+	_freeStorageBufferSlots.pop_back();
+
+	VkDescriptorBufferInfo bufferInfo{};
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = offset;
+	bufferInfo.range = range;
+
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = _set;
+	write.dstBinding = STORAGE_BUFFER_BINDING;
+	write.dstArrayElement = slot;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	write.pBufferInfo = &bufferInfo;
+
+	vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+
+	return slot;
+}
+
+void BindlessHeap::remove_texture(uint32_t slot)
+{
+	// The descriptor is left as it is. With partially bound descriptors, stale entries are fine as long as nothing indexes them.
+	if (slot < _textureCapacity && !release_slot(_freeTextureSlots, slot)) {
+		// Handing the slot out twice would let two textures overwrite each other's descriptor
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Bindless texture slot %u removed twice", slot);
+		assert(false && "Bindless texture slot removed twice");
+	}
+}
+
+void BindlessHeap::remove_storage_buffer(uint32_t slot)
+{
+	if (slot < _storageBufferCapacity && !release_slot(_freeStorageBufferSlots, slot)) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Bindless storage buffer slot %u removed twice", slot);
+		assert(false && "Bindless storage buffer slot removed twice");
+	}
+}
+
+void BindlessHeap::bind(VkCommandBuffer cmd, VkPipelineBindPoint bindPoint) const
+{
+	vkCmdBindDescriptorSets(cmd, bindPoint, _pipelineLayout, SET, 1, &_set, 0, nullptr);
+}
+
+VkPushConstantRange BindlessHeap::push_constant_range() const
+{
+	VkPushConstantRange range{};
+	range.stageFlags = VK_SHADER_STAGE_ALL;
+	range.offset = 0;
+	range.size = PUSH_CONSTANT_SIZE;
+
+	return range;
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include <vk_buffers.h>
+#include <vk_types.h>
+#include <vk_initializers.h>
+#include <vk_memory_budget.h>
+
+AllocatedBuffer vkutil::create_buffer(VmaAllocator allocator, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, BufferMemory memory)
+{
+	VkBufferCreateInfo bufferInfo = vkinit::buffer_create_info(size, usage);
+
+	VmaAllocationCreateInfo allocInfo = {};
+	switch (memory) {
+	case BufferMemory::GpuOnly:
+		allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+		break;
+	case BufferMemory::Upload:
+		// VMA picks device local memory if it is host visible, and falls back to host memory otherwise.
+		// Writes are sequential, so write combined memory is fine.
+		allocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+		allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+		break;
+	case BufferMemory::Staging:
+		allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+		allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+		break;
+	case BufferMemory::Readback:
+		// The CPU reads these, which is very slow from uncached memory
+		allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+		allocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+		break;
+	}
+
+	AllocatedBuffer buffer{};
+	buffer.size = size;
+	vk_check(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &buffer.buffer, &buffer.allocation, &buffer.info));
+
+	bool staging = memory == BufferMemory::Staging || memory == BufferMemory::Readback;
+	vkutil::track_allocation(allocator, buffer.allocation, staging ? MemoryCategory::Staging : MemoryCategory::Buffers);
+
+	if (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
+		buffer.deviceAddress = buffer_device_address(device, buffer.buffer);
+	}
+
+	return buffer;
+}
+
+void vkutil::destroy_buffer(VmaAllocator allocator, const AllocatedBuffer& buffer)
+{
+	vkutil::untrack_allocation(allocator, buffer.allocation);
+	vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+}
+
+AllocatedBuffer vkutil::create_storage_buffer(VmaAllocator allocator, VkDevice device, VkDeviceSize size, BufferMemory memory)
+{
+	return create_buffer(allocator, device, size,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory);
+}
+
+AllocatedBuffer vkutil::create_index_buffer(VmaAllocator allocator, VkDevice device, VkDeviceSize size, BufferMemory memory)
+{
+	return create_buffer(allocator, device, size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory);
+}
+
+AllocatedBuffer vkutil::create_uniform_buffer(VmaAllocator allocator, VkDevice device, VkDeviceSize size, BufferMemory memory)
+{
+	return create_buffer(allocator, device, size,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory);
+}
+
+VkDeviceAddress vkutil::buffer_device_address(VkDevice device, VkBuffer buffer)
+{
+	VkBufferDeviceAddressInfo addressInfo{};
+	addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+	addressInfo.pNext = nullptr;
+	addressInfo.buffer = buffer;
+
+	return vkGetBufferDeviceAddress(device, &addressInfo);
+}
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include <vk_image_state.h>
+#include <vk_initializers.h>
+
+#include <cassert>
+
+namespace {
+	// Only writes have to be made available to later accesses. Reads never need to be flushed.
+	constexpr VkAccessFlags2 WRITE_ACCESS_MASK =
+		VK_ACCESS_2_SHADER_WRITE_BIT |
+		VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+		VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_2_TRANSFER_WRITE_BIT |
+		VK_ACCESS_2_HOST_WRITE_BIT |
+		VK_ACCESS_2_MEMORY_WRITE_BIT;
+}
+
+ImageState image_usage_state(ImageUsage usage)
+{
+	switch (usage) {
+		case ImageUsage::TransferSrc:
+			return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT };
+		case ImageUsage::TransferDst:
+			return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT };
+		case ImageUsage::ComputeStorageRead:
+			return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT };
+		case ImageUsage::ComputeStorageWrite:
+			return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT };
+		case ImageUsage::ComputeStorageReadWrite:
+			return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+				VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT };
+		case ImageUsage::ComputeSampled:
+			return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT };
+		case ImageUsage::FragmentSampled:
+			return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT };
+		case ImageUsage::ColorAttachment:
+			// Attachments loaded with VK_ATTACHMENT_LOAD_OP_LOAD are read as well as written
+			return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT };
+		case ImageUsage::Present:
+			// The presentation engine waits on the semaphore passed to vkQueuePresentKHR, which is signaled at all commands.
+			// The transition has to be ordered before that signal, so it waits for the last write to the image (the blit)
+			// and is chained into the signal through the same stage. No access is needed, as the semaphore makes the writes visible.
+			return { VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_NONE };
+		case ImageUsage::Undefined:
+		default:
+			return {};
+	}
+}
+
+void ImageStateTracker::track(VkImage image, VkImageAspectFlags aspect, ImageState state)
+{
+	_images[image] = TrackedImage{ aspect, state };
+}
+
+void ImageStateTracker::forget(VkImage image)
+{
+	_images.erase(image);
+}
+
+void ImageStateTracker::set_state(VkImage image, ImageState state)
+{
+	_images[image].state = state;
+}
+
+ImageState ImageStateTracker::get_state(VkImage image) const
+{
+	auto it = _images.find(image);
+	return it != _images.end() ? it->second.state : ImageState{};
+}
+
+void ImageStateTracker::use(VkImage image, ImageUsage usage, bool discardContents)
+{
+	auto it = _images.find(image);
+	assert(it != _images.end() && "Image has to be tracked before it can be used");
+
+	// The same image can not be transitioned twice in one batch, the second transition would have to wait for the first
+	for (const VkImageMemoryBarrier2& pending : _pendingImageBarriers) {
+		assert(pending.image != image && "Flush pending barriers before using an image again");
+	}
+
+	ImageState& current = it->second.state;
+	ImageState next = image_usage_state(usage);
+
+	VkAccessFlags2 currentWrites = current.access & WRITE_ACCESS_MASK;
+	VkAccessFlags2 nextWrites = next.access & WRITE_ACCESS_MASK;
+
+	bool layoutChange = current.layout != next.layout || (discardContents && current.layout != VK_IMAGE_LAYOUT_UNDEFINED);
+
+	// Read after read in the same layout needs no barrier at all.
+	// The readers are accumulated, so a later write waits for all of them.
+	if (!layoutChange && currentWrites == 0 && nextWrites == 0) {
+		current.stages |= next.stages;
+		current.access |= next.access;
+		return;
+	}
+
+	VkImageMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	barrier.pNext = nullptr;
+
+	// Wait for exactly the stages that last touched the image.
+	// Only previous writes have to be made available. A write after a read only needs the execution dependency.
+	barrier.srcStageMask = current.stages;
+	barrier.srcAccessMask = currentWrites;
+
+	barrier.dstStageMask = next.stages;
+	barrier.dstAccessMask = next.access;
+
+	barrier.oldLayout = discardContents ? VK_IMAGE_LAYOUT_UNDEFINED : current.layout;
+	barrier.newLayout = next.layout;
+
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+	barrier.image = image;
+	barrier.subresourceRange = vkinit::image_subresource_range(it->second.aspect);
+
+	_pendingImageBarriers.push_back(barrier);
+
+	current = next;
+}
+
+void ImageStateTracker::memory_barrier(VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess)
+{
+	VkMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	barrier.pNext = nullptr;
+	barrier.srcStageMask = srcStages;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstStageMask = dstStages;
+	barrier.dstAccessMask = dstAccess;
+
+	_pendingMemoryBarriers.push_back(barrier);
+}
+
+void ImageStateTracker::flush(VkCommandBuffer cmd)
+{
+	if (_pendingImageBarriers.empty() && _pendingMemoryBarriers.empty()) {
+		return;
+	}
+
+	VkDependencyInfo depInfo{};
+	depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	depInfo.pNext = nullptr;
+
+	depInfo.memoryBarrierCount = (uint32_t)_pendingMemoryBarriers.size();
+	depInfo.pMemoryBarriers = _pendingMemoryBarriers.data();
+
+	depInfo.imageMemoryBarrierCount = (uint32_t)_pendingImageBarriers.size();
+	depInfo.pImageMemoryBarriers = _pendingImageBarriers.data();
+
+	vkCmdPipelineBarrier2(cmd, &depInfo);
+
+	_barriersEmitted += (uint32_t)(_pendingImageBarriers.size() + _pendingMemoryBarriers.size());
+	_batchesEmitted++;
+
+	_pendingImageBarriers.clear();
+	_pendingMemoryBarriers.clear();
+}
+
+void ImageStateTracker::take_pending(std::vector<VkImageMemoryBarrier2>& imageBarriers, std::vector<VkMemoryBarrier2>& memoryBarriers)
+{
+	imageBarriers.insert(imageBarriers.end(), _pendingImageBarriers.begin(), _pendingImageBarriers.end());
+	memoryBarriers.insert(memoryBarriers.end(), _pendingMemoryBarriers.begin(), _pendingMemoryBarriers.end());
+
+	if (!_pendingImageBarriers.empty() || !_pendingMemoryBarriers.empty()) {
+		_barriersEmitted += (uint32_t)(_pendingImageBarriers.size() + _pendingMemoryBarriers.size());
+		_batchesEmitted++;
+	}
+
+	_pendingImageBarriers.clear();
+	_pendingMemoryBarriers.clear();
+}
+
+void ImageStateTracker::reset_counters()
+{
+	_barriersEmitted = 0;
+	_batchesEmitted = 0;
+}
\ No newline at end of file
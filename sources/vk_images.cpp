@@ -36,4 +36,36 @@ void vkutil::copy_image_to_image(VkCommandBuffer cmd, VkImage source, VkImage de
 	blitInfo.pRegions = &blitRegion;
 
 	vkCmdBlitImage2(cmd, &blitInfo);
+}
+
+void vkutil::copy_image_to_buffer(VkCommandBuffer cmd, VkImage source, VkBuffer destination, VkExtent2D size)
+{
+	// Copy the whole image into the buffer, tightly packed.
+	// A bufferRowLength and bufferImageHeight of 0 means the buffer layout follows the image extent.
+	VkBufferImageCopy2 copyRegion{};
+	copyRegion.sType = VK_STRUCTURE_TYPE_BUFFER_IMAGE_COPY_2;
+	copyRegion.pNext = nullptr;
+
+	copyRegion.bufferOffset = 0;
+	copyRegion.bufferRowLength = 0;
+	copyRegion.bufferImageHeight = 0;
+
+	copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copyRegion.imageSubresource.baseArrayLayer = 0;
+	copyRegion.imageSubresource.layerCount = 1;
+	copyRegion.imageSubresource.mipLevel = 0;
+
+	copyRegion.imageOffset = { 0, 0, 0 };
+	copyRegion.imageExtent = { size.width, size.height, 1 };
+
+	VkCopyImageToBufferInfo2 copyInfo{};
+	copyInfo.sType = VK_STRUCTURE_TYPE_COPY_IMAGE_TO_BUFFER_INFO_2;
+	copyInfo.pNext = nullptr;
+	copyInfo.srcImage = source;
+	copyInfo.srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	copyInfo.dstBuffer = destination;
+	copyInfo.regionCount = 1;
+	copyInfo.pRegions = &copyRegion;
+
+	vkCmdCopyImageToBuffer2(cmd, &copyInfo);
 }
\ No newline at end of file
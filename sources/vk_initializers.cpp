@@ -24,6 +24,21 @@ VkImageCreateInfo vkinit::image_create_info(VkFormat format, VkImageUsageFlags u
 	return info;
 }
 
+VkBufferCreateInfo vkinit::buffer_create_info(VkDeviceSize size, VkBufferUsageFlags usageFlags)
+{
+	VkBufferCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	info.pNext = nullptr;
+
+	info.size = size;
+	info.usage = usageFlags;
+
+	// Only used by one queue family at a time. Buffers moving between queues are transferred with barriers.
+	info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	return info;
+}
+
 VkImageViewCreateInfo vkinit::imageview_create_info(VkFormat format, VkImage image, VkImageAspectFlags flags)
 {
 	// Build a image-view for the depth image to use for rendering
@@ -44,6 +59,19 @@ VkImageViewCreateInfo vkinit::imageview_create_info(VkFormat format, VkImage ima
 	return info;
 }
 
+VkImageSubresourceRange vkinit::image_subresource_range(VkImageAspectFlags aspectMask)
+{
+	// Covers every mip level and array layer of the image
+	VkImageSubresourceRange subImage{};
+	subImage.aspectMask = aspectMask;
+	subImage.baseMipLevel = 0;
+	subImage.levelCount = VK_REMAINING_MIP_LEVELS;
+	subImage.baseArrayLayer = 0;
+	subImage.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+	return subImage;
+}
+
 VkPipelineLayoutCreateInfo vkinit::pipeline_layout_create_info()
 {
 	VkPipelineLayoutCreateInfo info{};
@@ -65,6 +93,40 @@ VkPipelineShaderStageCreateInfo vkinit::pipeline_shader_stage_create_info(VkShad
 	return info;
 }
 
+VkComputePipelineCreateInfo vkinit::compute_pipeline_create_info(const VkPipelineShaderStageCreateInfo& stage, VkPipelineLayout layout)
+{
+	VkComputePipelineCreateInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	info.pNext = nullptr;
+
+	info.stage = stage;
+	info.layout = layout;
+
+	return info;
+}
+
+VkPushConstantRange vkinit::push_constant_range(VkShaderStageFlags stages, uint32_t size, uint32_t offset)
+{
+	VkPushConstantRange range{};
+	range.stageFlags = stages;
+	range.offset = offset;
+	range.size = size;
+
+	return range;
+}
+
+VkSpecializationInfo vkinit::specialization_info(const std::vector<VkSpecializationMapEntry>& entries, const void* data, size_t dataSize)
+{
+	// Only points at the entries and the data, which have to outlive the pipeline creation
+	VkSpecializationInfo info{};
+	info.mapEntryCount = (uint32_t)entries.size();
+	info.pMapEntries = entries.data();
+	info.dataSize = dataSize;
+	info.pData = data;
+
+	return info;
+}
+
 VkRenderingAttachmentInfo vkinit::attachment_info(VkImageView imageView, VkClearValue* clear, VkImageLayout layout)
 {
 	VkRenderingAttachmentInfo colorAttachment{};
@@ -80,4 +142,66 @@ VkRenderingAttachmentInfo vkinit::attachment_info(VkImageView imageView, VkClear
 	}
 
 	return colorAttachment;
+}
+
+VkRenderingInfo vkinit::rendering_info(VkExtent2D renderExtent, VkRenderingAttachmentInfo* colorAttachment, VkRenderingAttachmentInfo* depthAttachment)
+{
+	VkRenderingInfo renderInfo{};
+	renderInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+	renderInfo.pNext = nullptr;
+
+	renderInfo.renderArea = VkRect2D{ VkOffset2D{ 0, 0 }, renderExtent };
+	renderInfo.layerCount = 1;
+	renderInfo.colorAttachmentCount = colorAttachment ? 1 : 0;
+	renderInfo.pColorAttachments = colorAttachment;
+	renderInfo.pDepthAttachment = depthAttachment;
+	renderInfo.pStencilAttachment = nullptr;
+
+	return renderInfo;
+}
+
+VkSemaphoreSubmitInfo vkinit::semaphore_submit_info(VkPipelineStageFlags2 stageMask, VkSemaphore semaphore, uint64_t value)
+{
+	VkSemaphoreSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	submitInfo.pNext = nullptr;
+	submitInfo.semaphore = semaphore;
+	submitInfo.stageMask = stageMask;
+	submitInfo.deviceIndex = 0;
+	// The value is only used by timeline semaphores, and ignored for binary semaphores
+	submitInfo.value = value;
+
+	return submitInfo;
+}
+
+VkCommandBufferSubmitInfo vkinit::command_buffer_submit_info(VkCommandBuffer cmd)
+{
+	VkCommandBufferSubmitInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+	info.pNext = nullptr;
+	info.commandBuffer = cmd;
+	info.deviceMask = 0;
+
+	return info;
+}
+
+VkSubmitInfo2 vkinit::submit_info(VkCommandBufferSubmitInfo* cmd,
+	VkSemaphoreSubmitInfo* signalSemaphoreInfos, uint32_t signalSemaphoreCount,
+	VkSemaphoreSubmitInfo* waitSemaphoreInfos, uint32_t waitSemaphoreCount,
+	uint32_t commandBufferCount)
+{
+	VkSubmitInfo2 info = {};
+	info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+	info.pNext = nullptr;
+
+	info.waitSemaphoreInfoCount = waitSemaphoreCount;
+	info.pWaitSemaphoreInfos = waitSemaphoreInfos;
+
+	info.signalSemaphoreInfoCount = signalSemaphoreCount;
+	info.pSignalSemaphoreInfos = signalSemaphoreInfos;
+
+	info.commandBufferInfoCount = commandBufferCount;
+	info.pCommandBufferInfos = cmd;
+
+	return info;
 }
\ No newline at end of file
@@ -0,0 +1,257 @@
+#include <vk_layout_cache.h>
+#include <vk_types.h>
+#include <vk_initializers.h>
+
+#include <algorithm>
+#include <map>
+
+namespace {
+	const char* descriptor_type_name(VkDescriptorType type)
+	{
+		switch (type) {
+		case VK_DESCRIPTOR_TYPE_SAMPLER: return "sampler";
+		case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER: return "combined image sampler";
+		case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE: return "sampled image";
+		case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE: return "storage image";
+		case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER: return "uniform texel buffer";
+		case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER: return "storage texel buffer";
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER: return "uniform buffer";
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER: return "storage buffer";
+		case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT: return "input attachment";
+		case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR: return "acceleration structure";
+		default: return "unknown descriptor";
+		}
+	}
+
+	std::string binding_name(uint32_t set, uint32_t binding)
+	{
+		return "set " + std::to_string(set) + " binding " + std::to_string(binding);
+	}
+
+	// Checks a binding declared by a shader against the binding of a set layout that was made elsewhere
+	bool matches_fixed_binding(const ReflectedBinding& reflected, VkShaderStageFlagBits stage,
+		const std::vector<VkDescriptorSetLayoutBinding>& layoutBindings, std::string& error)
+	{
+		auto it = std::find_if(layoutBindings.begin(), layoutBindings.end(), [&](const VkDescriptorSetLayoutBinding& binding) {
+			return binding.binding == reflected.binding;
+		});
+
+		std::string name = binding_name(reflected.set, reflected.binding);
+
+		if (it == layoutBindings.end()) {
+			error = name + " is not part of the fixed set layout";
+			return false;
+		}
+		if (it->descriptorType != reflected.type) {
+			error = name + " is a " + descriptor_type_name(reflected.type) + " in the shader, but a " + descriptor_type_name(it->descriptorType) + " in the fixed set layout";
+			return false;
+		}
+		// A runtime sized array can index any number of descriptors, a sized one needs at least as many as it declares
+		if (reflected.count > it->descriptorCount) {
+			error = name + " has " + std::to_string(reflected.count) + " descriptors in the shader, but only " + std::to_string(it->descriptorCount) + " in the fixed set layout";
+			return false;
+		}
+		if ((it->stageFlags & stage) == 0) {
+			error = name + " is not visible to the stage using it in the fixed set layout";
+			return false;
+		}
+
+		return true;
+	}
+}
+
+void LayoutCache::init(VkDevice device)
+{
+	_device = device;
+}
+
+void LayoutCache::destroy()
+{
+	for (auto& [key, layout] : _pipelineLayouts) {
+		vkDestroyPipelineLayout(_device, layout, nullptr);
+	}
+	for (auto& [key, layout] : _setLayouts) {
+		vkDestroyDescriptorSetLayout(_device, layout, nullptr);
+	}
+
+	_pipelineLayouts.clear();
+	_setLayouts.clear();
+	_setBindings.clear();
+}
+
+VkDescriptorSetLayout LayoutCache::get_descriptor_set_layout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+	VkDescriptorSetLayoutCreateFlags flags, const std::vector<VkDescriptorBindingFlags>& bindingFlags)
+{
+	std::vector<uint32_t> state;
+	state.push_back(flags);
+	state.push_back((uint32_t)bindings.size());
+	for (size_t i = 0; i < bindings.size(); i++) {
+		state.push_back(bindings[i].binding);
+		state.push_back(bindings[i].descriptorType);
+		state.push_back(bindings[i].descriptorCount);
+		state.push_back(bindings[i].stageFlags);
+		state.push_back(bindingFlags.empty() ? 0 : bindingFlags[i]);
+	}
+
+	StateKey key = vkutil::make_state_key(std::move(state));
+
+	auto it = _setLayouts.find(key);
+	if (it != _setLayouts.end()) {
+		return it->second;
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+	flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	flagsInfo.pNext = nullptr;
+	flagsInfo.bindingCount = (uint32_t)bindingFlags.size();
+	flagsInfo.pBindingFlags = bindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	info.pNext = bindingFlags.empty() ? nullptr : &flagsInfo;
+	info.flags = flags;
+	info.bindingCount = (uint32_t)bindings.size();
+	info.pBindings = bindings.data();
+
+	VkDescriptorSetLayout layout;
+	vk_check(vkCreateDescriptorSetLayout(_device, &info, nullptr, &layout));
+
+	_setLayouts.emplace(std::move(key), layout);
+	_setBindings.emplace(layout, bindings);
+
+	return layout;
+}
+
+VkPipelineLayout LayoutCache::get_pipeline_layout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges)
+{
+	std::vector<uint32_t> state;
+	state.push_back((uint32_t)setLayouts.size());
+	for (VkDescriptorSetLayout setLayout : setLayouts) {
+		uint64_t handle = (uint64_t)setLayout;
+		state.push_back((uint32_t)handle);
+		state.push_back((uint32_t)(handle >> 32));
+	}
+	state.push_back((uint32_t)pushConstantRanges.size());
+	for (const VkPushConstantRange& range : pushConstantRanges) {
+		state.push_back(range.stageFlags);
+		state.push_back(range.offset);
+		state.push_back(range.size);
+	}
+
+	StateKey key = vkutil::make_state_key(std::move(state));
+
+	auto it = _pipelineLayouts.find(key);
+	if (it != _pipelineLayouts.end()) {
+		return it->second;
+	}
+
+	VkPipelineLayoutCreateInfo info = vkinit::pipeline_layout_create_info();
+	info.setLayoutCount = (uint32_t)setLayouts.size();
+	info.pSetLayouts = setLayouts.data();
+	info.pushConstantRangeCount = (uint32_t)pushConstantRanges.size();
+	info.pPushConstantRanges = pushConstantRanges.data();
+
+	VkPipelineLayout layout;
+	vk_check(vkCreatePipelineLayout(_device, &info, nullptr, &layout));
+
+	_pipelineLayouts.emplace(std::move(key), layout);
+
+	return layout;
+}
+
+VkPipelineLayout LayoutCache::reflect_pipeline_layout(const std::vector<const ShaderReflection*>& shaders, std::string& error,
+	const std::vector<FixedSet>& fixedSets, const VkPushConstantRange* fixedPushConstants)
+{
+	// Bindings of every shader merged together, ordered by set and binding
+	std::map<uint32_t, std::map<uint32_t, VkDescriptorSetLayoutBinding>> sets;
+	VkPushConstantRange pushConstants{};
+
+	for (const FixedSet& fixed : fixedSets) {
+		sets[fixed.set];
+	}
+
+	for (const ShaderReflection* shader : shaders) {
+		if (shader->pushConstantSize > 0 && fixedPushConstants != nullptr) {
+			if (shader->pushConstantSize > fixedPushConstants->offset + fixedPushConstants->size || (fixedPushConstants->stageFlags & shader->stage) == 0) {
+				error = "push constants of " + std::to_string(shader->pushConstantSize) + " bytes do not fit the fixed push constant range";
+				return VK_NULL_HANDLE;
+			}
+		}
+		else if (shader->pushConstantSize > 0) {
+			pushConstants.stageFlags |= shader->stage;
+			pushConstants.size = std::max(pushConstants.size, shader->pushConstantSize);
+		}
+
+		for (const ReflectedBinding& reflected : shader->bindings) {
+			auto fixed = std::find_if(fixedSets.begin(), fixedSets.end(), [&](const FixedSet& fixed) { return fixed.set == reflected.set; });
+			if (fixed != fixedSets.end()) {
+				if (!matches_fixed_binding(reflected, shader->stage, _setBindings[fixed->layout], error)) {
+					return VK_NULL_HANDLE;
+				}
+				continue;
+			}
+
+			std::string name = binding_name(reflected.set, reflected.binding);
+
+			if (reflected.count == 0) {
+				error = name + " is a runtime sized array, which needs a fixed set layout";
+				return VK_NULL_HANDLE;
+			}
+
+			auto [it, inserted] = sets[reflected.set].try_emplace(reflected.binding);
+			VkDescriptorSetLayoutBinding& binding = it->second;
+
+			if (inserted) {
+				binding.binding = reflected.binding;
+				binding.descriptorType = reflected.type;
+				binding.descriptorCount = reflected.count;
+				binding.stageFlags = shader->stage;
+				binding.pImmutableSamplers = nullptr;
+				continue;
+			}
+
+			// Declared by an earlier shader of the pipeline as well, which has to agree on what it is
+			if (binding.descriptorType != reflected.type) {
+				error = name + " is a " + descriptor_type_name(binding.descriptorType) + " in one shader and a " + descriptor_type_name(reflected.type) + " in another";
+				return VK_NULL_HANDLE;
+			}
+			if (binding.descriptorCount != reflected.count) {
+				error = name + " is an array of " + std::to_string(binding.descriptorCount) + " in one shader and of " + std::to_string(reflected.count) + " in another";
+				return VK_NULL_HANDLE;
+			}
+			binding.stageFlags |= shader->stage;
+		}
+	}
+
+	// Set indices are positions in the pipeline layout, so unused sets in between still need a layout
+	uint32_t setCount = sets.empty() ? 0 : sets.rbegin()->first + 1;
+	std::vector<VkDescriptorSetLayout> setLayouts(setCount, VK_NULL_HANDLE);
+
+	for (uint32_t set = 0; set < setCount; set++) {
+		auto fixed = std::find_if(fixedSets.begin(), fixedSets.end(), [&](const FixedSet& fixed) { return fixed.set == set; });
+		if (fixed != fixedSets.end()) {
+			setLayouts[set] = fixed->layout;
+			continue;
+		}
+
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		auto it = sets.find(set);
+		if (it != sets.end()) {
+			for (auto& [index, binding] : it->second) {
+				bindings.push_back(binding);
+			}
+		}
+
+		setLayouts[set] = get_descriptor_set_layout(bindings);
+	}
+
+	std::vector<VkPushConstantRange> pushConstantRanges;
+	if (fixedPushConstants != nullptr) {
+		pushConstantRanges.push_back(*fixedPushConstants);
+	}
+	else if (pushConstants.size > 0) {
+		pushConstantRanges.push_back(pushConstants);
+	}
+
+	return get_pipeline_layout(setLayouts, pushConstantRanges);
+}
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include <vk_memory_budget.h>
+
+#include <SDL3/SDL_log.h>
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+	std::atomic<uint64_t> category_bytes[(uint32_t)MemoryCategory::Count];
+	std::atomic<uint32_t> category_allocations[(uint32_t)MemoryCategory::Count];
+
+	double to_megabytes(VkDeviceSize bytes)
+	{
+		return (double)bytes / (1024.0 * 1024.0);
+	}
+}
+
+const char* memory_category_name(MemoryCategory category)
+{
+	switch (category) {
+		case MemoryCategory::Images: return "images";
+		case MemoryCategory::Buffers: return "buffers";
+		case MemoryCategory::Staging: return "staging";
+		default: return "unknown";
+	}
+}
+
+void vkutil::track_allocation(VmaAllocator allocator, VmaAllocation allocation, MemoryCategory category)
+{
+	vmaSetAllocationUserData(allocator, allocation, (void*)(uintptr_t)category);
+
+	VmaAllocationInfo info;
+	vmaGetAllocationInfo(allocator, allocation, &info);
+
+	category_bytes[(uint32_t)category] += info.size;
+	category_allocations[(uint32_t)category]++;
+}
+
+void vkutil::untrack_allocation(VmaAllocator allocator, VmaAllocation allocation)
+{
+	VmaAllocationInfo info;
+	vmaGetAllocationInfo(allocator, allocation, &info);
+
+	MemoryCategory category = (MemoryCategory)(uintptr_t)info.pUserData;
+
+	category_bytes[(uint32_t)category] -= info.size;
+	category_allocations[(uint32_t)category]--;
+}
+
+void MemoryBudget::init(VmaAllocator allocator, bool budgetExtension)
+{
+	_allocator = allocator;
+	_budgetExtension = budgetExtension;
+
+	if (!_budgetExtension) {
+		SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "VK_EXT_memory_budget is not supported, memory budgets are estimated");
+	}
+
+	update(0);
+}
+
+void MemoryBudget::update(uint32_t frameIndex)
+{
+	// VMA only refreshes the budget from the driver every few allocations, or when told which frame it is
+	vmaSetCurrentFrameIndex(_allocator, frameIndex);
+
+	const VkPhysicalDeviceMemoryProperties* memoryProperties;
+	vmaGetMemoryProperties(_allocator, &memoryProperties);
+
+	VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+	vmaGetHeapBudgets(_allocator, budgets);
+
+	VmaTotalStatistics statistics;
+	vmaCalculateStatistics(_allocator, &statistics);
+
+	uint32_t heapCount = memoryProperties->memoryHeapCount;
+	_heaps.resize(heapCount);
+	_warned.resize(heapCount, false);
+
+	for (uint32_t heap = 0; heap < heapCount; heap++) {
+		HeapBudget& heapBudget = _heaps[heap];
+		heapBudget.flags = memoryProperties->memoryHeaps[heap].flags;
+		heapBudget.usage = budgets[heap].usage;
+		heapBudget.budget = budgets[heap].budget;
+		heapBudget.block_bytes = statistics.memoryHeap[heap].statistics.blockBytes;
+		heapBudget.allocation_bytes = statistics.memoryHeap[heap].statistics.allocationBytes;
+		heapBudget.block_count = statistics.memoryHeap[heap].statistics.blockCount;
+		heapBudget.allocation_count = statistics.memoryHeap[heap].statistics.allocationCount;
+
+		bool nearBudget = heapBudget.budget > 0 && (double)heapBudget.usage >= (double)heapBudget.budget * WARNING_THRESHOLD;
+		if (nearBudget && !_warned[heap]) {
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Memory heap %u (%s) is at %.1f of %.1f MB, close to its budget",
+				heap, (heapBudget.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "device local" : "host",
+				to_megabytes(heapBudget.usage), to_megabytes(heapBudget.budget));
+		}
+		_warned[heap] = nearBudget;
+	}
+}
+
+CategoryUsage MemoryBudget::category(MemoryCategory category) const
+{
+	return { category_bytes[(uint32_t)category].load(), category_allocations[(uint32_t)category].load() };
+}
+
+VkDeviceSize MemoryBudget::device_local_usage() const
+{
+	VkDeviceSize usage = 0;
+	for (const HeapBudget& heap : _heaps) {
+		if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+			usage += heap.usage;
+		}
+	}
+	return usage;
+}
+
+VkDeviceSize MemoryBudget::device_local_budget() const
+{
+	VkDeviceSize budget = 0;
+	for (const HeapBudget& heap : _heaps) {
+		if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+			budget += heap.budget;
+		}
+	}
+	return budget;
+}
+
+std::string MemoryBudget::summary() const
+{
+	char buffer[128];
+	snprintf(buffer, sizeof(buffer), "VRAM %.0f/%.0f MB (img %.0f, buf %.0f, stg %.0f)",
+		to_megabytes(device_local_usage()), to_megabytes(device_local_budget()),
+		to_megabytes(category(MemoryCategory::Images).bytes), to_megabytes(category(MemoryCategory::Buffers).bytes),
+		to_megabytes(category(MemoryCategory::Staging).bytes));
+	return buffer;
+}
+
+bool MemoryBudget::write_json(const char* filePath) const
+{
+	std::ofstream file(filePath);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	file << "{\n";
+	file << "  \"budget_extension\": " << (_budgetExtension ? "true" : "false") << ",\n";
+
+	file << "  \"heaps\": [\n";
+	for (size_t heap = 0; heap < _heaps.size(); heap++) {
+		const HeapBudget& heapBudget = _heaps[heap];
+		file << "    { \"index\": " << heap
+			<< ", \"device_local\": " << ((heapBudget.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "true" : "false")
+			<< ", \"usage\": " << heapBudget.usage
+			<< ", \"budget\": " << heapBudget.budget
+			<< ", \"block_bytes\": " << heapBudget.block_bytes
+			<< ", \"allocation_bytes\": " << heapBudget.allocation_bytes
+			<< ", \"block_count\": " << heapBudget.block_count
+			<< ", \"allocation_count\": " << heapBudget.allocation_count
+			<< " }" << (heap + 1 < _heaps.size() ? "," : "") << "\n";
+	}
+	file << "  ],\n";
+
+	file << "  \"categories\": {\n";
+	for (uint32_t i = 0; i < (uint32_t)MemoryCategory::Count; i++) {
+		CategoryUsage usage = category((MemoryCategory)i);
+		file << "    \"" << memory_category_name((MemoryCategory)i) << "\": { \"bytes\": " << usage.bytes
+			<< ", \"allocations\": " << usage.allocations << " }" << (i + 1 < (uint32_t)MemoryCategory::Count ? "," : "") << "\n";
+	}
+	file << "  }\n";
+	file << "}\n";
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include <vk_pipeline_cache.h>
+#include <vk_types.h>
+#include <hash.h>
+
+#include <SDL3/SDL_log.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+	// "RXPC" in little endian
+	constexpr uint32_t CACHE_FILE_MAGIC = 0x43505852;
+	// Bump when the layout of the file header changes
+	constexpr uint32_t CACHE_FILE_VERSION = 2;
+
+	// Written in front of the data returned by vkGetPipelineCacheData
+	struct CacheFileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		// Changes whenever the driver can no longer use cache data it wrote before.
+		// The driver version is not stored: drivers often keep the same cache format between versions.
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+		uint64_t dataChecksum;
+	};
+
+	// Checks the header Vulkan itself puts at the start of the cache data.
+	// Drivers are required to reject incompatible data, but not all of them do so gracefully, so it is checked here as well.
+	bool valid_vulkan_header(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties)
+	{
+		VkPipelineCacheHeaderVersionOne header;
+		if (data.size() < sizeof(header)) {
+			return false;
+		}
+		std::memcpy(&header, data.data(), sizeof(header));
+
+		return header.headerSize >= sizeof(header) &&
+			header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			header.vendorID == properties.vendorID &&
+			header.deviceID == properties.deviceID &&
+			std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+	// Returns the cache data stored in filePath, or nothing if the file is missing or was not written for this device
+	std::vector<char> read_cache_file(const std::string& filePath, const VkPhysicalDeviceProperties& properties)
+	{
+		std::ifstream file(filePath, std::ios::binary);
+		if (!file.is_open()) {
+			SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "No pipeline cache found at %s, starting cold", filePath.c_str());
+			return {};
+		}
+
+		std::error_code error;
+		uintmax_t fileSize = std::filesystem::file_size(filePath, error);
+
+		CacheFileHeader header{};
+		if (error || fileSize < sizeof(header) || !file.read((char*)&header, sizeof(header))) {
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Pipeline cache %s is truncated, ignoring it", filePath.c_str());
+			return {};
+		}
+
+		if (header.magic != CACHE_FILE_MAGIC || header.version != CACHE_FILE_VERSION) {
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Pipeline cache %s has an unknown format, ignoring it", filePath.c_str());
+			return {};
+		}
+
+		// A different GPU, or a driver update that changed the cache format, invalidates the data
+		if (header.vendorID != properties.vendorID ||
+			header.deviceID != properties.deviceID ||
+			std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+			SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Pipeline cache %s was written by another device or driver, starting cold", filePath.c_str());
+			return {};
+		}
+
+		// Checked against the file before allocating, so a corrupted size can not ask for an enormous buffer
+		if (header.dataSize != fileSize - sizeof(header)) {
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Pipeline cache %s has the wrong size, ignoring it", filePath.c_str());
+			return {};
+		}
+
+		std::vector<char> data(header.dataSize);
+		if (!file.read(data.data(), data.size())) {
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Failed to read pipeline cache %s, ignoring it", filePath.c_str());
+			return {};
+		}
+
+		if (vkutil::hash_bytes(data.data(), data.size()) != header.dataChecksum || !valid_vulkan_header(data, properties)) {
+			SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION, "Pipeline cache %s is corrupted, ignoring it", filePath.c_str());
+			return {};
+		}
+
+		return data;
+	}
+}
+
+void PipelineCache::init(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& filePath)
+{
+	_device = device;
+	_properties = properties;
+	_filePath = filePath;
+
+	std::vector<char> data;
+	if (!_filePath.empty()) {
+		data = read_cache_file(_filePath, _properties);
+	}
+
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.pNext = nullptr;
+	cacheInfo.initialDataSize = data.size();
+	cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	vk_check(vkCreatePipelineCache(_device, &cacheInfo, nullptr, &_cache));
+
+	_warm = !data.empty();
+}
+
+void PipelineCache::save() const
+{
+	if (_filePath.empty() || _cache == VK_NULL_HANDLE) {
+		return;
+	}
+
+	// The first call returns the size of the data, the second one retrieves it
+	size_t dataSize = 0;
+	vk_check(vkGetPipelineCacheData(_device, _cache, &dataSize, nullptr));
+
+	std::vector<char> data(dataSize);
+	vk_check(vkGetPipelineCacheData(_device, _cache, &dataSize, data.data()));
+	data.resize(dataSize);
+
+	CacheFileHeader header{};
+	header.magic = CACHE_FILE_MAGIC;
+	header.version = CACHE_FILE_VERSION;
+	header.vendorID = _properties.vendorID;
+	header.deviceID = _properties.deviceID;
+	std::memcpy(header.pipelineCacheUUID, _properties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = data.size();
+	header.dataChecksum = vkutil::hash_bytes(data.data(), data.size());
+
+	// Write to a temporary file first, and only replace the real cache once everything has been written
+	std::string tempPath = _filePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open() ||
+			!file.write((const char*)&header, sizeof(header)) ||
+			!file.write(data.data(), data.size())) {
+			SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to write pipeline cache to %s", tempPath.c_str());
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, _filePath, error);
+	if (error) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to replace pipeline cache %s: %s", _filePath.c_str(), error.message().c_str());
+		return;
+	}
+
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Saved %zu bytes of pipeline cache to %s", data.size(), _filePath.c_str());
+}
+
+void PipelineCache::destroy()
+{
+	vkDestroyPipelineCache(_device, _cache, nullptr);
+	_cache = VK_NULL_HANDLE;
+}
\ No newline at end of file
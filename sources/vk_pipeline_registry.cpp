@@ -0,0 +1,307 @@
+#include <vk_pipeline_registry.h>
+
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_timer.h>
+
+namespace {
+	double counter_to_ms(uint64_t counter)
+	{
+		return (double)counter * 1000.0 / (double)SDL_GetPerformanceFrequency();
+	}
+
+	bool uses_shader(const PipelineBuilder& builder, VkShaderModule module)
+	{
+		for (const VkPipelineShaderStageCreateInfo& stage : builder._shaderStages) {
+			if (stage.module == module) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+VkPipeline PipelineHandle::get() const
+{
+	if (_slot != nullptr && _slot->ready.load(std::memory_order_acquire)) {
+		VkPipeline pipeline = _slot->pipeline.load(std::memory_order_acquire);
+		if (pipeline != VK_NULL_HANDLE) {
+			return pipeline;
+		}
+	}
+
+	if (_fallback != nullptr && _fallback->ready.load(std::memory_order_acquire)) {
+		return _fallback->pipeline.load(std::memory_order_acquire);
+	}
+
+	return VK_NULL_HANDLE;
+}
+
+void PipelineRegistry::init(VkDevice device, VkPipelineCache cache, JobSystem* jobs)
+{
+	_device = device;
+	_cache = cache;
+	_jobs = jobs;
+}
+
+void PipelineRegistry::destroy()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	auto destroy_slot = [this](PipelineSlot& slot) {
+		for (VkPipeline pipeline : { slot.pipeline.load(), slot.rebuilt.load() }) {
+			if (pipeline != VK_NULL_HANDLE) {
+				vkDestroyPipeline(_device, pipeline, nullptr);
+			}
+		}
+	};
+
+	for (auto& [key, slot] : _pipelines) {
+		destroy_slot(*slot);
+	}
+	for (const std::shared_ptr<PipelineSlot>& slot : _displacedSlots) {
+		destroy_slot(*slot);
+	}
+
+	_pipelines.clear();
+	_displacedSlots.clear();
+}
+
+VkPipeline PipelineRegistry::get_pipeline(const PipelineBuilder& builder, const char* name)
+{
+	StateKey key = make_key(builder);
+	std::shared_ptr<PipelineSlot> slot;
+	bool existing = false;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		auto it = _pipelines.find(key);
+		if (it != _pipelines.end()) {
+			slot = it->second;
+			existing = true;
+		}
+		else {
+			slot = std::make_shared<PipelineSlot>();
+			slot->name = name;
+			slot->builder = builder;
+			_pipelines.emplace(std::move(key), slot);
+		}
+	}
+
+	if (existing) {
+		_cacheHits++;
+
+		// Requested earlier but still compiling in the background
+		_jobs->wait(slot->compiling);
+	}
+	else {
+		compile(*slot, SDL_GetPerformanceCounter());
+	}
+
+	return slot->pipeline.load(std::memory_order_acquire);
+}
+
+PipelineHandle PipelineRegistry::request_pipeline(const char* name, const PipelineBuilder& builder, const PipelineHandle& fallback)
+{
+	StateKey key = make_key(builder);
+
+	PipelineHandle handle;
+	handle._fallback = fallback._slot;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		auto it = _pipelines.find(key);
+		if (it != _pipelines.end()) {
+			_cacheHits++;
+			handle._slot = it->second;
+			return handle;
+		}
+
+		handle._slot = std::make_shared<PipelineSlot>();
+		handle._slot->name = name;
+		handle._slot->builder = builder;
+		_pipelines.emplace(std::move(key), handle._slot);
+	}
+
+	uint64_t requestCounter = SDL_GetPerformanceCounter();
+
+	if (_jobs->worker_count() <= 1) {
+		compile(*handle._slot, requestCounter);
+		return handle;
+	}
+
+	// The slot keeps its own copy of the builder, the request returns right away
+	std::shared_ptr<PipelineSlot> slot = handle._slot;
+	_jobs->submit_background([this, slot, requestCounter](uint32_t) {
+		compile(*slot, requestCounter);
+	}, &slot->compiling);
+
+	return handle;
+}
+
+void PipelineRegistry::wait(const PipelineHandle& handle)
+{
+	if (handle._slot != nullptr) {
+		_jobs->wait(handle._slot->compiling);
+	}
+}
+
+uint32_t PipelineRegistry::rebuild_with_shader(VkShaderModule oldModule, VkShaderModule newModule)
+{
+	std::vector<std::shared_ptr<PipelineSlot>> affected;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		for (auto& [key, slot] : _pipelines) {
+			if (uses_shader(slot->builder, oldModule)) {
+				affected.push_back(slot);
+			}
+		}
+		for (const std::shared_ptr<PipelineSlot>& slot : _displacedSlots) {
+			if (uses_shader(slot->builder, oldModule)) {
+				affected.push_back(slot);
+			}
+		}
+	}
+
+	// Builds that are still running read the slot's builder, so they have to finish before it is changed.
+	// Compile failures take the lock, so this can not wait while holding it.
+	for (const std::shared_ptr<PipelineSlot>& slot : affected) {
+		_jobs->wait(slot->compiling);
+		_jobs->wait(slot->rebuilding);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		for (const std::shared_ptr<PipelineSlot>& slot : affected) {
+			// Move the slot to the key of its new state
+			auto it = _pipelines.find(make_key(slot->builder));
+			if (it != _pipelines.end() && it->second == slot) {
+				_pipelines.erase(it);
+			}
+			else {
+				std::erase(_displacedSlots, slot);
+			}
+
+			for (VkPipelineShaderStageCreateInfo& stage : slot->builder._shaderStages) {
+				if (stage.module == oldModule) {
+					stage.module = newModule;
+				}
+			}
+
+			// Another slot can already have the new state, like when the new shader is identical to one another pipeline uses.
+			// Dropping the slot here would leak its pipeline, so it is kept aside instead.
+			if (!_pipelines.emplace(make_key(slot->builder), slot).second) {
+				_displacedSlots.push_back(slot);
+			}
+		}
+	}
+
+	for (const std::shared_ptr<PipelineSlot>& slot : affected) {
+		// A rebuild that finished but was never swapped in is replaced by this one
+		VkPipeline unused = slot->rebuilt.exchange(VK_NULL_HANDLE);
+		if (unused != VK_NULL_HANDLE) {
+			vkDestroyPipeline(_device, unused, nullptr);
+		}
+
+		slot->rebuildRequested = true;
+
+		auto rebuild = [this, slot, builder = slot->builder](uint32_t) {
+			uint64_t startCounter = SDL_GetPerformanceCounter();
+			VkPipeline pipeline = builder.build_pipeline(_device, _cache);
+			uint64_t endCounter = SDL_GetPerformanceCounter();
+
+			if (pipeline == VK_NULL_HANDLE) {
+				SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to rebuild pipeline %s, keeping the previous version", slot->name.c_str());
+				return;
+			}
+
+			slot->rebuilt.store(pipeline, std::memory_order_release);
+			SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Rebuilt pipeline %s in %.3f ms", slot->name.c_str(), counter_to_ms(endCounter - startCounter));
+		};
+
+		if (_jobs->worker_count() <= 1) {
+			rebuild(0);
+		}
+		else {
+			_jobs->submit_background(std::move(rebuild), &slot->rebuilding);
+		}
+	}
+
+	return (uint32_t)affected.size();
+}
+
+void PipelineRegistry::swap_rebuilt_pipelines(DeletionQueue& retireQueue)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	auto swap_slot = [this, &retireQueue](PipelineSlot& slot) {
+		if (!slot.rebuildRequested || !slot.rebuilding.done()) {
+			return;
+		}
+
+		slot.rebuildRequested = false;
+
+		VkPipeline rebuilt = slot.rebuilt.exchange(VK_NULL_HANDLE);
+		if (rebuilt == VK_NULL_HANDLE) {
+			return;
+		}
+
+		VkPipeline old = slot.pipeline.exchange(rebuilt);
+		slot.ready.store(true, std::memory_order_release);
+
+		if (old != VK_NULL_HANDLE) {
+			VkDevice device = _device;
+			retireQueue.push_function([=]() {
+				vkDestroyPipeline(device, old, nullptr);
+			});
+		}
+	};
+
+	for (auto& [key, slot] : _pipelines) {
+		swap_slot(*slot);
+	}
+	for (const std::shared_ptr<PipelineSlot>& slot : _displacedSlots) {
+		swap_slot(*slot);
+	}
+}
+
+uint32_t PipelineRegistry::pipeline_count()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return (uint32_t)(_pipelines.size() + _displacedSlots.size());
+}
+
+void PipelineRegistry::compile(PipelineSlot& slot, uint64_t requestCounter)
+{
+	uint64_t startCounter = SDL_GetPerformanceCounter();
+	VkPipeline pipeline = slot.builder.build_pipeline(_device, _cache);
+	uint64_t endCounter = SDL_GetPerformanceCounter();
+
+	slot.pipeline.store(pipeline, std::memory_order_release);
+	slot.ready.store(true, std::memory_order_release);
+
+	if (pipeline == VK_NULL_HANDLE) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to compile pipeline %s", slot.name.c_str());
+
+		// Failed builds are not remembered, so a fixed shader can be picked up by asking again
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto it = _pipelines.find(make_key(slot.builder));
+		if (it != _pipelines.end() && it->second.get() == &slot) {
+			_pipelines.erase(it);
+		}
+		return;
+	}
+
+	// The latency includes the time spent waiting in the job queue, which is what decides how long the fallback is visible
+	SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Compiled pipeline %s in %.3f ms (ready %.3f ms after it was requested)",
+		slot.name.c_str(), counter_to_ms(endCounter - startCounter), counter_to_ms(endCounter - requestCounter));
+}
+
+StateKey PipelineRegistry::make_key(const PipelineBuilder& builder)
+{
+	return vkutil::make_state_key(builder.state_key());
+}
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include <vk_pipelines.h>
-#include <fstream>
+#include <vk_types.h>
+#include <mapped_file.h>
+#include <cstring>
 
 void PipelineBuilder::set_color_attachment_format(VkFormat format)
 {
@@ -46,6 +48,42 @@ void PipelineBuilder::disable_blending()
 	_colorBlendAttachment.blendEnable = VK_FALSE;
 }
 
+void PipelineBuilder::enable_blending_alphablend()
+{
+	_colorBlendAttachment.colorWriteMask =
+		VK_COLOR_COMPONENT_R_BIT |
+		VK_COLOR_COMPONENT_G_BIT |
+		VK_COLOR_COMPONENT_B_BIT |
+		VK_COLOR_COMPONENT_A_BIT;
+
+	// The fragment's alpha decides how much of it covers what is already in the framebuffer
+	_colorBlendAttachment.blendEnable = VK_TRUE;
+	_colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	_colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	_colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	_colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	_colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	_colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+}
+
+void PipelineBuilder::enable_blending_additive()
+{
+	_colorBlendAttachment.colorWriteMask =
+		VK_COLOR_COMPONENT_R_BIT |
+		VK_COLOR_COMPONENT_G_BIT |
+		VK_COLOR_COMPONENT_B_BIT |
+		VK_COLOR_COMPONENT_A_BIT;
+
+	// The fragment only ever brightens what is already in the framebuffer, so the order of additive draws does not matter
+	_colorBlendAttachment.blendEnable = VK_TRUE;
+	_colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	_colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	_colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	_colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	_colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	_colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+}
+
 void PipelineBuilder::set_multisampling_none()
 {
 	// Right now, multisampling is simply disabled
@@ -120,7 +158,86 @@ void PipelineBuilder::clear()
 	_shaderStages.clear();
 }
 
-VkPipeline PipelineBuilder::build_pipeline(VkDevice device)
+std::vector<uint32_t> PipelineBuilder::state_key() const
+{
+	// Fields are added one by one instead of copying whole structs,
+	// as the structs contain pointers and padding that say nothing about the pipeline itself
+	std::vector<uint32_t> key;
+
+	auto add = [&](uint32_t value) { key.push_back(value); };
+	auto add_float = [&](float value) { uint32_t bits; memcpy(&bits, &value, sizeof(bits)); key.push_back(bits); };
+	auto add_handle = [&](uint64_t handle) { key.push_back((uint32_t)handle); key.push_back((uint32_t)(handle >> 32)); };
+
+	add((uint32_t)_shaderStages.size());
+	for (const VkPipelineShaderStageCreateInfo& stage : _shaderStages) {
+		add(stage.stage);
+		add_handle((uint64_t)stage.module);
+		for (const char* c = stage.pName; *c != '\0'; c++) {
+			add((uint32_t)*c);
+		}
+		add(0);
+	}
+
+	add(_inputAssembly.topology);
+	add(_inputAssembly.primitiveRestartEnable);
+
+	add(_rasterizer.depthClampEnable);
+	add(_rasterizer.rasterizerDiscardEnable);
+	add(_rasterizer.polygonMode);
+	add(_rasterizer.cullMode);
+	add(_rasterizer.frontFace);
+	add(_rasterizer.depthBiasEnable);
+	add_float(_rasterizer.depthBiasConstantFactor);
+	add_float(_rasterizer.depthBiasClamp);
+	add_float(_rasterizer.depthBiasSlopeFactor);
+	add_float(_rasterizer.lineWidth);
+
+	add(_colorBlendAttachment.blendEnable);
+	add(_colorBlendAttachment.srcColorBlendFactor);
+	add(_colorBlendAttachment.dstColorBlendFactor);
+	add(_colorBlendAttachment.colorBlendOp);
+	add(_colorBlendAttachment.srcAlphaBlendFactor);
+	add(_colorBlendAttachment.dstAlphaBlendFactor);
+	add(_colorBlendAttachment.alphaBlendOp);
+	add(_colorBlendAttachment.colorWriteMask);
+
+	add(_multiSampling.rasterizationSamples);
+	add(_multiSampling.sampleShadingEnable);
+	add_float(_multiSampling.minSampleShading);
+	add(_multiSampling.alphaToCoverageEnable);
+	add(_multiSampling.alphaToOneEnable);
+
+	add(_depthStencil.depthTestEnable);
+	add(_depthStencil.depthWriteEnable);
+	add(_depthStencil.depthCompareOp);
+	add(_depthStencil.depthBoundsTestEnable);
+	add(_depthStencil.stencilTestEnable);
+	for (const VkStencilOpState& op : { _depthStencil.front, _depthStencil.back }) {
+		add(op.failOp);
+		add(op.passOp);
+		add(op.depthFailOp);
+		add(op.compareOp);
+		add(op.compareMask);
+		add(op.writeMask);
+		add(op.reference);
+	}
+	add_float(_depthStencil.minDepthBounds);
+	add_float(_depthStencil.maxDepthBounds);
+
+	add(_renderInfo.viewMask);
+	add(_renderInfo.colorAttachmentCount);
+	if (_renderInfo.colorAttachmentCount > 0) {
+		add(_colorAttachmentFormat);
+	}
+	add(_renderInfo.depthAttachmentFormat);
+	add(_renderInfo.stencilAttachmentFormat);
+
+	add_handle((uint64_t)_pipelineLayout);
+
+	return key;
+}
+
+VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkPipelineCache cache) const
 {
 	// Make viewport state from our stored viewport and scissor
 	// at the moment we wont support mulitple viewports or scissors
@@ -153,12 +270,16 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device)
 	dynamicInfo.pDynamicStates = &state[0];
 	dynamicInfo.dynamicStateCount = 2;
 
+	// The color format pointer is set up again here, so a copied builder does not point into the builder it was copied from
+	VkPipelineRenderingCreateInfo renderInfo = _renderInfo;
+	renderInfo.pColorAttachmentFormats = renderInfo.colorAttachmentCount > 0 ? &_colorAttachmentFormat : nullptr;
+
 	// Build the actual pipeline
 	VkGraphicsPipelineCreateInfo pipelineInfo = {
 		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO
 	};
 
-	pipelineInfo.pNext = &_renderInfo;
+	pipelineInfo.pNext = &renderInfo;
 	pipelineInfo.stageCount = (uint32_t)_shaderStages.size();
 	pipelineInfo.pStages = _shaderStages.data();
 	pipelineInfo.pVertexInputState = &_vertexInputInfo;
@@ -174,7 +295,7 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device)
 	VkPipeline newPipeline;
 	if (vkCreateGraphicsPipelines(
 		device,
-		VK_NULL_HANDLE,
+		cache,
 		1,
 		&pipelineInfo,
 		nullptr,
@@ -187,40 +308,202 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device)
 	return newPipeline;
 }
 
-bool vkutil::load_shader_module(const char* filePath, VkDevice device, VkShaderModule* outShaderModule)
+void ComputePipelineBuilder::set_shader(VkShaderModule computeShader, const char* entry)
+{
+	_shaderStage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, computeShader, entry);
+	_shaderLocalSize = {};
+}
+
+void ComputePipelineBuilder::set_shader(VkShaderModule computeShader, const ShaderReflection& reflection, const char* entry)
 {
-	std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+	set_shader(computeShader, entry);
+	_shaderLocalSize = { reflection.localSize[0], reflection.localSize[1], reflection.localSize[2] };
+}
 
-	if (!file.is_open()) {
-		return false;
+void ComputePipelineBuilder::set_workgroup_size(WorkgroupSize size, const VkPhysicalDeviceLimits& limits)
+{
+	// The driver is not required to check specialized sizes, and a size of 0 would divide by zero when dispatching
+	if (size.x == 0 || size.y == 0 || size.z == 0) {
+		panic_and_exit("Workgroup size %u x %u x %u is empty along an axis", size.x, size.y, size.z);
+	}
+
+	if (size.x > limits.maxComputeWorkGroupSize[0] ||
+		size.y > limits.maxComputeWorkGroupSize[1] ||
+		size.z > limits.maxComputeWorkGroupSize[2]) {
+		panic_and_exit("Workgroup size %u x %u x %u is larger than the device allows (%u x %u x %u)", size.x, size.y, size.z,
+			limits.maxComputeWorkGroupSize[0], limits.maxComputeWorkGroupSize[1], limits.maxComputeWorkGroupSize[2]);
+	}
+
+	// Every axis can be within its own limit while the group as a whole is still too large
+	uint64_t invocations = (uint64_t)size.x * size.y * size.z;
+	if (invocations > limits.maxComputeWorkGroupInvocations) {
+		panic_and_exit("Workgroup size %u x %u x %u has %llu invocations, the device allows at most %u", size.x, size.y, size.z,
+			(unsigned long long)invocations, limits.maxComputeWorkGroupInvocations);
+	}
+
+	_hasWorkgroupSize = true;
+	_workgroupSize = size;
+}
+
+void ComputePipelineBuilder::set_specialization_word(uint32_t id, uint32_t bits)
+{
+	for (size_t i = 0; i < _specializationEntries.size(); i++) {
+		if (_specializationEntries[i].constantID == id) {
+			_specializationData[i] = bits;
+			return;
+		}
+	}
+
+	VkSpecializationMapEntry entry{};
+	entry.constantID = id;
+	entry.offset = (uint32_t)(_specializationData.size() * sizeof(uint32_t));
+	entry.size = sizeof(uint32_t);
+
+	_specializationEntries.push_back(entry);
+	_specializationData.push_back(bits);
+}
+
+void ComputePipelineBuilder::add_descriptor_set_layout(VkDescriptorSetLayout layout)
+{
+	_setLayouts.push_back(layout);
+}
+
+void ComputePipelineBuilder::add_push_constant_range(uint32_t size, uint32_t offset)
+{
+	_pushConstantRanges.push_back(vkinit::push_constant_range(VK_SHADER_STAGE_COMPUTE_BIT, size, offset));
+}
+
+VkPipelineLayout ComputePipelineBuilder::build_layout(LayoutCache& layouts)
+{
+	_pipelineLayout = layouts.get_pipeline_layout(_setLayouts, _pushConstantRanges);
+	return _pipelineLayout;
+}
+
+void ComputePipelineBuilder::clear()
+{
+	_shaderStage = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO
+	};
+
+	_pipelineLayout = {};
+
+	_hasWorkgroupSize = false;
+	_workgroupSize = {};
+	_shaderLocalSize = {};
+
+	_specializationEntries.clear();
+	_specializationData.clear();
+
+	_setLayouts.clear();
+	_pushConstantRanges.clear();
+}
+
+VkPipeline ComputePipelineBuilder::build_pipeline(VkDevice device, VkPipelineCache cache) const
+{
+	// The workgroup size goes in with the shader's own constants. Copies are used, so building does not change the builder.
+	std::vector<VkSpecializationMapEntry> entries = _specializationEntries;
+	std::vector<uint32_t> data = _specializationData;
+
+	if (_hasWorkgroupSize) {
+		const uint32_t ids[3] = { WORKGROUP_SIZE_X_ID, WORKGROUP_SIZE_Y_ID, WORKGROUP_SIZE_Z_ID };
+		const uint32_t sizes[3] = { _workgroupSize.x, _workgroupSize.y, _workgroupSize.z };
+
+		for (uint32_t axis = 0; axis < 3; axis++) {
+			// A constant id may only appear once, so a constant set for the same id is overwritten by the workgroup size
+			bool replaced = false;
+			for (size_t i = 0; i < entries.size(); i++) {
+				if (entries[i].constantID == ids[axis]) {
+					data[i] = sizes[axis];
+					replaced = true;
+				}
+			}
+			if (replaced) {
+				continue;
+			}
+
+			VkSpecializationMapEntry entry{};
+			entry.constantID = ids[axis];
+			entry.offset = (uint32_t)(data.size() * sizeof(uint32_t));
+			entry.size = sizeof(uint32_t);
+
+			entries.push_back(entry);
+			data.push_back(sizes[axis]);
+		}
+	}
+
+	VkSpecializationInfo specializationInfo = vkinit::specialization_info(entries, data.data(), data.size() * sizeof(uint32_t));
+
+	VkPipelineShaderStageCreateInfo stage = _shaderStage;
+	stage.pSpecializationInfo = entries.empty() ? nullptr : &specializationInfo;
+
+	VkComputePipelineCreateInfo pipelineInfo = vkinit::compute_pipeline_create_info(stage, _pipelineLayout);
+
+	VkPipeline newPipeline;
+	if (vkCreateComputePipelines(device, cache, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS) {
+		SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to create compute pipeline");
+		return VK_NULL_HANDLE;
+	}
+
+	return newPipeline;
+}
+
+uint32_t vkutil::group_count(uint32_t count, uint32_t groupSize)
+{
+	if (groupSize == 0) {
+		panic_and_exit("Can not dispatch %u items with a workgroup size of 0", count);
 	}
 
-	// find what the size of the file is by looking up the location of the cursor
-	// because the cursor is at the end, it gives the size directly in bytes
-	size_t fileSize = (size_t)file.tellg();
+	return (count + groupSize - 1) / groupSize;
+}
+
+void vkutil::dispatch(VkCommandBuffer cmd, VkExtent3D extent, WorkgroupSize groupSize)
+{
+	vkCmdDispatch(cmd,
+		group_count(extent.width, groupSize.x),
+		group_count(extent.height, groupSize.y),
+		group_count(extent.depth, groupSize.z));
+}
+
+void vkutil::dispatch(VkCommandBuffer cmd, VkExtent2D extent, WorkgroupSize groupSize)
+{
+	dispatch(cmd, VkExtent3D{ extent.width, extent.height, 1 }, groupSize);
+}
 
-	// spirv expects the buffer to be on uint32, so make sure to reserve an int
-	// vector big enough for the entire file
-	std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
+void vkutil::dispatch(VkCommandBuffer cmd, uint32_t count, uint32_t groupSize)
+{
+	vkCmdDispatch(cmd, group_count(count, groupSize), 1, 1);
+}
 
-	// put the file cursor at the beginning
-	file.seekg(0);
+bool vkutil::load_shader_module(const char* filePath, VkDevice device, VkShaderModule* outShaderModule, ShaderReflection* reflection)
+{
+	// Map the file instead of reading it into a buffer.
+	// The mapping is page aligned, so the SPIR-V words can be handed to the driver directly.
+	MappedFile file;
+	if (!file.open(filePath)) {
+		return false;
+	}
 
-	// load the entire file into the buffer
-	file.read((char*)buffer.data(), fileSize);
+	// spirv is made of 32 bit words, anything else is not a valid shader
+	if (file.size() % sizeof(uint32_t) != 0) {
+		return false;
+	}
 
-	// close the file
-	file.close();
+	if (reflection != nullptr) {
+		std::string error;
+		if (!vkutil::reflect_spirv((const uint32_t*)file.data(), file.size() / sizeof(uint32_t), *reflection, error)) {
+			SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to reflect %s: %s", filePath, error.c_str());
+			return false;
+		}
+	}
 
 	// Create a new shader module
 	VkShaderModuleCreateInfo shaderCreateInfo = {};
 	shaderCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 	shaderCreateInfo.pNext = nullptr;
 
-	// codeSize has to be in bytes, so multiple the ints in the buffer by the size of
-	// int to know the real size of the buffer
-	shaderCreateInfo.codeSize = buffer.size() * sizeof(uint32_t);
-	shaderCreateInfo.pCode = buffer.data();
+	// codeSize has to be in bytes
+	shaderCreateInfo.codeSize = file.size();
+	shaderCreateInfo.pCode = (const uint32_t*)file.data();
 
 	// Check that creation goes well
 	VkShaderModule shaderModule;
@@ -0,0 +1,54 @@
+#include <vk_timeline.h>
+
+VkResult Timeline::init(VkDevice device)
+{
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.pNext = nullptr;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	createInfo.pNext = &typeInfo;
+
+	submitted_value = 0;
+
+	return vkCreateSemaphore(device, &createInfo, nullptr, &semaphore);
+}
+
+void Timeline::destroy(VkDevice device)
+{
+	vkDestroySemaphore(device, semaphore, nullptr);
+	semaphore = VK_NULL_HANDLE;
+}
+
+uint64_t Timeline::next_value()
+{
+	return ++submitted_value;
+}
+
+uint64_t Timeline::completed_value(VkDevice device) const
+{
+	uint64_t value = 0;
+	vkGetSemaphoreCounterValue(device, semaphore, &value);
+	return value;
+}
+
+VkResult Timeline::wait(VkDevice device, uint64_t value, uint64_t timeout) const
+{
+	// Every timeline starts out at 0, so waiting for 0 never has to block
+	if (value == 0) {
+		return VK_SUCCESS;
+	}
+
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.pNext = nullptr;
+	waitInfo.flags = 0;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &semaphore;
+	waitInfo.pValues = &value;
+
+	return vkWaitSemaphores(device, &waitInfo, timeout);
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+// Packs compiled shaders into a single archive, along with their reflection data.
+// Run by the Shaders build target after every shader is compiled:
+//
+//   shader_packer <archive> <shader.spv>...
+//
+// Each shader is stored under its file name without the .spv extension.
+
+#include <shader_archive.h>
+#include <spirv_reflect.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+	bool read_spirv(const std::filesystem::path& path, std::vector<uint32_t>& code)
+	{
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		size_t fileSize = (size_t)file.tellg();
+		if (fileSize % sizeof(uint32_t) != 0) {
+			return false;
+		}
+
+		code.resize(fileSize / sizeof(uint32_t));
+		file.seekg(0);
+		file.read((char*)code.data(), fileSize);
+
+		return file.good();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::fprintf(stderr, "Usage: shader_packer <archive> <shader.spv>...\n");
+		return 1;
+	}
+
+	std::vector<ShaderArchiveInput> shaders;
+	size_t codeBytes = 0;
+
+	for (int i = 2; i < argc; i++) {
+		std::filesystem::path path = argv[i];
+
+		ShaderArchiveInput shader;
+		shader.name = path.stem().string();
+
+		if (!read_spirv(path, shader.code)) {
+			std::fprintf(stderr, "shader_packer: failed to read %s\n", argv[i]);
+			return 1;
+		}
+
+		std::string error;
+		if (!vkutil::reflect_spirv(shader.code.data(), shader.code.size(), shader.reflection, error)) {
+			std::fprintf(stderr, "shader_packer: %s is not valid SPIR-V: %s\n", argv[i], error.c_str());
+			return 1;
+		}
+
+		codeBytes += shader.code.size() * sizeof(uint32_t);
+		shaders.push_back(std::move(shader));
+	}
+
+	std::string error;
+	if (!vkutil::write_shader_archive(argv[1], std::move(shaders), error)) {
+		std::fprintf(stderr, "shader_packer: %s\n", error.c_str());
+		return 1;
+	}
+
+	std::printf("Packed %d shaders (%zu bytes of SPIR-V) into %s\n", argc - 2, codeBytes, argv[1]);
+
+	return 0;
+}
\ No newline at end of file